@@ -0,0 +1,19 @@
+#include <benchmark/benchmark.h>
+
+#ifndef S9R_GIT_COMMIT
+#define S9R_GIT_COMMIT ""
+#endif
+
+int main(int argc, char** argv)
+{
+    // 結果をコミット毎に比較できるように、コミットを記録しておく
+    benchmark::AddCustomContext( "git_commit", S9R_GIT_COMMIT );
+
+    benchmark::Initialize( &argc, argv );
+    if( benchmark::ReportUnrecognizedArguments( argc, argv ) ) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
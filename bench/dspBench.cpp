@@ -0,0 +1,262 @@
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <cstdio>
+#include "waveform.h"
+#include "filter.h"
+#include "envelope.h"
+#include "fifo.h"
+#include "scope_buffer.h"
+#include "sample_converter.h"
+
+namespace {
+    static const float kFs = 48000.f;
+
+    // Waveform::GetSine (get_wave)
+    static void BM_WaveformGetSine(benchmark::State& state)
+    {
+        Waveform* wf = Waveform::Create( 440.f, kFs );
+        uint32_t p = 0;
+        uint32_t w = wf->CalcWFromNoteNo( 69.f, 0.f );
+        for( auto _ : state ) {
+            benchmark::DoNotOptimize( wf->GetSine( p ) );
+            p += w;
+        }
+        state.SetItemsProcessed( state.iterations() );
+        Waveform::Destroy();
+    }
+    BENCHMARK(BM_WaveformGetSine);
+
+    // Waveform::GetSaw (テーブル選択 + get_wave)
+    static void BM_WaveformGetSaw(benchmark::State& state)
+    {
+        Waveform* wf = Waveform::Create( 440.f, kFs );
+        const float nn = (float)state.range(0);
+        uint32_t p = 0;
+        uint32_t w = wf->CalcWFromNoteNo( nn, 0.f );
+        for( auto _ : state ) {
+            benchmark::DoNotOptimize( wf->GetSaw( nn, p ) );
+            p += w;
+        }
+        state.SetItemsProcessed( state.iterations() );
+        Waveform::Destroy();
+    }
+    BENCHMARK(BM_WaveformGetSaw)->Arg(24)->Arg(69)->Arg(120);
+
+    // Waveform::CalcWFromNoteNo / CalcWFromNoteNoFast
+    static void BM_WaveformCalcW(benchmark::State& state)
+    {
+        Waveform* wf = Waveform::Create( 440.f, kFs );
+        float nn = 60.f;
+        for( auto _ : state ) {
+            benchmark::DoNotOptimize( state.range(0) ? wf->CalcWFromNoteNoFast( nn, 3.f ) : wf->CalcWFromNoteNo( nn, 3.f ) );
+            nn = (nn < 100.f) ? nn + 0.01f : 20.f;
+        }
+        state.SetItemsProcessed( state.iterations() );
+        Waveform::Destroy();
+    }
+    BENCHMARK(BM_WaveformCalcW)->ArgName("fast")->Arg(0)->Arg(1);
+
+    // Waveform::Initialize (波形テーブル生成)
+    static void BM_WaveformInitialize(benchmark::State& state)
+    {
+        for( auto _ : state ) {
+            Waveform::Create( 440.f, kFs );
+            Waveform::Destroy();
+        }
+    }
+    BENCHMARK(BM_WaveformInitialize)->Unit(benchmark::kMillisecond);
+
+    // Waveform::Initialize (キャッシュから)
+    static void BM_WaveformInitializeCached(benchmark::State& state)
+    {
+        Waveform::CacheDirSet( "dspBenchCache" );
+        Waveform::Create( 440.f, kFs );  // キャッシュを作る
+        Waveform::Destroy();
+        for( auto _ : state ) {
+            Waveform::Create( 440.f, kFs );
+            Waveform::Destroy();
+        }
+        Waveform::CacheDirSet( nullptr );
+        remove( "dspBenchCache/wavetable-v1-48000.bin" );
+        remove( "dspBenchCache" );
+    }
+    BENCHMARK(BM_WaveformInitializeCached)->Unit(benchmark::kMicrosecond);
+
+    // Filter::Process
+    static void BM_FilterProcess(benchmark::State& state)
+    {
+        Filter filter( kFs );
+        filter.LowPass( 1000.f, 0.7f );
+        float in = 0.5f;
+        for( auto _ : state ) {
+            benchmark::DoNotOptimize( in = filter.Process( in ) + 0.5f );
+        }
+        state.SetItemsProcessed( state.iterations() );
+    }
+    BENCHMARK(BM_FilterProcess);
+
+    // Filter::Process (ブロック処理)
+    static void BM_FilterProcessBlock(benchmark::State& state)
+    {
+        Filter filter( kFs );
+        filter.LowPass( 1000.f, 0.7f );
+        float buf[256];
+        for( int ix=0; ix<256; ix++ ) {
+            buf[ix] = (ix < 128) ? 0.5f : -0.5f;
+        }
+        for( auto _ : state ) {
+            filter.Process( buf, buf, 256 );
+            benchmark::DoNotOptimize( buf );
+        }
+        state.SetItemsProcessed( state.iterations() * 256 );
+    }
+    BENCHMARK(BM_FilterProcessBlock);
+
+    // Envelope::Process
+    static void BM_EnvelopeProcess(benchmark::State& state)
+    {
+        Envelope env( kFs );
+        env.SetAttack( 100 );
+        env.SetDecay( 200 );
+        env.SetSustain( 0.5f );
+        env.SetRelease( 1000 );
+        env.Trigger();
+        for( auto _ : state ) {
+            benchmark::DoNotOptimize( env.Process( 1.f ) );
+        }
+        state.SetItemsProcessed( state.iterations() );
+    }
+    BENCHMARK(BM_EnvelopeProcess);
+
+    // Envelope::Process (ブロック処理)
+    static void BM_EnvelopeProcessBlock(benchmark::State& state)
+    {
+        Envelope env( kFs );
+        env.SetAttack( 0 );
+        env.SetDecay( 200 );
+        env.SetSustain( 0.5f );
+        env.SetRelease( 1000 );
+        env.SetCurve( (Envelope::Curve)state.range(0) );
+        float buf[256];
+        int   count = 0;
+        for( auto _ : state ) {
+            // ディケイ(9600サンプル)が終わる前にトリガーし直し、常にディケイ中を測る
+            if( count++ % 32 == 0 ) {
+                env.Trigger();
+            }
+            env.Process( buf, 256 );
+            benchmark::DoNotOptimize( buf );
+        }
+        state.SetItemsProcessed( state.iterations() * 256 );
+    }
+    BENCHMARK(BM_EnvelopeProcessBlock)->ArgName("exp")->Arg(0)->Arg(1);
+
+    // FIFO::Put
+    static void BM_FifoPut(benchmark::State& state)
+    {
+        FIFO<float, 256> fifo;
+        float val = 0.f;
+        for( auto _ : state ) {
+            fifo.Put( val );
+            val += 1.f;
+        }
+        state.SetItemsProcessed( state.iterations() );
+    }
+    BENCHMARK(BM_FifoPut);
+
+    // FIFO::SnoopFromTail
+    static void BM_FifoSnoopFromTail(benchmark::State& state)
+    {
+        FIFO<float, 256> fifo;
+        float buf[256];
+        for( int ix=0; ix<256; ix++ ) {
+            fifo.Put( (float)ix );
+        }
+        for( auto _ : state ) {
+            fifo.SnoopFromTail( buf, 256 );
+            benchmark::ClobberMemory();
+        }
+        state.SetItemsProcessed( state.iterations() * 256 );
+    }
+    BENCHMARK(BM_FifoSnoopFromTail);
+
+    // FIFO::PutN / GetN (1ブロックまとめて)
+    static void BM_FifoPutNGetN(benchmark::State& state)
+    {
+        FIFO<float, 1024, true> fifo;
+        float in[256];
+        float out[256];
+        for( int ix=0; ix<256; ix++ ) {
+            in[ix] = (float)ix;
+        }
+        for( auto _ : state ) {
+            fifo.PutN( in, 256 );
+            fifo.GetN( out, 256 );
+            benchmark::ClobberMemory();
+        }
+        state.SetItemsProcessed( state.iterations() * 256 );
+    }
+    BENCHMARK(BM_FifoPutNGetN);
+
+    // ScopeBuffer::Write (1ブロックまとめて書き込み)
+    static void BM_ScopeBufferWrite(benchmark::State& state)
+    {
+        static ScopeBuffer<float, 1024> scope;
+        float block[256];
+        for( int ix=0; ix<256; ix++ ) {
+            block[ix] = (float)ix;
+        }
+        for( auto _ : state ) {
+            scope.Write( block, 256 );
+            benchmark::ClobberMemory();
+        }
+        state.SetItemsProcessed( state.iterations() * 256 );
+    }
+    BENCHMARK(BM_ScopeBufferWrite);
+
+    // ScopeBuffer::Snapshot
+    static void BM_ScopeBufferSnapshot(benchmark::State& state)
+    {
+        static ScopeBuffer<float, 1024> scope;
+        float block[256];
+        float buf[256];
+        for( int ix=0; ix<256; ix++ ) {
+            block[ix] = (float)ix;
+        }
+        scope.Write( block, 256 );
+        for( auto _ : state ) {
+            scope.Snapshot( buf, 256 );
+            benchmark::ClobberMemory();
+        }
+        state.SetItemsProcessed( state.iterations() * 256 );
+    }
+    BENCHMARK(BM_ScopeBufferSnapshot);
+
+    // SampleConverter::Write (インターリーブのステレオ、1024フレーム)
+    static void BM_SampleConverterWrite(benchmark::State& state)
+    {
+        static const int kFormats[] = {
+            SampleConverter::kFloat32, SampleConverter::kFloat64, SampleConverter::kS32, SampleConverter::kS16,
+        };
+        SampleConverter conv;
+        conv.Setup( kFormats[state.range(0)], state.range(1) != 0 );
+
+        static float l[1024], r[1024];
+        static char  dst[1024 * 2 * 8];
+        for( int ix=0; ix<1024; ix++ ) {
+            l[ix] = (float)ix / 1024.f;
+            r[ix] = -l[ix];
+        }
+        const float* buf[2] = { l, r };
+        const int bytes = conv.GetBytes();
+        for( auto _ : state ) {
+            SoundIoChannelArea areas[2] = { { dst, bytes * 2 }, { dst + bytes, bytes * 2 } };
+            conv.Write( areas, buf, 2, 1024 );
+            benchmark::ClobberMemory();
+        }
+        state.SetItemsProcessed( state.iterations() * 1024 );
+    }
+    BENCHMARK(BM_SampleConverterWrite)->ArgNames({"fmt", "dither"})
+        ->Args({0, 0})->Args({1, 0})->Args({2, 0})->Args({2, 1})->Args({3, 0})->Args({3, 1});
+}
@@ -0,0 +1,220 @@
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <cstdint>
+#include "waveform.h"
+#include "audio.h"
+#include "midi.h"
+#include "patch.h"
+#include "synth.h"
+#include "voice.h"
+#include "voice_bank.h"
+
+namespace {
+    static const float kFs     = 48000.f;
+    static const int   kFrames = AudioCtrl::kMaxBlockFrames;
+
+    // voice_num音を押鍵した状態にする
+    static void press_keys( MidiCtrl* midictrl, int voice_num )
+    {
+        for( int ix=0; ix<voice_num; ix++ ) {
+            const unsigned char msg[3] = { 0x90, (unsigned char)(36 + ix * 2), 100 };
+            midictrl->MidiRecv( msg, 3 );
+        }
+    }
+
+    // 1ブロックあたりの時間から、1サンプル1ボイスあたりの時間とリアルタイム比を求める
+    static void set_render_counters( benchmark::State& state, double elapsed_ns, int frames, int voice_num )
+    {
+        double samples = (double)state.iterations() * frames;
+        state.counters["ns_per_sample_voice"] = elapsed_ns / (samples * voice_num);
+        state.counters["realtime_factor"]     = (samples / kFs * 1e9) / elapsed_ns;
+        state.SetItemsProcessed( state.iterations() * frames );
+    }
+
+    // Voice::Prepare (パラメータ設定とエンベロープ)
+    static void BM_VoicePrepare(benchmark::State& state)
+    {
+        Waveform* wf = Waveform::Create( 440.f, kFs );
+        VoiceBank* bank = new VoiceBank( wf->GetWTBase(), wf->GetSamplerate() );
+        Voice* voice = new Voice();
+        voice->SetNoteInfo( 60, 100 );
+        voice->Trigger();
+        for( auto _ : state ) {
+            voice->Prepare( bank, 0, kFrames );
+            benchmark::ClobberMemory();
+        }
+        state.SetItemsProcessed( state.iterations() * kFrames );
+        delete voice;
+        delete bank;
+        Waveform::Destroy();
+    }
+    BENCHMARK(BM_VoicePrepare);
+
+    // VoiceBank::Render (発振 + フィルタ + ゲイン)
+    static void BM_VoiceBankRender(benchmark::State& state)
+    {
+        Waveform* wf = Waveform::Create( 440.f, kFs );
+        VoiceBank* bank = new VoiceBank( wf->GetWTBase(), wf->GetSamplerate() );
+        const int voice_num = state.range(0);
+        float out[kFrames];
+
+        uint64_t active_mask = 0;
+        for( int ix=0; ix<voice_num; ix++ ) {
+            float nn = 36.f + ix * 2;
+            bank->SetOsc( ix, wf->GetWTOffsetFromNN( wf->WF_SAW, nn ), wf->CalcWFromNoteNo( nn, 0.f ) );
+            active_mask |= (1ull << ix);
+        }
+        for( auto _ : state ) {
+            bank->Render( out, kFrames, active_mask );
+            benchmark::ClobberMemory();
+        }
+        state.SetItemsProcessed( state.iterations() * kFrames * voice_num );
+        delete bank;
+        Waveform::Destroy();
+    }
+    BENCHMARK(BM_VoiceBankRender)->ArgName("voices")->Arg(1)->Arg(8)->Arg(16)->Arg(32);
+
+    // VoiceCtrl::RenderBlock
+    static void BM_VoiceCtrlRenderBlock(benchmark::State& state)
+    {
+        const int voice_num  = state.range(0);
+        const int thread_num = state.range(1);
+
+        MidiCtrl::NoPortMode();
+        MidiCtrl* midictrl = MidiCtrl::Create();
+        Waveform::Create( 440.f, kFs );
+        VoiceCtrl* voicectrl = new VoiceCtrl();
+        Patch patch;
+        patch.poly_num = VoiceBank::kLaneNum;
+        voicectrl->SetPatch( patch );
+        voicectrl->SetRenderThreadNum( thread_num );
+
+        press_keys( midictrl, voice_num );
+        voicectrl->Trigger();
+        midictrl->ResetStatusChange();
+
+        float out[kFrames];
+        auto start = std::chrono::steady_clock::now();
+        for( auto _ : state ) {
+            voicectrl->RenderBlock( out, kFrames );
+            benchmark::ClobberMemory();
+        }
+        auto stop = std::chrono::steady_clock::now();
+        set_render_counters( state, std::chrono::duration<double, std::nano>( stop - start ).count(), kFrames, voice_num );
+
+        delete voicectrl;
+        Waveform::Destroy();
+        MidiCtrl::Destroy();
+    }
+    BENCHMARK(BM_VoiceCtrlRenderBlock)
+        ->ArgNames({"voices", "threads"})
+        ->Args({1, 1})->Args({8, 1})->Args({16, 1})->Args({32, 1})
+        ->Args({32, 2})->Args({32, 4})
+        ->UseRealTime();
+
+    // VoiceCtrl::RenderBlock（変調あり。コントロールレート毎の処理時間）
+    static void BM_VoiceCtrlModulation(benchmark::State& state)
+    {
+        const int voice_num = 32;
+
+        MidiCtrl::NoPortMode();
+        MidiCtrl* midictrl = MidiCtrl::Create();
+        Waveform::Create( 440.f, kFs );
+        VoiceCtrl* voicectrl = new VoiceCtrl();
+        Patch patch;
+        patch.poly_num       = VoiceBank::kLaneNum;
+        patch.control_frames = state.range(0);
+        patch.mod_matrix.SetSlot( 0, ModMatrix::kSrcLfo1, ModMatrix::kDstPitch, 0.3f );
+        patch.mod_matrix.SetSlot( 1, ModMatrix::kSrcLfo2, ModMatrix::kDstAmp, -0.5f );
+        patch.mod_matrix.SetSlot( 2, ModMatrix::kSrcEnv2, ModMatrix::kDstCutoff, 24.f );
+        patch.mod_matrix.SetSlot( 3, ModMatrix::kSrcModWheel, ModMatrix::kDstCutoff, 12.f );
+        voicectrl->SetPatch( patch );
+
+        press_keys( midictrl, voice_num );
+        voicectrl->Trigger();
+        midictrl->ResetStatusChange();
+
+        float out[kFrames];
+        auto start = std::chrono::steady_clock::now();
+        for( auto _ : state ) {
+            voicectrl->RenderBlock( out, kFrames );
+            benchmark::ClobberMemory();
+        }
+        auto stop = std::chrono::steady_clock::now();
+        set_render_counters( state, std::chrono::duration<double, std::nano>( stop - start ).count(), kFrames, voice_num );
+
+        delete voicectrl;
+        Waveform::Destroy();
+        MidiCtrl::Destroy();
+    }
+    BENCHMARK(BM_VoiceCtrlModulation)->ArgName("control_rate")->Arg(8)->Arg(16)->Arg(32)->Arg(kFrames)->UseRealTime();
+
+    // VoiceCtrl::RenderBlock（ユニゾン。7ボイスのスーパーソウで和音を鳴らす）
+    static void BM_VoiceCtrlUnison(benchmark::State& state)
+    {
+        const int note_num   = state.range(0);
+        const int thread_num = state.range(1);
+        const int unison_num = 7;
+
+        MidiCtrl::NoPortMode();
+        MidiCtrl* midictrl = MidiCtrl::Create();
+        Waveform::Create( 440.f, kFs );
+        VoiceCtrl* voicectrl = new VoiceCtrl();
+        Patch patch;
+        patch.poly_num   = note_num;
+        patch.unison_num = unison_num;
+        voicectrl->SetPatch( patch );
+        voicectrl->SetRenderThreadNum( thread_num );
+
+        press_keys( midictrl, note_num );
+        voicectrl->Trigger();
+        midictrl->ResetStatusChange();
+
+        float out[kFrames];
+        auto start = std::chrono::steady_clock::now();
+        for( auto _ : state ) {
+            voicectrl->RenderBlock( out, kFrames );
+            benchmark::ClobberMemory();
+        }
+        auto stop = std::chrono::steady_clock::now();
+        set_render_counters( state, std::chrono::duration<double, std::nano>( stop - start ).count(), kFrames, note_num * unison_num );
+
+        delete voicectrl;
+        Waveform::Destroy();
+        MidiCtrl::Destroy();
+    }
+    BENCHMARK(BM_VoiceCtrlUnison)
+        ->ArgNames({"notes", "threads"})
+        ->Args({1, 1})->Args({8, 1})->Args({8, 4})
+        ->UseRealTime();
+
+    // Synth::RenderBlock（MIDI処理、トリガー、ステレオMIXを含む）
+    static void BM_SynthRender(benchmark::State& state)
+    {
+        const int voice_num = state.range(0);
+        const int channels  = 2;
+
+        MidiCtrl::NoPortMode();
+        MidiCtrl* midictrl = MidiCtrl::Create();
+        Synth* synth = Synth::Create( 440.f, kFs );
+        Patch patch;
+        patch.poly_num = VoiceBank::kLaneNum;
+        synth->SetPatch( patch );
+        press_keys( midictrl, voice_num );
+
+        static float buf[kFrames * channels];
+        float* out[channels] = { &buf[0], &buf[kFrames] };
+        auto start = std::chrono::steady_clock::now();
+        for( auto _ : state ) {
+            synth->RenderBlock( out, kFrames, channels );
+            benchmark::ClobberMemory();
+        }
+        auto stop = std::chrono::steady_clock::now();
+        set_render_counters( state, std::chrono::duration<double, std::nano>( stop - start ).count(), kFrames, voice_num );
+
+        Synth::Destroy();
+        MidiCtrl::Destroy();
+    }
+    BENCHMARK(BM_SynthRender)->ArgName("voices")->Arg(1)->Arg(8)->Arg(16)->Arg(32);
+}
@@ -5,23 +5,31 @@
 #include <cstdlib>
 #include <string.h>
 #include <math.h>
+#include <chrono>
+#include <thread>
 
 #include <soundio/soundio.h>
+#include "common.h"
 #include "audio.h"
 
 
-static void write_sample_s16ne(char *ptr, double sample);
-static void write_sample_s32ne(char *ptr, double sample);
-static void write_sample_float32ne(char *ptr, double sample);
-static void write_sample_float64ne(char *ptr, double sample);
 static void write_callback(
     struct SoundIoOutStream *outstream,
     int frame_count_min,
     int frame_count_max
     );
+static void underflow_callback(struct SoundIoOutStream *outstream);
+static uint64_t audio_clock_ns();
+
+static const int kMonitorIntervalMs = 100;  // 適応モードで遅延を見直す間隔
 
 AudioCtrl* AudioCtrl::instance_ = nullptr;
 enum SoundIoBackend AudioCtrl::backend_ = SoundIoBackendNone;
+bool                AudioCtrl::dither_  = true;
+int                 AudioCtrl::rt_priority_ = 0;
+double              AudioCtrl::latency_target_ = 0.0;
+std::atomic<bool>   AudioCtrl::adaptive_( false );
+int                 AudioCtrl::render_ahead_ = 0;
 
 
 /**
@@ -44,7 +52,21 @@ AudioCtrl* AudioCtrl::Create()
  */
 void AudioCtrl::Destroy()
 {
+    if (instance_->monitor_) {
+        instance_->monitor_quit_ = true;
+        instance_->monitor_->join();
+        delete instance_->monitor_;
+    }
     soundio_outstream_destroy(instance_->outstream_);
+    if (instance_->producer_) {
+        instance_->producer_quit_ = true;
+        instance_->producer_->join();
+        delete instance_->producer_;
+    }
+    delete instance_->ring_;
+    delete[] instance_->producer_buf_;
+    delete[] instance_->producer_out_;
+    delete[] instance_->render_buf_;
     soundio_device_unref(instance_->device_);
     soundio_destroy(instance_->soundio_);
 
@@ -60,11 +82,6 @@ AudioCtrl* AudioCtrl::GetInstance()
     return instance_;
 }
 
-static void underflow_callback(struct SoundIoOutStream *outstream) {
-    static int count = 0;
-    fprintf(stderr, "underflow %d\n", count++);
-}
-
 /**
  * @brief initialize class
  */
@@ -109,7 +126,97 @@ bool AudioCtrl::Initialize()
         return 1;
     }
 
-    // initialize outstream
+    render_callback_func_     = nullptr;
+    render_callback_userdata_ = nullptr;
+    render_buf_               = nullptr;
+    rt_ready_                 = false;
+    underflow_count_          = 0;
+    start_ns_                 = audio_clock_ns();
+    callback_pos_             = 0;
+    callback_max_ns_          = 0;
+    monitor_                  = nullptr;
+    monitor_quit_             = false;
+    ring_                     = nullptr;
+    ring_depth_               = 0;
+    producer_                 = nullptr;
+    producer_quit_            = false;
+    producer_buf_             = nullptr;
+    producer_out_             = nullptr;
+    ring_underrun_            = 0;
+    ring_min_fill_            = 0;
+    for (int ix = 0; ix < UnderflowEvent::kRecentNum; ix++) {
+        callback_ns_[ix] = 0;
+    }
+    channels_                 = 0;
+    sample_rate_              = 0;
+
+    // 変換関数はここで1回だけ選ぶ
+    static const enum SoundIoFormat kFormats[] = {
+        SoundIoFormatFloat32NE, SoundIoFormatFloat64NE, SoundIoFormatS32NE, SoundIoFormatS16NE,
+    };
+    format_ = SoundIoFormatInvalid;
+    for (size_t ix = 0; ix < sizeof(kFormats) / sizeof(kFormats[0]); ix++) {
+        if (soundio_device_supports_format(device_, kFormats[ix])) {
+            format_ = kFormats[ix];
+            break;
+        }
+    }
+    if (format_ == SoundIoFormatInvalid ||
+        !converter_.Setup(SampleConverter::FromSoundIoFormat(format_), dither_)) {
+        fprintf(stderr, "No suitable device format available.\n");
+        return false;
+    }
+    fprintf(stderr, "Output format: %s%s\n", soundio_format_string(format_),
+            converter_.IsDithering() ? " (dither)" : "");
+
+    if (!OpenStream(latency_target_)) {
+        return false;
+    }
+
+    // 適応モードの遅延は、デバイスの範囲内で変える
+    LatencyTuner::Config config;
+    config.min_sec = MAX(config.min_sec, device_->software_latency_min);
+    config.max_sec = MIN(config.max_sec, device_->software_latency_max);
+    config.max_sec = MAX(config.max_sec, config.min_sec);
+    tuner_.Reset(config, LatencyGet(), 0.0);
+
+    // レンダリング用の作業バッファ（チャンネル毎に分ける）
+    render_buf_ = new float[kMaxWriteFrames * channels_];
+    for( int ch=0; ch<channels_; ch++ ) {
+        render_ch_[ch] = &render_buf_[kMaxWriteFrames * ch];
+    }
+
+    // 先行レンダリング用のリングと作業バッファ（深さはブロック単位で、リングに入る範囲にする）
+    if (render_ahead_ > 0) {
+        const int channels = channels_;
+        const int capacity = (int)(RenderRing::kCapacity / channels) - kMaxBlockFrames;
+        ring_depth_   = (render_ahead_ + kMaxBlockFrames - 1) / kMaxBlockFrames * kMaxBlockFrames;
+        ring_depth_   = MAX(kMaxBlockFrames, MIN(ring_depth_, capacity / kMaxBlockFrames * kMaxBlockFrames));
+        ring_         = new RenderRing();
+        producer_buf_ = new float[kMaxWriteFrames * channels];
+        producer_out_ = new float[kMaxWriteFrames * channels];
+        for (int ch = 0; ch < channels; ch++) {
+            producer_ch_[ch] = &producer_buf_[kMaxWriteFrames * ch];
+        }
+        fprintf(stderr, "Render ahead: %d frames\n", ring_depth_);
+    }
+
+    return true;
+}
+
+/**
+ * @brief 出力ストリームを作って開く
+ * @note  作業バッファとリングは最初のストリームに合わせて確保するので、
+ *        開き直したストリームのチャンネル数やサンプリング周波数が変わっていれば失敗とする
+ *
+ * @param[in] latency 要求する遅延[s]（0ならバックエンドに任せる）
+ * @retval true  成功
+ * @retval false 失敗
+ */
+bool AudioCtrl::OpenStream( double latency )
+{
+    int err;
+
     outstream_ = soundio_outstream_create(device_);
     if (!outstream_) {
         fprintf(stderr, "out of memory\n");
@@ -118,23 +225,8 @@ bool AudioCtrl::Initialize()
     outstream_->underflow_callback = underflow_callback;
     outstream_->write_callback     = write_callback;
     outstream_->userdata           = this;
-
-    if (soundio_device_supports_format(device_, SoundIoFormatFloat32NE)) {
-        outstream_->format = SoundIoFormatFloat32NE;
-        write_sample_ = write_sample_float32ne;
-    } else if (soundio_device_supports_format(device_, SoundIoFormatFloat64NE)) {
-        outstream_->format = SoundIoFormatFloat64NE;
-        write_sample_ = write_sample_float64ne;
-    } else if (soundio_device_supports_format(device_, SoundIoFormatS32NE)) {
-        outstream_->format = SoundIoFormatS32NE;
-        write_sample_ = write_sample_s32ne;
-    } else if (soundio_device_supports_format(device_, SoundIoFormatS16NE)) {
-        outstream_->format = SoundIoFormatS16NE;
-        write_sample_ = write_sample_s16ne;
-    } else {
-        fprintf(stderr, "No suitable device format available.\n");
-        return false;
-    }
+    outstream_->format             = format_;
+    outstream_->software_latency   = latency;
 
     if ((err = soundio_outstream_open(outstream_))) {
         fprintf(stderr, "unable to open device: %s", soundio_strerror(err));
@@ -145,11 +237,58 @@ bool AudioCtrl::Initialize()
         fprintf(stderr, "unable to set channel layout: %s\n", soundio_strerror(outstream_->layout_error));
     }
 
-    fprintf(stderr, "Software latency: %f sec\n", outstream_->software_latency);
+    if (channels_ == 0) {
+        channels_    = outstream_->layout.channel_count;
+        sample_rate_ = outstream_->sample_rate;
+    } else if (outstream_->layout.channel_count != channels_ || outstream_->sample_rate != sample_rate_) {
+        fprintf(stderr, "reopened stream changed its format: %d ch %d Hz (expected %d ch %d Hz)\n",
+                outstream_->layout.channel_count, outstream_->sample_rate, channels_, sample_rate_);
+        return false;
+    }
 
+    latency_ = outstream_->software_latency;
+    fprintf(stderr, "Software latency: %f sec\n", outstream_->software_latency);
     return true;
 }
 
+/**
+ * @brief 遅延を変えてストリームを開き直す（監視スレッドから呼ぶ）
+ * @note  新しいストリームのオーディオスレッドも、最初のコールバックでリアルタイム設定をする
+ *        （先行レンダリングのリングはそのまま使い続ける）
+ *        新しい遅延で開けなければ元の遅延で開き直す。それも駄目なら出力は止まったままにする
+ *
+ * @param[in] latency 要求する遅延[s]
+ * @retval true  出力している（遅延は変わっていないこともある）
+ * @retval false どちらの遅延でも開けず、出力が止まった
+ */
+bool AudioCtrl::ReopenStream( double latency )
+{
+    const double tries[] = { latency, LatencyGet() };
+
+    for (size_t ix = 0; ix < sizeof(tries) / sizeof(tries[0]); ix++) {
+        int err;
+
+        soundio_outstream_destroy(outstream_);
+        outstream_ = nullptr;
+        if (!ring_) {
+            rt_ready_ = false;  // 先行レンダリングでは、設定したレンダリングスレッドはそのまま
+        }
+
+        if (!OpenStream(tries[ix])) {
+            continue;
+        }
+        if ((err = soundio_outstream_start(outstream_))) {
+            fprintf(stderr, "unable to start device: %s\n", soundio_strerror(err));
+            continue;
+        }
+        return true;
+    }
+
+    soundio_outstream_destroy(outstream_);
+    outstream_ = nullptr;
+    return false;
+}
+
 /**
  * @brief start
  */
@@ -157,7 +296,17 @@ void AudioCtrl::Start()
 {
     int err;
 
-    fprintf(stderr, "outstream_->sample_rate: %d\n", outstream_->sample_rate);
+    fprintf(stderr, "outstream_->sample_rate: %d\n", sample_rate_);
+
+    // 先行レンダリングでは、溜まってからデバイスを動かす
+    if (ring_ && !producer_) {
+        ring_min_fill_ = ring_depth_;
+        producer_ = new std::thread(&AudioCtrl::ProducerMain, this);
+        for (int ms = 0; ms < 1000 && RenderAheadAvailable() < ring_depth_; ms++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
     if ((err = soundio_outstream_start(outstream_))) {
         fprintf(stderr, "unable to start device: %s\n", soundio_strerror(err));
         return;
@@ -167,33 +316,199 @@ void AudioCtrl::Start()
         soundio_wait_events(soundio_);
     }
 #endif
+
+    if (adaptive_ && !monitor_) {
+        monitor_ = new std::thread(&AudioCtrl::MonitorMain, this);
+    }
     return;
 }
 
-///////////////////////////////////////////////////////////////////////////////
+/**
+ * @brief 先行レンダリングのスレッド
+ * @note  リアルタイム設定はデバイスのスレッドではなくこのスレッドで行う。
+ *        リングがring_depth_まで溜まっていれば、半ブロック分眠って待つ
+ */
+void AudioCtrl::ProducerMain()
+{
+    const int channels = channels_;
+    const std::chrono::microseconds wait((int64_t)(kMaxBlockFrames * 0.5e6 / sample_rate_));
+
+    SetupAudioThread();
+
+    while (!producer_quit_) {
+        // 足りない分をブロック単位でまとめて1回でレンダリングする（MIDIイベントはその中に配置される）
+        int frames = (ring_depth_ - RenderAheadAvailable()) / kMaxBlockFrames * kMaxBlockFrames;
+        frames = MIN(frames, kMaxWriteFrames);
+        if (frames <= 0) {
+            std::this_thread::sleep_for(wait);
+            continue;
+        }
 
-static void write_sample_s16ne(char *ptr, double sample) {
-    int16_t *buf = (int16_t *)ptr;
-    double range = (double)INT16_MAX - (double)INT16_MIN;
-    double val = sample * range / 2.0;
-    *buf = val;
+        if (render_callback_func_) {
+            render_callback_func_(producer_ch_, frames, channels, render_callback_userdata_);
+        } else {
+            for (int ch = 0; ch < channels; ch++) {
+                memset(producer_ch_[ch], 0, sizeof(float) * frames);
+            }
+        }
+
+        for (int ix = 0; ix < frames; ix++) {
+            for (int ch = 0; ch < channels; ch++) {
+                producer_out_[ix * channels + ch] = producer_ch_[ch][ix];
+            }
+        }
+        ring_->PutN(producer_out_, (size_t)frames * channels);
+    }
 }
 
-static void write_sample_s32ne(char *ptr, double sample) {
-    int32_t *buf = (int32_t *)ptr;
-    double range = (double)INT32_MAX - (double)INT32_MIN;
-    double val = sample * range / 2.0;
-    *buf = val;
+/**
+ * @brief リングに溜まっているフレーム数
+ */
+int AudioCtrl::RenderAheadAvailable()
+{
+    return (int)(ring_->GetLength() / channels_);
 }
 
-static void write_sample_float32ne(char *ptr, double sample) {
-    float *buf = (float *)ptr;
-    *buf = sample;
+/**
+ * @brief リングからframes分をrender_ch_へ取り出す
+ * @note  足りない分は無音にし、アンダーランとして数える
+ *
+ * @param[in] frames フレーム数(kMaxWriteFrames以下)
+ */
+void AudioCtrl::RenderAheadRead( int frames )
+{
+    const int channels = channels_;
+
+    RenderRing::Span span[2];
+    int avail = (int)(ring_->ReadSpans(&span[0], &span[1]) / channels);
+    int num   = MIN(frames, avail);
+
+    // インターリーブからチャンネル毎へ（フレームはリングの終端で分かれていることがある）
+    int ch = 0, frame = 0;
+    size_t rest = (size_t)num * channels;
+    for (int sp = 0; sp < 2 && rest > 0; sp++) {
+        size_t n = MIN(rest, span[sp].num);
+        for (size_t ix = 0; ix < n; ix++) {
+            render_ch_[ch][frame] = span[sp].data[ix];
+            if (++ch == channels) {
+                ch = 0;
+                frame++;
+            }
+        }
+        rest -= n;
+    }
+    ring_->Consume((size_t)num * channels);
+
+    if (num < frames) {
+        for (int c = 0; c < channels; c++) {
+            memset(&render_ch_[c][num], 0, sizeof(float) * (frames - num));
+        }
+        ring_underrun_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    int fill = avail - num;
+    if (fill < ring_min_fill_.load(std::memory_order_relaxed)) {
+        ring_min_fill_.store(fill, std::memory_order_relaxed);
+    }
 }
 
-static void write_sample_float64ne(char *ptr, double sample) {
-    double *buf = (double *)ptr;
-    *buf = sample;
+/**
+ * @brief 先行レンダリングの状態を取得する
+ *
+ * @param[out] stats     状態
+ * @param[in]  reset_min trueならmin_fill_framesを今の深さに戻す
+ * @retval true  取得した
+ * @retval false 先行レンダリングしていない
+ */
+bool AudioCtrl::RenderAheadStatsGet( RenderAheadStats* stats, bool reset_min )
+{
+    if (!ring_) {
+        return false;
+    }
+    stats->depth_frames    = ring_depth_;
+    stats->fill_frames     = RenderAheadAvailable();
+    stats->min_fill_frames = reset_min ? ring_min_fill_.exchange(ring_depth_, std::memory_order_relaxed)
+                                       : ring_min_fill_.load(std::memory_order_relaxed);
+    stats->underruns       = ring_underrun_.load(std::memory_order_relaxed);
+    return true;
+}
+
+/**
+ * @brief 適応モードの監視スレッド
+ * @note  アンダーフローの数とコールバック処理時間をLatencyTunerに渡し、遅延が変われば開き直す
+ */
+void AudioCtrl::MonitorMain()
+{
+    uint32_t seen = UnderflowCountGet();
+
+    while (!monitor_quit_) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(kMonitorIntervalMs));
+
+        uint32_t count   = UnderflowCountGet();
+        uint32_t max_ns  = callback_max_ns_.exchange(0, std::memory_order_relaxed);
+        double   now_sec = (audio_clock_ns() - start_ns_) * 1.0e-9;
+        double   current = LatencyGet();
+        double   next    = tuner_.Update(now_sec, count - seen, max_ns);
+        seen = count;
+
+        if (next != current) {
+            if (!ReopenStream(next)) {
+                // 遅延の調整のために再生を止めてしまわないよう、適応モードをやめる
+                fprintf(stderr, "unable to reopen the output stream; adaptive latency disabled, audio stopped\n");
+                adaptive_ = false;
+                break;
+            }
+            fprintf(stderr, "Software latency: %.1f ms -> %.1f ms (underflows: %u)\n",
+                    current * 1000.0, LatencyGet() * 1000.0, count);
+            // 開き直している間のアンダーフローは数えない。遅延はデバイスが丸めた値に合わせる
+            seen = UnderflowCountGet();
+            tuner_.SetLatency(LatencyGet());
+        }
+    }
+}
+
+/**
+ * @brief オーディオスレッドをリアルタイム処理向けに設定する
+ * @note  write_callbackから毎回呼ばれ、最初の1回だけ設定する。結果はRtStatusGetで読む
+ */
+void AudioCtrl::SetupAudioThread()
+{
+    if (rt_ready_.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    RtThread::Status status;
+
+    status.ftz = RtThread::EnableFlushToZero();
+    if (rt_priority_ > 0) {
+        status.sched_request = true;
+        status.sched_ok      = RtThread::SetFifoPriority(rt_priority_);
+    }
+    RtThread::GetPriority(&status.policy, &status.priority);
+    status.prefault_bytes = RtThread::PrefaultStack();
+
+    rt_status_ = status;
+    rt_ready_.store(true, std::memory_order_release);
+}
+
+/**
+ * @brief オーディオスレッドの設定結果を取得する
+ *
+ * @param[out] status     設定結果
+ * @param[in]  timeout_ms 最初のコールバックを待つ最大時間[ms]
+ * @retval true  取得できた
+ * @retval false まだコールバックが呼ばれていない
+ */
+bool AudioCtrl::RtStatusGet( RtThread::Status* status, int timeout_ms )
+{
+    for (int ms = 0; !rt_ready_.load(std::memory_order_acquire); ms++) {
+        if (ms >= timeout_ms) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    *status = rt_status_;
+    return true;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -208,6 +523,7 @@ static void write_sample_float64ne(char *ptr, double sample) {
 static void write_callback(struct SoundIoOutStream *outstream, int frame_count_min, int frame_count_max)
 {
     AudioCtrl* audioctrl = (AudioCtrl*)outstream->userdata;
+    uint64_t   start     = audio_clock_ns();
 
     double float_sample_rate = outstream->sample_rate;
     double seconds_per_frame = 1.0 / float_sample_rate;
@@ -220,8 +536,18 @@ static void write_callback(struct SoundIoOutStream *outstream, int frame_count_m
     int frames_left = frame_count_max;
 #endif
 
+    // 先行レンダリングではレンダリングスレッドが設定する。溜まっている分だけ書けばよい
+    if (audioctrl->IsRenderAhead()) {
+        frames_left = MAX(frame_count_min, MIN(frames_left, audioctrl->RenderAheadAvailable()));
+    } else {
+        audioctrl->SetupAudioThread();
+    }
+
     while (frames_left > 0) {
         int frame_count = frames_left;
+        if (frame_count > AudioCtrl::kMaxWriteFrames) {
+            frame_count = AudioCtrl::kMaxWriteFrames;
+        }
         if ((err = soundio_outstream_begin_write(outstream, &areas, &frame_count))) {
             fprintf(stderr, "unrecoverable stream error: %s\n", soundio_strerror(err));
             exit(1);
@@ -232,14 +558,25 @@ static void write_callback(struct SoundIoOutStream *outstream, int frame_count_m
         }
 
         const struct SoundIoChannelLayout *layout = &outstream->layout;
-        for (int frame = 0; frame < frame_count; frame += 1) {
-            double sample = audioctrl->signal_callback_func_(audioctrl->signal_callback_userdata_);
-            for (int channel = 0; channel < layout->channel_count; channel += 1) {
-                audioctrl->write_sample_(areas[channel].ptr, sample);
-                areas[channel].ptr += areas[channel].step;
+        const int channels = layout->channel_count;
+
+        if (audioctrl->IsRenderAhead()) {
+            // レンダリングスレッドが溜めたものを取り出すだけ
+            audioctrl->RenderAheadRead(frame_count);
+        } else {
+            // 書き込み領域全体を1回でレンダリングする（MIDIイベントの位置はその中で決まる）
+            if (audioctrl->render_callback_func_) {
+                audioctrl->render_callback_func_(audioctrl->render_ch_, frame_count, channels, audioctrl->render_callback_userdata_);
+            } else {
+                for (int ch = 0; ch < channels; ch++) {
+                    memset(audioctrl->render_ch_[ch], 0, sizeof(float) * frame_count);
+                }
             }
         }
 
+        // 書き込み領域全体をまとめて1回で変換する
+        audioctrl->converter_.Write(areas, audioctrl->render_ch_, channels, frame_count);
+
         if ((err = soundio_outstream_end_write(outstream))) {
             if (err == SoundIoErrorUnderflow)
                 return;
@@ -249,6 +586,101 @@ static void write_callback(struct SoundIoOutStream *outstream, int frame_count_m
 
         frames_left -= frame_count;
     }
+
+    audioctrl->CallbackTimeRecord((uint32_t)MIN(audio_clock_ns() - start, (uint64_t)UINT32_MAX));
+}
+
+/**
+ * @brief underflow_callback
+ */
+static void underflow_callback(struct SoundIoOutStream *outstream)
+{
+    AudioCtrl* audioctrl = (AudioCtrl*)outstream->userdata;
+    audioctrl->UnderflowRecord();
+}
+
+/**
+ * @brief audio_clock_ns
+ */
+static uint64_t audio_clock_ns()
+{
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>( steady_clock::now().time_since_epoch() ).count();
+}
+
+/**
+ * @brief コールバックの処理時間を記録する（write_callbackから呼ぶ）
+ *
+ * @param[in] ns 処理時間[ns]
+ */
+void AudioCtrl::CallbackTimeRecord( uint32_t ns )
+{
+    uint32_t pos = callback_pos_.load(std::memory_order_relaxed);
+    callback_ns_[pos % UnderflowEvent::kRecentNum].store(ns, std::memory_order_relaxed);
+    callback_pos_.store(pos + 1, std::memory_order_release);
+
+    if (ns > callback_max_ns_.load(std::memory_order_relaxed)) {
+        callback_max_ns_.store(ns, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief アンダーフローを記録する（underflow_callbackから呼ぶ）
+ * @note  ロックもメモリ確保もしない。記録が溢れたら捨てる（回数は数える）
+ */
+void AudioCtrl::UnderflowRecord()
+{
+    UnderflowEvent event;
+    event.time_ns = audio_clock_ns() - start_ns_;
+    event.count   = underflow_count_.fetch_add(1, std::memory_order_relaxed) + 1;
+    event.latency = (float)LatencyGet();
+
+    uint32_t pos = callback_pos_.load(std::memory_order_acquire);
+    for (int ix = 0; ix < UnderflowEvent::kRecentNum; ix++) {
+        event.recent_ns[ix] = ((uint32_t)ix < pos) ?
+            callback_ns_[(pos - 1 - ix) % UnderflowEvent::kRecentNum].load(std::memory_order_relaxed) : 0;
+    }
+
+    underflow_log_.Put(event);
+}
+
+/**
+ * @brief アンダーフローの記録を古い順に取り出す
+ *
+ * @param[out] event 記録
+ * @retval true  取り出した
+ * @retval false 記録が無い
+ */
+bool AudioCtrl::UnderflowEventGet( UnderflowEvent* event )
+{
+    return underflow_log_.Get(event);
+}
+
+/**
+ * @brief 溜まっているアンダーフローの記録を書き出す
+ *
+ * @param[in] fp 出力先
+ */
+void AudioCtrl::DumpUnderflows( FILE* fp )
+{
+    fprintf(fp, "software latency: %.1fms%s, underflows: %u\n",
+            LatencyGet() * 1000.0, adaptive_ ? " (adaptive)" : "", UnderflowCountGet());
+
+    UnderflowEvent event;
+    while (UnderflowEventGet(&event)) {
+        fprintf(fp, "  #%u at %.3fs latency=%.1fms callbacks(ns, newest first):",
+                event.count, event.time_ns * 1.0e-9, event.latency * 1000.0);
+        for (int ix = 0; ix < UnderflowEvent::kRecentNum; ix++) {
+            fprintf(fp, " %u", event.recent_ns[ix]);
+        }
+        fprintf(fp, "\n");
+    }
+
+    RenderAheadStats stats;
+    if (RenderAheadStatsGet(&stats, false)) {
+        fprintf(fp, "render ahead: depth=%d fill=%d min_fill=%d underruns=%u\n",
+                stats.depth_frames, stats.fill_frames, stats.min_fill_frames, stats.underruns);
+    }
 }
 
 /**
@@ -256,29 +688,54 @@ static void write_callback(struct SoundIoOutStream *outstream, int frame_count_m
  */
 int AudioCtrl::SampleRateGet()
 {
-    return outstream_->sample_rate;
+    return sample_rate_;
+}
+
+/**
+ * @brief ChannelNumGet
+ */
+int AudioCtrl::ChannelNumGet()
+{
+    return channels_;
 }
 
 /**
- * @brief SignalCallbackSet
+ * @brief RenderCallbackSet
  */
-void AudioCtrl::SignalCallbackSet( SignalCallbackFunc func, void* userdata )
+void AudioCtrl::RenderCallbackSet( RenderCallbackFunc func, void* userdata )
 {
-    signal_callback_func_     = func;
-    signal_callback_userdata_ = userdata;
+    render_callback_func_     = func;
+    render_callback_userdata_ = userdata;
 }
 
 /**
- * @brief SignalCallbackSet
+ * @brief RenderCallbackUnset
  */
-void AudioCtrl::SignalCallbackUnset()
+void AudioCtrl::RenderCallbackUnset()
 {
-    signal_callback_func_     = nullptr;
-    signal_callback_userdata_ = nullptr;
+    render_callback_func_     = nullptr;
+    render_callback_userdata_ = nullptr;
 }
 
 
 ///////////////////////////////////////////////////////////////////////////////
 void AudioCtrl::DummyMode() {
     backend_ = SoundIoBackendDummy;
+}
+
+void AudioCtrl::DitherSet( bool dither ) {
+    dither_ = dither;
+}
+
+void AudioCtrl::RealtimeSet( int priority ) {
+    rt_priority_ = priority;
+}
+
+void AudioCtrl::LatencySet( double sec, bool adaptive ) {
+    latency_target_ = sec;
+    adaptive_       = adaptive;
+}
+
+void AudioCtrl::RenderAheadSet( int frames ) {
+    render_ahead_ = frames;
 }
\ No newline at end of file
@@ -3,8 +3,17 @@
  */
 #pragma once
 
+#include <atomic>
+#include <cstdio>
+#include <thread>
+
 #include <soundio/soundio.h>
 
+#include "fifo.h"
+#include "latency_tuner.h"
+#include "rt_thread.h"
+#include "sample_converter.h"
+
 class AudioCtrl {
 private:
     AudioCtrl(){}
@@ -15,29 +24,129 @@ private:
     static AudioCtrl* instance_;
 
     bool Initialize();
+    bool OpenStream( double latency );
+    bool ReopenStream( double latency );
+    void MonitorMain();
+    void ProducerMain();
 
     struct SoundIo          *soundio_;
     struct SoundIoOutStream *outstream_;
     struct SoundIoDevice    *device_;
 
     static enum SoundIoBackend backend_;
+    static bool                dither_;
+    static int                 rt_priority_;  // オーディオスレッドのSCHED_FIFO優先度（0なら要求しない）
+    static double              latency_target_;  // 開く時に要求する遅延[s]（0ならバックエンドに任せる）
+    static std::atomic<bool>   adaptive_;        // アンダーフローに応じて遅延を変える（開き直せなければ監視スレッドが下ろす）
+    static int                 render_ahead_;    // 先行レンダリングの深さ[frames]（0なら使わない）
+
+    enum SoundIoFormat format_;
+    int                channels_;     // 最初に開いたストリームのチャンネル数（開き直しても変えない）
+    int                sample_rate_;  // 同、サンプリング周波数
+
+    RtThread::Status  rt_status_;  // オーディオスレッドの設定結果
+    std::atomic<bool> rt_ready_;   // rt_status_を書き終えた
+
+public:
+    /**
+     * @brief アンダーフローの記録
+     */
+    struct UnderflowEvent {
+        static const int kRecentNum = 8;
+        uint64_t time_ns;                // Startからの時間[ns]
+        uint32_t count;                  // 通算何回目か(1～)
+        float    latency;                // その時の遅延[s]
+        uint32_t recent_ns[kRecentNum];  // 直前のコールバック処理時間[ns]（新しい順、無ければ0）
+    };
+
+    /**
+     * @brief 先行レンダリングの状態
+     */
+    struct RenderAheadStats {
+        int      depth_frames;     // 溜めておくフレーム数
+        int      fill_frames;      // 今溜まっているフレーム数
+        int      min_fill_frames;  // 前回のリセットからの最小
+        uint32_t underruns;        // レンダリングが間に合わず無音で埋めた回数
+    };
+
+private:
+    // アンダーフローの記録（書き手はunderflow_callback、読み手はUnderflowEventGet）
+    FIFO<UnderflowEvent, 64, true> underflow_log_;
+    std::atomic<uint32_t>          underflow_count_;
+    uint64_t                       start_ns_;
+
+    // 直近のコールバック処理時間（書き手はwrite_callback）
+    std::atomic<uint32_t> callback_ns_[UnderflowEvent::kRecentNum];
+    std::atomic<uint32_t> callback_pos_;
+    std::atomic<uint32_t> callback_max_ns_;  // 監視スレッドが最後に読んでからの最大
+
+    std::atomic<double> latency_;       // 現在の遅延[s]
+    LatencyTuner        tuner_;
+    std::thread*        monitor_;       // 適応モードで遅延を見直すスレッド
+    std::atomic<bool>   monitor_quit_;
+
+    // 先行レンダリング
+    //   レンダリングスレッドが不足分をkMaxBlockFrames単位でring_へ書き(インターリーブ)、write_callbackは読み出すだけにする
+    typedef FIFO<float, (1 << 17), true> RenderRing;
+    RenderRing*           ring_;            // 先行レンダリングしない時はnullptr
+    int                   ring_depth_;      // ring_に溜めておくフレーム数
+    std::thread*          producer_;
+    std::atomic<bool>     producer_quit_;
+    float*                producer_buf_;    // kMaxWriteFrames * channel_count (planar)
+    float*                producer_ch_[SOUNDIO_MAX_CHANNELS];
+    float*                producer_out_;    // kMaxWriteFrames * channel_count (インターリーブ)
+    std::atomic<uint32_t> ring_underrun_;   // 読み出す時に足りなかった回数
+    std::atomic<int>      ring_min_fill_;   // 読み出した後の残りの最小[frames]
 
 public:
     static AudioCtrl* Create();
     static void       Destroy();
     static AudioCtrl* GetInstance();
 
-    void (*write_sample_)(char *ptr, double sample);
+    // シンセが内部で1度に処理する最大フレーム数（レンダリング要求はこれより長いこともある）
+    static const int kMaxBlockFrames = 256;
+    // 1回の書き込み領域(begin_write～end_write)、1回のレンダリング要求の最大フレーム数
+    static const int kMaxWriteFrames = 4096;
+
+    // planarのfloatバッファからデバイスの形式へ変換し、areasへ書き込む
+    SampleConverter converter_;
 
     void Start();
+    void SetupAudioThread();  // オーディオスレッドから呼ぶ（設定するのは最初の1回だけ）
+    bool RtStatusGet( RtThread::Status* status, int timeout_ms );
     int  SampleRateGet();
+    int  ChannelNumGet();
+    double LatencyGet() { return latency_.load( std::memory_order_relaxed ); }
+
+    // アンダーフローの記録（write_callback/underflow_callbackから呼ぶ）
+    void CallbackTimeRecord( uint32_t ns );
+    void UnderflowRecord();
+
+    // 先行レンダリング（write_callbackから呼ぶ）
+    bool IsRenderAhead() { return ring_ != nullptr; }
+    int  RenderAheadAvailable();
+    void RenderAheadRead( int frames );
+    bool RenderAheadStatsGet( RenderAheadStats* stats, bool reset_min );
+
+    bool     UnderflowEventGet( UnderflowEvent* event );  // 古い順に取り出す
+    uint32_t UnderflowCountGet() { return underflow_count_.load( std::memory_order_relaxed ); }
+    void     DumpUnderflows( FILE* fp );
+
+    // out[ch] (ch=0～channels-1)にframesサンプルずつ書き込む(planar)。framesはkMaxWriteFrames以下
+    typedef void (*RenderCallbackFunc)( float* const* out, int frames, int channels, void* userdata );
+    RenderCallbackFunc render_callback_func_;
+    void*              render_callback_userdata_;
+    void RenderCallbackSet( RenderCallbackFunc func, void* userdata );
+    void RenderCallbackUnset();
 
-    typedef double (*SignalCallbackFunc)( void* );
-    SignalCallbackFunc signal_callback_func_;
-    void*              signal_callback_userdata_;
-    void SignalCallbackSet( SignalCallbackFunc func, void* userdata );
-    void SignalCallbackUnset();
+    float* render_buf_;                        // kMaxWriteFrames * channel_count
+    float* render_ch_[SOUNDIO_MAX_CHANNELS];   // render_buf_のチャンネル毎の先頭
 
     // test func
     static void DummyMode();
+    static void DitherSet( bool dither );  // 整数形式の出力にディザを加える（Create前に呼ぶ）
+    static void RealtimeSet( int priority );  // オーディオスレッドをSCHED_FIFOにする（Start前に呼ぶ）
+    static int  RealtimeGet() { return rt_priority_; }
+    static void LatencySet( double sec, bool adaptive );  // 遅延の目標と適応モード（Create前に呼ぶ）
+    static void RenderAheadSet( int frames );  // 先行レンダリングの深さ。0なら使わない（Create前に呼ぶ）
 };
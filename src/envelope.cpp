@@ -2,9 +2,14 @@
  * @file envelope.cpp
  */
 #include <cstdio>
+#include <math.h>
 
 #include "envelope.h"
 
+// 指数カーブの深さ（目標値を通り越した先の漸近値を、段階の幅のratio倍の位置に置く）
+static const float kAttackRatio = 0.3f;
+static const float kDecayRatio  = 0.001f;
+
 /**
  * @brief constructor
  */
@@ -12,14 +17,14 @@ Envelope::Envelope( float fs )
 {
     fs_ = fs;
 
-    out_lv_prev_ = 0.f;
-
     attack_ms_  = 0;
     decay_ms_   = 0;
     sustain_lv_ = 1.f;
     release_ms_ = 0;
+    curve_      = kLinear;
 
-    count_ = 0.f;
+    lv_ = 0.f;
+    SetState( kIdle );
 }
 
 /**
@@ -27,85 +32,167 @@ Envelope::Envelope( float fs )
  */
 void Envelope::SetState(enum EnvelopeState state)
 {
-    state_ = state;
-    count_ = 0.f;
+    // 長さ0の段階は飛ばす
+    for(;;) {
+        state_ = state;
+
+        switch (state_)
+        {
+        case kAttack:
+            StartSegment( 1.f, attack_ms_, kAttackRatio );
+            break;
+
+        case kDecay:
+            StartSegment( sustain_lv_, decay_ms_, kDecayRatio );
+            break;
+
+        case kRelease:
+            StartSegment( 0.f, release_ms_, kDecayRatio );
+            break;
+
+        case kSustain:
+            lv_ = sustain_lv_;
+            return;
+
+        case kIdle:
+        default:
+            lv_ = 0.f;
+            return;
+        }
+
+        if( remain_ != 0 ) {
+            return;
+        }
+        lv_   = target_;
+        state = (state_ == kAttack) ? kDecay : ((state_ == kDecay) ? kSustain : kIdle);
+    }
 }
 
 /**
- * @brief Process
+ * @brief 今のレベルからtargetへtime_msで移る段階を始める
+ *
+ * @param[in] target  段階の終わりのレベル
+ * @param[in] time_ms 段階の長さ
+ * @param[in] ratio   指数カーブの深さ
  */
-float Envelope::Process( float in )
+void Envelope::StartSegment(float target, int time_ms, float ratio)
 {
-    count_++;
-    float elapsed_ms = (count_ * 1000.0) / fs_;
+    target_ = target;
+    remain_ = 0;
+    if( time_ms <= 0 ) {
+        return;
+    }
+    float samples = time_ms * fs_ / 1000.f + 0.5f;
+    remain_ = (samples < 1.f) ? 1 : (uint32_t)samples;
 
-    float out_lv;
-    switch (state_)
-    {
-    case kIdle:
-        out_lv = 0;
-        break;
+    if( curve_ == kExponential ) {
+        // 漸近値overshootへ向かう1次遅れ。remain_サンプルでちょうどtargetに着くように係数を選ぶ
+        float overshoot = target + ratio * (target - lv_);
+        mul_ = expf( -logf( (1.f + ratio) / ratio ) / remain_ );
+        add_ = overshoot * (1.f - mul_);
+    }
+    else {
+        mul_ = 1.f;
+        add_ = (target - lv_) / remain_;
+    }
+}
 
-    case kAttack:
-        if( attack_ms_ != 0 ) {
-            out_lv = elapsed_ms / attack_ms_;
-        }
-        else {
-            out_lv = 1.f;
-        }
+/**
+ * @brief 1サンプル処理する
+ */
+float Envelope::Process( float in )
+{
+    float lv;
+    Run( &lv, 1 );
+    return in * lv;
+}
 
-        // end attack
-        if( elapsed_ms >= attack_ms_ ) {
-            SetState( kDecay );
-        }
-        break;
+/**
+ * @brief 1ブロック分のレベルを求める
+ *
+ * @param[out] out    レベル（0～1）
+ * @param[in]  frames
+ * @retval 休止状態になった最初のサンプル位置（ブロック内で休止しなければframes）
+ */
+int Envelope::Process( float* out, int frames )
+{
+    return Run( out, frames );
+}
 
-    case kDecay:
-        if( decay_ms_ != 0 ) {
-            out_lv = 1.f - (sustain_lv_ * (elapsed_ms / decay_ms_));
-        }
-        else {
-            out_lv = sustain_lv_;
-        }
+/**
+ * @brief 出力せずにframesサンプル進める（コントロールレートで使う時用）
+ *
+ * @param[in] frames
+ * @retval 進めた後のレベル
+ */
+float Envelope::Advance( int frames )
+{
+    Run( nullptr, frames );
+    return lv_;
+}
 
-        // end decay
-        if( elapsed_ms >= decay_ms_ ) {
-            SetState( kSustain );
+/**
+ * @brief framesサンプル進める
+ *
+ * @param[out] out    レベル（nullptrなら書き込まない）
+ * @param[in]  frames
+ * @retval 休止状態になった最初のサンプル位置（休止しなければframes）
+ */
+int Envelope::Run( float* out, int frames )
+{
+    int pos = 0;
+    while( pos < frames ) {
+        if( state_ == kIdle ) {
+            if( out ) {
+                for( int ix=pos; ix<frames; ix++ ) { out[ix] = 0.f; }
+            }
+            return pos;
         }
-        break;
 
-    case kSustain:
-        out_lv = sustain_lv_;
-        break;
+        if( state_ == kSustain ) {
+            lv_ = sustain_lv_;
+            if( out ) {
+                for( int ix=pos; ix<frames; ix++ ) { out[ix] = lv_; }
+            }
+            return frames;
+        }
 
-    case kRelease:
-        if( release_ms_ != 0 ) {
-            out_lv = sustain_lv_ - (sustain_lv_ * (elapsed_ms / release_ms_));
+        // 段階の終わりかブロックの終わりまで、積和だけで進める
+        int   num = (remain_ < (uint32_t)(frames - pos)) ? (int)remain_ : (frames - pos);
+        float lv  = lv_;
+        const float mul = mul_;
+        const float add = add_;
+        if( out ) {
+            for( int ix=0; ix<num; ix++ ) {
+                lv = lv * mul + add;
+                out[pos + ix] = lv;
+            }
         }
         else {
-            out_lv = 0;
+            for( int ix=0; ix<num; ix++ ) {
+                lv = lv * mul + add;
+            }
         }
+        lv_      = lv;
+        remain_ -= num;
+        pos     += num;
 
-        // end release
-        if( elapsed_ms >= release_ms_ ) {
-            SetState( kIdle );
+        if( remain_ == 0 ) {
+            // 誤差を残さず目標値に合わせて次の段階へ
+            lv_ = target_;
+            if( out ) {
+                out[pos - 1] = lv_;
+            }
+            SetState( (state_ == kAttack) ? kDecay : ((state_ == kDecay) ? kSustain : kIdle) );
         }
-        break;
-
-    default:
-        out_lv = 0;
-        break;
     }
 
-    // limiter
-    out_lv = (out_lv>1.f) ? 1.f : ((out_lv<0.f) ? 0.f : out_lv);
-
-    out_lv_prev_ = out_lv;
-    return in * out_lv;
+    return frames;
 }
 
 /**
  * @brief Trigger
+ * @note  今のレベルからアタックを始める（発音中に再トリガーしてもレベルが飛ばない）
  */
 void Envelope::Trigger()
 {
@@ -114,10 +201,22 @@ void Envelope::Trigger()
 
 /**
  * @brief Release
+ * @note  今のレベルからリリースを始める
  */
 void Envelope::Release()
 {
-    SetState( kRelease );
+    if( state_ != kIdle ) {
+        SetState( kRelease );
+    }
+}
+
+/**
+ * @brief Reset
+ */
+void Envelope::Reset()
+{
+    lv_ = 0.f;
+    SetState( kIdle );
 }
 
 /**
@@ -141,7 +240,7 @@ void Envelope::SetDecay(int decay_ms)
  */
 void Envelope::SetSustain(float sustain_lv)
 {
-    sustain_lv_ = sustain_lv;
+    sustain_lv_ = (sustain_lv>1.f) ? 1.f : ((sustain_lv<0.f) ? 0.f : sustain_lv);
 }
 
 /**
@@ -152,10 +251,18 @@ void Envelope::SetRelease(int release_ms)
     release_ms_ = release_ms;
 }
 
+/**
+ * @brief SetCurve（次の段階から有効）
+ */
+void Envelope::SetCurve(Curve curve)
+{
+    curve_ = curve;
+}
+
 /**
  * @brief IsPlaying
  */
 bool Envelope::IsPlaying()
 {
     return (state_ != kIdle);
-}
\ No newline at end of file
+}
@@ -1,27 +1,42 @@
 /**
- * @file filter.h
+ * @file envelope.h
  */
 #pragma once
 
+#include <cstdint>
+
 /**
  * @class Envelope
+ * @brief ADSRエンベロープ
+ * @note  段階に入る時に1サンプル毎の係数を求めておき、1サンプルは1回の積和で進める
  */
 class Envelope {
 public:
+    enum Curve
+    {
+        kLinear,       // 直線
+        kExponential,  // アナログ風（アタックは上に凸、ディケイ/リリースは下に凸）
+    };
+
     Envelope( float fs );
     ~Envelope(){}
 
     float Process( float in );
+    int   Process( float* out, int frames );  // 戻り値: 休止した位置（休止しなければframes）
+    float Advance( int frames );              // 出力せずに進める。戻り値: 進めた後のレベル
 
     void Trigger();
     void Release();
+    void Reset();    // すぐに休止させる（レベルも0にする）
 
     void SetAttack (int attack_ms);
     void SetDecay  (int decay_ms);
     void SetSustain(float sustain_lv);
     void SetRelease(int release_ms);
+    void SetCurve  (Curve curve);
 
-    bool IsPlaying();
+    bool  IsPlaying();
+    float GetLevel() { return lv_; }
 
 private:
     enum EnvelopeState
@@ -36,14 +51,21 @@ private:
     float fs_;  // sample rate
 
     enum EnvelopeState state_;
-    float count_;
 
-    float out_lv_prev_;
+    // 現在の段階: lv_ = lv_ * mul_ + add_ をremain_回行うとtarget_に着く
+    float    lv_;
+    float    mul_;
+    float    add_;
+    float    target_;
+    uint32_t remain_;
 
     int   attack_ms_;
     int   decay_ms_;
     float sustain_lv_;
     int   release_ms_;
+    Curve curve_;
 
     void SetState(enum EnvelopeState state);
+    void StartSegment(float target, int time_ms, float ratio);
+    int  Run(float* out, int frames);
 };
@@ -0,0 +1,47 @@
+/**
+ * @file fastmath.cpp
+ */
+#include <math.h>
+
+#include "fastmath.h"
+
+#define EXP2_TBL_SIZE (256)  // 1オクターブ分の分割数
+
+static float exp2_tbl_[EXP2_TBL_SIZE+1];  // 2^(ix/EXP2_TBL_SIZE)
+
+static bool exp2_tbl_init();
+static bool exp2_tbl_ready_ = exp2_tbl_init();
+
+/**
+ * @brief exp2_tbl_init
+ */
+static bool exp2_tbl_init()
+{
+    for( int ix=0; ix<=EXP2_TBL_SIZE; ix++ ) {
+        exp2_tbl_[ix] = (float)pow( 2.0, (double)ix / EXP2_TBL_SIZE );
+    }
+    return true;
+}
+
+/**
+ * @brief 2のx乗
+ * @note  整数部は指数へ、小数部はテーブルを線形補間して求める
+ * @param x
+ */
+float fast_exp2( float x )
+{
+    float int_part = floorf( x );
+    float pos      = (x - int_part) * EXP2_TBL_SIZE;
+    int   idx      = (int)pos;
+    float deci     = pos - idx;
+
+    // 0に近い負の数では小数部が丸められて1.0になるので、次のオクターブの先頭として扱う
+    if( idx >= EXP2_TBL_SIZE ) {
+        int_part += 1.f;
+        idx       = 0;
+        deci      = 0.f;
+    }
+
+    float mantissa = exp2_tbl_[idx] + (exp2_tbl_[idx+1] - exp2_tbl_[idx]) * deci;
+    return ldexpf( mantissa, (int)int_part );
+}
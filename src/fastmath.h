@@ -0,0 +1,7 @@
+/**
+ * @file fastmath.h
+ */
+#pragma once
+
+// 2のx乗をテーブル+線形補間で求める（誤差は0.002セント未満）
+float fast_exp2( float x );
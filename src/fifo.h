@@ -1,22 +1,218 @@
 /**
  * @file fifo.h
+ * @brief FIFO buffer
  */
 #pragma once
 
-class FIFO {
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+/**
+ * @class FifoIndex
+ * @brief FIFOの読み書き位置。Atomic=trueなら別スレッドから読めるようにする
+ */
+template<bool Atomic>
+class FifoIndex {
+public:
+    FifoIndex() : val_( 0 ) {}
+    size_t Load() const               { return val_; }  // 自分が更新する側
+    size_t LoadAcquire() const        { return val_; }  // 相手が更新する側
+    void   StoreRelease( size_t val ) { val_ = val; }
 private:
-    void         *buffer_;    /*!< FIFOのデータ格納先 */
-    int           blockSize_; /*!< buffer_ の読み書き単位サイズ[byte] */
-    int           capacity_;  /*!< FIFOに格納できるデータの数 */
-    int           length_;    /*!< 現在FIFOに格納されているデータの数 */
-    unsigned long tail_;      /*!< 次にデータを格納する場所へのオフセット */
-    unsigned long head_;
+    size_t val_;
+};
 
+template<>
+class alignas(64) FifoIndex<true> {
 public:
-    FIFO( int capacity, int block_size );
-    ~FIFO( void );
+    FifoIndex() : val_( 0 ) {}
+    size_t Load() const               { return val_.load( std::memory_order_relaxed ); }
+    size_t LoadAcquire() const        { return val_.load( std::memory_order_acquire ); }
+    void   StoreRelease( size_t val ) { val_.store( val, std::memory_order_release ); }
+private:
+    std::atomic<size_t> val_;
+};
+
+/**
+ * @class FIFO
+ * @brief 容量固定のFIFOバッファ
+ * @note  Atomic=falseの時は1スレッド専用で、満杯でPutすると最も古いデータを捨てる。
+ *        Atomic=trueの時は書き手/読み手それぞれ1スレッドから使え、満杯なら書き込まない
+ *
+ * @tparam T      要素の型（memcpyでコピーできること）
+ * @tparam N      容量（2のべき乗）
+ * @tparam Atomic 読み書き位置をatomicにする
+ */
+template<typename T, size_t N, bool Atomic = false>
+class FIFO {
+    static_assert( N > 0 && (N & (N-1)) == 0, "FIFO: N must be a power of two" );
+    static_assert( std::is_trivially_copyable<T>::value, "FIFO: T must be trivially copyable" );
+
+public:
+    static const size_t kCapacity = N;
+
+    /**
+     * @brief 連続した読み出し範囲
+     */
+    struct Span {
+        const T* data;
+        size_t   num;
+    };
+
+    FIFO() : buffer_() {}
+    ~FIFO() {}
+
+    /**
+     * @brief 格納されているデータの数
+     */
+    size_t GetLength() const
+    {
+        return tail_.LoadAcquire() - head_.LoadAcquire();
+    }
 
-    void Put( void *data );
-    void Get( void *data );
-    void SnoopFromTail( void *data, int num );
+    /**
+     * @brief FIFOへデータ追加
+     *
+     * @param[in] data 追加するデータ
+     * @retval true  成功
+     * @retval false 満杯(Atomic=trueの時のみ)
+     */
+    bool Put( const T& data )
+    {
+        return PutN( &data, 1 ) == 1;
+    }
+
+    /**
+     * @brief FIFOからデータ取得
+     *
+     * @param[out] data 読み込むデータの格納先
+     * @retval true  成功
+     * @retval false 空
+     */
+    bool Get( T* data )
+    {
+        return GetN( data, 1 ) == 1;
+    }
+
+    /**
+     * @brief FIFOへまとめて追加
+     *
+     * @param[in] data 追加するデータ
+     * @param[in] num  データ数
+     * @return 追加した数（Atomic=falseなら常にnum）
+     */
+    size_t PutN( const T* data, size_t num )
+    {
+        size_t tail = tail_.Load();
+        size_t head = head_.LoadAcquire();
+        size_t ret  = num;
+
+        if( Atomic ) {
+            size_t space = N - (tail - head);
+            num = (num < space) ? num : space;
+            ret = num;
+        }
+        else {
+            // 入りきらない分は古い方から捨てる
+            if( num > N ) {
+                data += num - N;
+                tail += num - N;
+                num   = N;
+            }
+            if( tail + num - head > N ) {
+                head_.StoreRelease( tail + num - N );
+            }
+        }
+
+        size_t ofs   = tail & kMask;
+        size_t first = (num < N - ofs) ? num : N - ofs;
+        memcpy( &buffer_[ofs], data, first * sizeof(T) );
+        memcpy( &buffer_[0], data + first, (num - first) * sizeof(T) );
+
+        tail_.StoreRelease( tail + num );
+        return ret;
+    }
+
+    /**
+     * @brief FIFOからまとめて取得
+     *
+     * @param[out] data 読み込むデータの格納先
+     * @param[in]  num  最大データ数
+     * @return 取得した数
+     */
+    size_t GetN( T* data, size_t num )
+    {
+        Span span[2];
+        size_t length = ReadSpans( &span[0], &span[1] );
+        num = (num < length) ? num : length;
+
+        size_t first = (num < span[0].num) ? num : span[0].num;
+        memcpy( data, span[0].data, first * sizeof(T) );
+        memcpy( data + first, span[1].data, (num - first) * sizeof(T) );
+
+        Consume( num );
+        return num;
+    }
+
+    /**
+     * @brief 格納されているデータをコピーせずに参照する
+     * @note  参照し終わったらConsumeで取り除く
+     *
+     * @param[out] first  古い方の連続範囲
+     * @param[out] second 終端で折り返した残り（無ければnum=0）
+     * @return 格納されているデータの総数
+     */
+    size_t ReadSpans( Span* first, Span* second ) const
+    {
+        size_t head   = head_.Load();
+        size_t length = tail_.LoadAcquire() - head;
+        size_t ofs    = head & kMask;
+
+        first->data  = &buffer_[ofs];
+        first->num   = (length < N - ofs) ? length : N - ofs;
+        second->data = &buffer_[0];
+        second->num  = length - first->num;
+        return length;
+    }
+
+    /**
+     * @brief 古い方からnum個取り除く
+     */
+    void Consume( size_t num )
+    {
+        size_t head   = head_.Load();
+        size_t length = tail_.LoadAcquire() - head;
+        head_.StoreRelease( head + ((num < length) ? num : length) );
+    }
+
+    /**
+     * @brief 直近num個分の格納場所を古い順に取り出す（取り除かない）
+     * @note  1スレッド専用。まだ書き込まれていない場所は0になる
+     *
+     * @param[out] data 格納先
+     * @param[in]  num  データ数(N以下)
+     */
+    void SnoopFromTail( T* data, size_t num ) const
+    {
+        num = (num < N) ? num : N;
+        size_t ofs   = (tail_.Load() - num) & kMask;
+        size_t first = (num < N - ofs) ? num : N - ofs;
+        memcpy( data, &buffer_[ofs], first * sizeof(T) );
+        memcpy( data + first, &buffer_[0], (num - first) * sizeof(T) );
+    }
+
+private:
+    FIFO(const FIFO&);
+    FIFO& operator=(const FIFO&);
+
+    static const size_t kMask = N - 1;
+
+    FifoIndex<Atomic> head_;  /*!< 次に読み出す位置（単調増加） */
+    FifoIndex<Atomic> tail_;  /*!< 次に格納する位置（単調増加） */
+    T buffer_[N];             /*!< データ格納先 */
 };
+
+template<typename T, size_t N, bool Atomic> const size_t FIFO<T, N, Atomic>::kCapacity;
+template<typename T, size_t N, bool Atomic> const size_t FIFO<T, N, Atomic>::kMask;
@@ -1,11 +1,14 @@
 /**
- * @file screen_ui.cpp
+ * @file filter.cpp
  */
 #include <math.h>
 
 #include "common.h"
 #include "filter.h"
 
+// これより小さい状態は0にする（無音が続いたときに非正規化数で遅くなるのを防ぐ）
+static const float kDenormalThreshold = 1.0e-20f;
+
 /**
  * @brief constructor
  */
@@ -13,141 +16,184 @@ Filter::Filter( float fs )
 {
     fs_ = fs;
 
-    a0_ = 1.0f; // 0以外にしておかないと除算でエラーになる
-    a1_ = 0.0f;
-    a2_ = 0.0f;
+    // 素通し
     b0_ = 1.0f;
     b1_ = 0.0f;
     b2_ = 0.0f;
+    a1_ = 0.0f;
+    a2_ = 0.0f;
 
-    in1_ = in2_ = out1_ = out2_ = 0.0f;
+    Reset();
 }
 
-
 /**
- * @brief constructor
+ * @brief 1サンプル処理する
  */
 float Filter::Process( float in )
 {
-    // 入力信号にフィルタを適用し、出力信号変数に保存。
-    float out = b0_ / a0_ * in + b1_ / a0_ * in1_ + b2_ / a0_ * in2_
-        - a1_ / a0_ * out1_ - a2_ / a0_ * out2_;
-
-    in2_ = in1_;
-    in1_ = in;
+    float out = b0_ * in + z1_;
+    z1_ = b1_ * in - a1_ * out + z2_;
+    z2_ = b2_ * in - a2_ * out;
 
-    out2_ = out1_;
-    out1_ = out;
+    FlushDenormal();
 
     return out;
 }
 
+/**
+ * @brief nサンプルまとめて処理する
+ *
+ * @param[in]  in  入力
+ * @param[out] out 出力
+ * @param[in]  n   サンプル数
+ */
+void Filter::Process( const float* in, float* out, int n )
+{
+    // 係数と状態はループの間レジスタに置く
+    const float b0 = b0_, b1 = b1_, b2 = b2_, a1 = a1_, a2 = a2_;
+    float z1 = z1_;
+    float z2 = z2_;
+
+    for( int ix=0; ix<n; ix++ ) {
+        float x = in[ix];
+        float y = b0 * x + z1;
+        z1 = b1 * x - a1 * y + z2;
+        z2 = b2 * x - a2 * y;
+        out[ix] = y;
+    }
+
+    z1_ = z1;
+    z2_ = z2;
+    FlushDenormal();
+}
+
+/**
+ * @brief 状態を消す
+ */
+void Filter::Reset()
+{
+    z1_ = z2_ = 0.0f;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief 係数をa0で正規化して保持する
+ */
+void Filter::SetCoef( float b0, float b1, float b2, float a0, float a1, float a2 )
+{
+    float inv_a0 = 1.0f / a0;
+
+    b0_ = b0 * inv_a0;
+    b1_ = b1 * inv_a0;
+    b2_ = b2 * inv_a0;
+    a1_ = a1 * inv_a0;
+    a2_ = a2 * inv_a0;
+}
+
+/**
+ * @brief 状態が非正規化数の近くまで減衰していたら0にする
+ */
+void Filter::FlushDenormal()
+{
+    if( fabsf( z1_ ) < kDenormalThreshold ) { z1_ = 0.0f; }
+    if( fabsf( z2_ ) < kDenormalThreshold ) { z2_ = 0.0f; }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
 void Filter::LowPass(float freq, float q)
 {
     float omega = 2.0f * 3.14159265f *  freq / fs_;
+    float cs    = cos(omega);
     float alpha = sin(omega) / (2.0f * q);
 
-    a0_ = 1.0f + alpha;
-    a1_ = -2.0f * cos(omega);
-    a2_ = 1.0f - alpha;
-    b0_ = (1.0f - cos(omega)) / 2.0f;
-    b1_ = 1.0f - cos(omega);
-    b2_ = (1.0f - cos(omega)) / 2.0f;
+    SetCoef( (1.0f - cs) / 2.0f, 1.0f - cs, (1.0f - cs) / 2.0f,
+             1.0f + alpha, -2.0f * cs, 1.0f - alpha );
 }
 
 void Filter::HighPass(float freq, float q)
 {
     float omega = 2.0f * 3.14159265f *  freq / fs_;
+    float cs    = cos(omega);
     float alpha = sin(omega) / (2.0f * q);
 
-    a0_ = 1.0f + alpha;
-    a1_ = -2.0f * cos(omega);
-    a2_ = 1.0f - alpha;
-    b0_ = (1.0f + cos(omega)) / 2.0f;
-    b1_ = -(1.0f + cos(omega));
-    b2_ = (1.0f + cos(omega)) / 2.0f;
+    SetCoef( (1.0f + cs) / 2.0f, -(1.0f + cs), (1.0f + cs) / 2.0f,
+             1.0f + alpha, -2.0f * cs, 1.0f - alpha );
 }
 
 void Filter::BandPass(float freq, float bw)
 {
     float omega = 2.0f * 3.14159265f *  freq / fs_;
-    float alpha = sin(omega) * sinh(log(2.0f) / 2.0 * bw * omega / sin(omega));
+    float sn    = sin(omega);
+    float alpha = sn * sinh(log(2.0f) / 2.0 * bw * omega / sn);
 
-    a0_ = 1.0f + alpha;
-    a1_ = -2.0f * cos(omega);
-    a2_ = 1.0f - alpha;
-    b0_ = alpha;
-    b1_ = 0.0f;
-    b2_ = -alpha;
+    SetCoef( alpha, 0.0f, -alpha,
+             1.0f + alpha, -2.0f * cos(omega), 1.0f - alpha );
 }
 
 void Filter::Notch(float freq, float bw)
 {
     float omega = 2.0f * 3.14159265f *  freq / fs_;
-    float alpha = sin(omega) * sinh(log(2.0f) / 2.0 * bw * omega / sin(omega));
+    float sn    = sin(omega);
+    float cs    = cos(omega);
+    float alpha = sn * sinh(log(2.0f) / 2.0 * bw * omega / sn);
 
-    a0_ = 1.0f + alpha;
-    a1_ = -2.0f * cos(omega);
-    a2_ = 1.0f - alpha;
-    b0_ = 1.0f;
-    b1_ = -2.0f * cos(omega);
-    b2_ = 1.0f;
+    SetCoef( 1.0f, -2.0f * cs, 1.0f,
+             1.0f + alpha, -2.0f * cs, 1.0f - alpha );
 }
 
 void Filter::LowShelf(float freq, float q, float gain)
 {
     float omega = 2.0f * 3.14159265f *  freq / fs_;
-    float alpha = sin(omega) / (2.0f * q);
-    float A = pow(10.0f, (gain / 40.0f));
-    float beta = sqrt(A) / q;
-
-    a0_ = (A + 1.0f) + (A - 1.0f) * cos(omega) + beta * sin(omega);
-    a1_ = -2.0f * ((A - 1.0f) + (A + 1.0f) * cos(omega));
-    a2_ = (A + 1.0f) + (A - 1.0f) * cos(omega) - beta * sin(omega);
-    b0_ = A * ((A + 1.0f) - (A - 1.0f) * cos(omega) + beta * sin(omega));
-    b1_ = 2.0f * A * ((A - 1.0f) - (A + 1.0f) * cos(omega));
-    b2_ = A * ((A + 1.0f) - (A - 1.0f) * cos(omega) - beta * sin(omega));
+    float sn    = sin(omega);
+    float cs    = cos(omega);
+    float A     = pow(10.0f, (gain / 40.0f));
+    float beta  = sqrt(A) / q;
+
+    SetCoef( A * ((A + 1.0f) - (A - 1.0f) * cs + beta * sn),
+             2.0f * A * ((A - 1.0f) - (A + 1.0f) * cs),
+             A * ((A + 1.0f) - (A - 1.0f) * cs - beta * sn),
+             (A + 1.0f) + (A - 1.0f) * cs + beta * sn,
+             -2.0f * ((A - 1.0f) + (A + 1.0f) * cs),
+             (A + 1.0f) + (A - 1.0f) * cs - beta * sn );
 }
 
 void Filter::HighShelf(float freq, float q, float gain)
 {
     float omega = 2.0f * 3.14159265f *  freq / fs_;
-    float alpha = sin(omega) / (2.0f * q);
-    float A = pow(10.0f, (gain / 40.0f));
-    float beta = sqrt(A) / q;
-
-    a0_ = (A + 1.0f) - (A - 1.0f) * cos(omega) + beta * sin(omega);
-    a1_ = 2.0f * ((A - 1.0f) - (A + 1.0f) * cos(omega));
-    a2_ = (A + 1.0f) - (A - 1.0f) * cos(omega) - beta * sin(omega);
-    b0_ = A * ((A + 1.0f) + (A - 1.0f) * cos(omega) + beta * sin(omega));
-    b1_ = -2.0f * A * ((A - 1.0f) + (A + 1.0f) * cos(omega));
-    b2_ = A * ((A + 1.0f) + (A - 1.0f) * cos(omega) - beta * sin(omega));
+    float sn    = sin(omega);
+    float cs    = cos(omega);
+    float A     = pow(10.0f, (gain / 40.0f));
+    float beta  = sqrt(A) / q;
+
+    SetCoef( A * ((A + 1.0f) + (A - 1.0f) * cs + beta * sn),
+             -2.0f * A * ((A - 1.0f) + (A + 1.0f) * cs),
+             A * ((A + 1.0f) + (A - 1.0f) * cs - beta * sn),
+             (A + 1.0f) - (A - 1.0f) * cs + beta * sn,
+             2.0f * ((A - 1.0f) - (A + 1.0f) * cs),
+             (A + 1.0f) - (A - 1.0f) * cs - beta * sn );
 }
 
 
 void Filter::Peaking(float freq, float bw, float gain)
 {
     float omega = 2.0f * 3.14159265f *  freq / fs_;
-    float alpha = sin(omega) * sinh(log(2.0f) / 2.0 * bw * omega / sin(omega));
-    float A = pow(10.0f, (gain / 40.0f));
-
-    a0_ = 1.0f + alpha / A;
-    a1_ = -2.0f * cos(omega);
-    a2_ = 1.0f - alpha / A;
-    b0_ = 1.0f + alpha * A;
-    b1_ = -2.0f * cos(omega);
-    b2_ = 1.0f - alpha * A;
+    float sn    = sin(omega);
+    float cs    = cos(omega);
+    float alpha = sn * sinh(log(2.0f) / 2.0 * bw * omega / sn);
+    float A     = pow(10.0f, (gain / 40.0f));
+
+    SetCoef( 1.0f + alpha * A, -2.0f * cs, 1.0f - alpha * A,
+             1.0f + alpha / A, -2.0f * cs, 1.0f - alpha / A );
 }
 
 void Filter::AllPass(float freq, float q)
 {
     float omega = 2.0f * 3.14159265f *  freq / fs_;
+    float cs    = cos(omega);
     float alpha = sin(omega) / (2.0f * q);
 
-    a0_ = 1.0f + alpha;
-    a1_ = -2.0f * cos(omega);
-    a2_ = 1.0f - alpha;
-    b0_ = 1.0f - alpha;
-    b1_ = -2.0f * cos(omega);
-    b2_ = 1.0f + alpha;
-}
\ No newline at end of file
+    SetCoef( 1.0f - alpha, -2.0f * cs, 1.0f + alpha,
+             1.0f + alpha, -2.0f * cs, 1.0f - alpha );
+}
@@ -5,14 +5,21 @@
 
 /**
  * @class Filter
+ * @brief biquadフィルタ（転置型直接形II）
  */
 class Filter {
 private:
     // sample rate
     float fs_;
 
-    float a0_, a1_, a2_, b0_, b1_, b2_;
-    float in1_, in2_, out1_, out2_;
+    // a0で正規化済みの係数
+    float b0_, b1_, b2_, a1_, a2_;
+
+    // 状態
+    float z1_, z2_;
+
+    void SetCoef( float b0, float b1, float b2, float a0, float a1, float a2 );
+    void FlushDenormal();
 
 public:
     Filter( float fs );
@@ -20,6 +27,9 @@ public:
 
     // 入力信号にフィルタを適用する関数
     float Process(float in);
+    void  Process(const float* in, float* out, int n);  // in == out でもよい
+
+    void Reset();
 
     void LowPass  (float freq, float q );
     void HighPass (float freq, float q );
@@ -29,4 +39,10 @@ public:
     void HighShelf(float freq, float q , float gain);
     void Peaking  (float freq, float bw, float gain);
     void AllPass  (float freq, float q );
+
+    float GetB0() { return b0_; }
+    float GetB1() { return b1_; }
+    float GetB2() { return b2_; }
+    float GetA1() { return a1_; }
+    float GetA2() { return a2_; }
 };
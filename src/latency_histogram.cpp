@@ -0,0 +1,158 @@
+/**
+ * @file latency_histogram.cpp
+ */
+#include "latency_histogram.h"
+
+/**
+ * @brief constructor
+ */
+LatencyHistogram::LatencyHistogram()
+{
+    Reset();
+}
+
+/**
+ * @brief 1回分の処理時間を記録する
+ *
+ * @param[in] ns          処理時間[ns]
+ * @param[in] deadline_ns 処理時間の予算[ns]（超えたらデッドラインミスとして数える）
+ */
+void LatencyHistogram::Record( uint32_t ns, uint32_t deadline_ns )
+{
+    // 書き込むのは1スレッドだけなので、read-modify-writeは不要
+    std::atomic<uint32_t>& bucket = bucket_[BucketIndex( ns )];
+    bucket.store( bucket.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+
+    if( ns > deadline_ns ) {
+        deadline_miss_.store( deadline_miss_.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+    }
+    if( ns > max_.load( std::memory_order_relaxed ) ) {
+        max_.store( ns, std::memory_order_relaxed );
+    }
+    count_.store( count_.load( std::memory_order_relaxed ) + 1, std::memory_order_release );
+}
+
+/**
+ * @brief 記録を消す
+ * @note  Recordと同時に呼ぶと、その回の記録が一部残ることがある
+ */
+void LatencyHistogram::Reset()
+{
+    for( int ix=0; ix<kBucketNum; ix++ ) {
+        bucket_[ix].store( 0, std::memory_order_relaxed );
+    }
+    deadline_miss_.store( 0, std::memory_order_relaxed );
+    max_.store( 0, std::memory_order_relaxed );
+    count_.store( 0, std::memory_order_release );
+}
+
+/**
+ * @brief GetCount
+ */
+uint64_t LatencyHistogram::GetCount()
+{
+    return count_.load( std::memory_order_acquire );
+}
+
+/**
+ * @brief GetDeadlineMiss
+ */
+uint64_t LatencyHistogram::GetDeadlineMiss()
+{
+    return deadline_miss_.load( std::memory_order_relaxed );
+}
+
+/**
+ * @brief GetMax
+ */
+uint32_t LatencyHistogram::GetMax()
+{
+    return max_.load( std::memory_order_relaxed );
+}
+
+/**
+ * @brief パーセンタイル
+ *
+ * @param[in] percent 0～100
+ * @retval percent%点を含むバケットの上限[ns]（最大値を超える場合は最大値）。記録が無ければ0
+ */
+uint32_t LatencyHistogram::GetPercentile( double percent )
+{
+    // 読んでいる間にも記録は進むので、先にバケットを写しとって合計を数え直す
+    uint32_t snapshot[kBucketNum];
+    uint64_t total = 0;
+    for( int ix=0; ix<kBucketNum; ix++ ) {
+        snapshot[ix] = bucket_[ix].load( std::memory_order_relaxed );
+        total += snapshot[ix];
+    }
+    if( total == 0 ) {
+        return 0;
+    }
+
+    uint64_t target = (uint64_t)(total * percent / 100.0 + 0.5);
+    target = (target < 1) ? 1 : ((target > total) ? total : target);
+
+    uint32_t max = GetMax();
+    uint64_t sum = 0;
+    for( int ix=0; ix<kBucketNum; ix++ ) {
+        sum += snapshot[ix];
+        if( sum >= target ) {
+            uint32_t upper = (ix+1 < kBucketNum) ? BucketLower( ix+1 ) - 1 : UINT32_MAX;
+            return (upper < max) ? upper : max;
+        }
+    }
+    return max;
+}
+
+/**
+ * @brief 集計結果を書き出す
+ *
+ * @param[in] fp
+ */
+void LatencyHistogram::Dump( FILE* fp )
+{
+    fprintf(fp, "callback time: count=%llu p50=%uns p99=%uns p99.9=%uns max=%uns deadline_miss=%llu\n",
+        (unsigned long long)GetCount(),
+        GetPercentile( 50.0 ), GetPercentile( 99.0 ), GetPercentile( 99.9 ), GetMax(),
+        (unsigned long long)GetDeadlineMiss());
+
+    for( int ix=0; ix<kBucketNum; ix++ ) {
+        uint32_t num = bucket_[ix].load( std::memory_order_relaxed );
+        if( num != 0 ) {
+            fprintf(fp, "  >= %10uns : %u\n", BucketLower( ix ), num);
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief 処理時間[ns]からバケット番号を求める
+ */
+int LatencyHistogram::BucketIndex( uint32_t ns )
+{
+    if( ns < (1u << kSubBits) ) {
+        return ns;
+    }
+
+    int msb = kSubBits;
+    while( msb < 31 && (ns >> (msb+1)) != 0 ) {
+        msb++;
+    }
+    int sub = (ns >> (msb - kSubBits)) & ((1 << kSubBits) - 1);
+    return ((msb - kSubBits + 1) << kSubBits) + sub;
+}
+
+/**
+ * @brief バケットの下限[ns]
+ */
+uint32_t LatencyHistogram::BucketLower( int index )
+{
+    if( index < (1 << kSubBits) ) {
+        return index;
+    }
+
+    int msb = (index >> kSubBits) + kSubBits - 1;
+    int sub = index & ((1 << kSubBits) - 1);
+    return (uint32_t)((1u << kSubBits) + sub) << (msb - kSubBits);
+}
@@ -0,0 +1,42 @@
+/**
+ * @file latency_histogram.h
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdio>
+#include <cstdint>
+
+/**
+ * @class LatencyHistogram
+ * @brief 処理時間[ns]の対数ヒストグラム
+ * @note  Recordは1スレッド(オーディオスレッド)からのみ呼ぶ。読み出しはどのスレッドからでもよい（ロックしない）
+ */
+class LatencyHistogram {
+public:
+    // 1オクターブを4分割する（1バケットの幅は下限の25%以下）
+    static const int kSubBits   = 2;
+    static const int kBucketNum = (32 - kSubBits + 1) << kSubBits;
+
+    LatencyHistogram();
+    ~LatencyHistogram(){}
+
+    void Record( uint32_t ns, uint32_t deadline_ns );
+    void Reset();
+
+    uint64_t GetCount();
+    uint64_t GetDeadlineMiss();
+    uint32_t GetMax();
+    uint32_t GetPercentile( double percent );  // percent%点を含むバケットの上限[ns]
+
+    void Dump( FILE* fp );
+
+    static int      BucketIndex( uint32_t ns );
+    static uint32_t BucketLower( int index );
+
+private:
+    std::atomic<uint32_t> bucket_[kBucketNum];
+    std::atomic<uint64_t> count_;
+    std::atomic<uint64_t> deadline_miss_;
+    std::atomic<uint32_t> max_;
+};
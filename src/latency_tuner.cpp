@@ -0,0 +1,95 @@
+/**
+ * @file latency_tuner.cpp
+ */
+#include "common.h"
+#include "latency_tuner.h"
+
+/**
+ * @brief constructor
+ */
+LatencyTuner::Config::Config()
+{
+    min_sec          = 0.002;
+    max_sec          = 0.5;
+    raise_count      = 3;
+    raise_window_sec = 2.0;
+    raise_ratio      = 1.5;
+    trim_quiet_sec   = 10.0;
+    trim_ratio       = 0.8;
+    trim_headroom    = 0.25;
+}
+
+/**
+ * @brief constructor
+ */
+LatencyTuner::LatencyTuner()
+{
+    Reset( Config(), 0.1, 0.0 );
+}
+
+/**
+ * @brief 設定と現在の遅延を与えて、状態を初期化する
+ *
+ * @param[in] config  設定
+ * @param[in] latency 現在の遅延[s]
+ * @param[in] now_sec 現在時刻[s]
+ */
+void LatencyTuner::Reset( const Config& config, double latency, double now_sec )
+{
+    config_             = config;
+    config_.raise_count = MAX( 1, MIN( config_.raise_count, kMaxRaiseCount ) );
+    latency_            = latency;
+    floor_              = 0.0;
+    quiet_since_        = now_sec;
+    max_ns_             = 0;
+    underflow_pos_      = 0;
+    underflow_num_      = 0;
+}
+
+/**
+ * @brief 前回からの状況を与え、次に使う遅延を求める
+ * @note  一定間隔で呼ぶ。戻り値が現在の遅延と違えば、その遅延でストリームを開き直す
+ *
+ * @param[in] now_sec         現在時刻[s]
+ * @param[in] underflow_num   前回から起きたアンダーフローの数
+ * @param[in] max_callback_ns 前回からのコールバック処理時間の最大[ns]
+ * @return 次に使う遅延[s]
+ */
+double LatencyTuner::Update( double now_sec, uint32_t underflow_num, uint32_t max_callback_ns )
+{
+    if( underflow_num > 0 ) {
+        // 同じ間隔で起きたものは同じ時刻として数える
+        for( uint32_t ix=0; ix<MIN( underflow_num, (uint32_t)kMaxRaiseCount ); ix++ ) {
+            underflow_at_[underflow_pos_] = now_sec;
+            underflow_pos_ = (underflow_pos_ + 1) % kMaxRaiseCount;
+            underflow_num_ = MIN( underflow_num_ + 1, kMaxRaiseCount );
+        }
+        floor_       = MAX( floor_, latency_ );
+        quiet_since_ = now_sec;
+        max_ns_      = 0;
+
+        int recent = 0;
+        for( int ix=0; ix<underflow_num_; ix++ ) {
+            if( now_sec - underflow_at_[ix] <= config_.raise_window_sec ) {
+                recent++;
+            }
+        }
+        if( recent >= config_.raise_count ) {
+            latency_       = MIN( config_.max_sec, latency_ * config_.raise_ratio );
+            underflow_pos_ = 0;
+            underflow_num_ = 0;
+        }
+        return latency_;
+    }
+
+    max_ns_ = MAX( max_ns_, max_callback_ns );
+    if( now_sec - quiet_since_ >= config_.trim_quiet_sec ) {
+        double next = MAX( config_.min_sec, latency_ * config_.trim_ratio );
+        if( next < latency_ && next > floor_ && max_ns_ < next * config_.trim_headroom * 1.0e9 ) {
+            latency_ = next;
+        }
+        quiet_since_ = now_sec;
+        max_ns_      = 0;
+    }
+    return latency_;
+}
@@ -0,0 +1,51 @@
+/**
+ * @file latency_tuner.h
+ */
+#pragma once
+
+#include <cstdint>
+
+/**
+ * @class LatencyTuner
+ * @brief アンダーフローの起き方から、出力の遅延(software_latency)を決める
+ * @note  短い時間にアンダーフローが続けば遅延を増やし、
+ *        アンダーフローが無くコールバックの処理時間にも余裕がある状態が続けば少しずつ減らす。
+ *        アンダーフローが起きた遅延は覚えておき、それ以下には減らさない
+ */
+class LatencyTuner {
+public:
+    static const int kMaxRaiseCount = 8;
+
+    struct Config {
+        double min_sec;           // 遅延の下限
+        double max_sec;           // 遅延の上限
+        int    raise_count;       // raise_window_sec以内にこの回数アンダーフローしたら増やす(1～kMaxRaiseCount)
+        double raise_window_sec;
+        double raise_ratio;       // 増やす時の倍率(>1)
+        double trim_quiet_sec;    // アンダーフローがこの時間起きなければ減らす
+        double trim_ratio;        // 減らす時の倍率(<1)
+        double trim_headroom;     // コールバック処理時間の最大が、遅延のこの割合未満の時だけ減らす
+
+        Config();
+    };
+
+    LatencyTuner();
+    ~LatencyTuner(){}
+
+    void   Reset( const Config& config, double latency, double now_sec );
+    double Update( double now_sec, uint32_t underflow_num, uint32_t max_callback_ns );
+
+    void   SetLatency( double latency ) { latency_ = latency; }  // 実際に使われた遅延に合わせる
+    double GetLatency() { return latency_; }
+    double GetFloor()   { return floor_; }
+
+private:
+    Config   config_;
+    double   latency_;
+    double   floor_;                         // アンダーフローした中で最大の遅延
+    double   quiet_since_;                   // 最後に遅延を変えた、またはアンダーフローした時刻
+    uint32_t max_ns_;                        // quiet_since_以降のコールバック処理時間の最大
+    double   underflow_at_[kMaxRaiseCount];  // 直近のアンダーフローの時刻（リングバッファ）
+    int      underflow_pos_;
+    int      underflow_num_;                 // underflow_at_に入っている数
+};
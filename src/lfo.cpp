@@ -0,0 +1,110 @@
+/**
+ * @file lfo.cpp
+ */
+#include <cstdint>
+#include <math.h>
+
+#include "lfo.h"
+
+/**
+ * @brief constructor
+ *
+ * @param[in] fs sample rate
+ */
+Lfo::Lfo( float fs )
+{
+    fs_       = fs;
+    phase_    = 0;
+    w_        = 0;
+    shape_    = kSine;
+    key_sync_ = true;
+    value_    = 0.f;
+    hold_     = 0.f;
+    rand_     = 0x12345678;
+
+    SetRate( 5.f );
+}
+
+/**
+ * @brief framesサンプル分進める
+ *
+ * @param[in] frames
+ * @retval 進めた後の値(-1～1)
+ */
+float Lfo::Advance( int frames )
+{
+    uint64_t next = (uint64_t)phase_ + (uint64_t)w_ * (uint32_t)frames;
+
+    // 周期の先頭をまたいだら新しい値を保持する
+    if( shape_ == kSampleHold && (next >> 32) != 0 ) {
+        rand_ ^= rand_ << 13;
+        rand_ ^= rand_ >> 17;
+        rand_ ^= rand_ << 5;
+        hold_  = (float)(int32_t)rand_ * (1.f / 2147483648.f);
+    }
+
+    phase_ = (uint32_t)next;
+    value_ = Calc();
+    return value_;
+}
+
+/**
+ * @brief キーオン時に呼ぶ
+ */
+void Lfo::Trigger()
+{
+    if( key_sync_ ) {
+        phase_ = 0;
+        value_ = Calc();
+    }
+}
+
+/**
+ * @brief 周波数の設定
+ *
+ * @param[in] hz
+ */
+void Lfo::SetRate( float hz )
+{
+    double w = (double)hz / fs_ * 4294967296.0;
+    w_ = (w <= 0.0) ? 0 : ((w >= 4294967295.0) ? 0xFFFFFFFF : (uint32_t)w);
+}
+
+/**
+ * @brief 波形の設定
+ */
+void Lfo::SetShape( Shape shape )
+{
+    shape_ = shape;
+    value_ = Calc();
+}
+
+/**
+ * @brief キーシンク（キーオン毎に位相を先頭へ戻す）の設定
+ */
+void Lfo::SetKeySync( bool key_sync )
+{
+    key_sync_ = key_sync;
+}
+
+/**
+ * @brief 今の位相の値
+ */
+float Lfo::Calc()
+{
+    float x = (float)phase_ * (1.f / 4294967296.f);  // 0～1
+
+    switch( shape_ ) {
+        case kTriangle:
+            return (x < 0.5f) ? 4.f * x - 1.f : 3.f - 4.f * x;
+        case kSaw:
+            return 2.f * x - 1.f;
+        case kSquare:
+            return (x < 0.5f) ? 1.f : -1.f;
+        case kSampleHold:
+            return hold_;
+        case kSine:
+        default:
+            return sinf( 6.28318530718f * x );
+    }
+}
@@ -0,0 +1,48 @@
+/**
+ * @file lfo.h
+ */
+#pragma once
+
+#include <cstdint>
+
+/**
+ * @class Lfo
+ * @brief 変調用の低周波発振器
+ * @note  コントロールレートで使う（Advanceでまとめて進め、その時点の値だけを求める）
+ */
+class Lfo {
+public:
+    enum Shape
+    {
+        kSine,
+        kTriangle,
+        kSaw,         // 上昇
+        kSquare,
+        kSampleHold,  // 1周期毎に乱数を保持する
+    };
+
+    Lfo( float fs );
+    ~Lfo(){}
+
+    float Advance( int frames );  // 戻り値: 進めた後の値(-1～1)
+    void  Trigger();              // キーシンクなら位相を先頭へ戻す
+
+    void SetRate( float hz );
+    void SetShape( Shape shape );
+    void SetKeySync( bool key_sync );
+
+    float GetValue() { return value_; }
+
+private:
+    float    fs_;  // sample rate
+
+    uint32_t phase_;     // 位相(1周期で2^32)
+    uint32_t w_;         // 1サンプルあたりの位相の増分
+    Shape    shape_;
+    bool     key_sync_;
+    float    value_;     // 今の値
+    float    hold_;      // kSampleHoldで保持している値
+    uint32_t rand_;      // kSampleHold用の乱数の状態
+
+    float Calc();
+};
@@ -2,6 +2,8 @@
  * @file main.cpp
  */
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
 
 #include "waveform.h"
 #include "audio.h"
@@ -10,9 +12,46 @@
 
 #include "screen_ui.h"
 
+static void screen_ui_monitor( const float* data, int num, void* userdata );
+
 int main(int argc, char *argv[])
 {
+    // options
+    int         thread_num = 1;        // -j <num>  : 発音処理のスレッド数
+    const char* stats_path = nullptr;  // -s <file> : 終了時に処理時間の統計を書き出す（"-"は標準エラー）
+    double      latency_ms = 0.0;      // -l <ms>   : 出力の遅延の目標（0ならバックエンドに任せる）
+    bool        adaptive   = false;    // -a        : アンダーフローに応じて遅延を増減する
+    int         ahead      = 0;        // -b <num>  : 専用スレッドでnumフレーム先までレンダリングしておく
+    for( int ix=1; ix<argc; ix++ ) {
+        if( strcmp( argv[ix], "-j" ) == 0 && ix+1 < argc ) {
+            thread_num = atoi( argv[++ix] );
+        }
+        else if( strcmp( argv[ix], "-s" ) == 0 && ix+1 < argc ) {
+            stats_path = argv[++ix];
+        }
+        else if( strcmp( argv[ix], "-r" ) == 0 && ix+1 < argc ) {
+            // -r <prio> : オーディオスレッドをSCHED_FIFOの優先度<prio>で動かす
+            AudioCtrl::RealtimeSet( atoi( argv[++ix] ) );
+        }
+        else if( strcmp( argv[ix], "-l" ) == 0 && ix+1 < argc ) {
+            latency_ms = atof( argv[++ix] );
+        }
+        else if( strcmp( argv[ix], "-a" ) == 0 ) {
+            adaptive = true;
+        }
+        else if( strcmp( argv[ix], "-b" ) == 0 && ix+1 < argc ) {
+            ahead = atoi( argv[++ix] );
+        }
+        else if( strcmp( argv[ix], "-n" ) == 0 ) {
+            // -n : 整数形式のデバイスへ出力する時にディザを加えない
+            AudioCtrl::DitherSet( false );
+        }
+    }
+
     // initialize
+    Waveform::CacheDirSet( Waveform::DefaultCacheDir() );  // 2回目以降の起動では生成済みの波形テーブルを使う
+    AudioCtrl::LatencySet( latency_ms / 1000.0, adaptive );
+    AudioCtrl::RenderAheadSet( ahead );
     AudioCtrl* audioctrl = AudioCtrl::Create();
     if(!audioctrl) {
         return 1;
@@ -27,18 +66,24 @@ int main(int argc, char *argv[])
     if(!synth) {
         return 1;
     }
+    synth->SetRenderThreadNum( thread_num );
 
     ScreenUI* screen_ui = ScreenUI::Create();
     if(!screen_ui) {
         return 1;
     }
+    synth->MonitorSet( screen_ui_monitor, screen_ui );
 
     // s9r start!!!
     synth->Start();
     screen_ui->Start();
 
     // end
+    synth->MonitorUnset();
     ScreenUI::Destroy();
+    if( stats_path ) {
+        synth->DumpProcStats( stats_path );
+    }
     AudioCtrl::Destroy();
     MidiCtrl::Destroy();
     Synth::Destroy();
@@ -46,3 +91,10 @@ int main(int argc, char *argv[])
     return 0;
 }
 
+/**
+ * @brief 出力の波形をUIへ渡す（オーディオスレッドから呼ばれる）
+ */
+static void screen_ui_monitor( const float* data, int num, void* userdata )
+{
+    ((ScreenUI*)userdata)->WaveformPut( data, num );
+}
@@ -4,6 +4,7 @@
 
 #include <iostream>
 #include <cstdlib>
+#include <chrono>
 
 #include "RtMidi.h"
 
@@ -12,8 +13,14 @@
 
 static void midi_input_callback( double deltatime, std::vector< unsigned char > *message, void * user_data );
 static bool midi_choose_port( RtMidiIn *rtmidi );
+static uint64_t midi_clock_ns();
+
+// RtMidiのdeltatime積算値と受信時刻がこれ以上ずれたら受信時刻に合わせ直す
+static const uint64_t kResyncNs = 20 * 1000 * 1000;
 
 MidiCtrl* MidiCtrl::instance_ = nullptr;
+bool      MidiCtrl::no_port_  = false;
+const int MidiCtrl::kNoEvent;
 
 /**
  * @brief Create
@@ -45,6 +52,14 @@ MidiCtrl* MidiCtrl::GetInstance()
     return instance_;
 }
 
+/**
+ * @brief NoPortMode
+ */
+void MidiCtrl::NoPortMode()
+{
+    no_port_ = true;
+}
+
 /**
  * @brief initialize class
  */
@@ -52,6 +67,10 @@ bool MidiCtrl::Initialize()
 {
     RtMidiIn *midiin = NULL;
 
+    if( no_port_ ) {
+        return true;
+    }
+
     // initialize MIDI iunput
     try {
         midiin = new RtMidiIn();
@@ -87,16 +106,25 @@ cleanup:
 
 /**
  * @brief MidiRecv
+ * @note  鍵盤状態を書き換えるので、オーディオスレッド（またはDispatchEvent経由）からのみ呼ぶこと
  * @param[in]  msg
+ * @param[in]  size
  */
-void MidiCtrl::MidiRecv( std::vector<unsigned char> *msg )
+void MidiCtrl::MidiRecv( const unsigned char *msg, int size )
 {
-    const unsigned int bytes = msg->size();
-    if(bytes <= 0) { return; }
+    if(size < 2) { return; }
+
+    const int kind     = msg[0] & 0xF0;
+    const int notenum  = msg[1] & 0x7F;
 
-    const int kind     = msg->at(0) & 0xF0;
-    const int notenum  = msg->at(1);
-    const int velocity = msg->at(2);
+    // 2バイトのメッセージ
+    if( kind == 0xD0 ) {  // Channel pressure
+        channel_pressure_ = notenum;
+        return;
+    }
+    if(size < 3) { return; }
+
+    const int velocity = msg[2] & 0x7F;
 
     switch( kind ) {
         case 0x80:  // Note off
@@ -105,11 +133,78 @@ void MidiCtrl::MidiRecv( std::vector<unsigned char> *msg )
             break;
 
         case 0x90:  // Note on
-            KeyOn( notenum, velocity );
+            if(velocity == 0) {  // velocity 0 のNote onはNote off扱い
+                if(dumper_) { dumper_table_[notenum] = true; }
+                else        { KeyOff(notenum); }
+            }
+            else {
+                KeyOn( notenum, velocity );
+            }
+            break;
+
+        case 0xA0:  // Polyphonic key pressure
+            key_pressure_[notenum] = velocity;
+            break;
+
+        case 0xB0:  // Control change
+            if( notenum == 1 ) { mod_wheel_ = velocity; }
             break;
     }
 }
 
+/**
+ * @brief MidiInput
+ * @note  RtMidiスレッドから呼ばれる。deltatimeを積算して時刻を付け、キューへ積む
+ * @param[in]  deltatime 前回のメッセージからの経過時間[sec]
+ * @param[in]  msg
+ * @param[in]  size
+ */
+void MidiCtrl::MidiInput( double deltatime, const unsigned char *msg, int size )
+{
+    if(size <= 0 || size > 3) { return; }  // SysEx等は扱わない
+
+    uint64_t now   = midi_clock_ns();
+    uint64_t stamp = rx_time_ns_ + (uint64_t)(deltatime * 1e9);
+    if( rx_time_ns_ == 0 || stamp > now || now - stamp > kResyncNs ) {
+        stamp = now;
+    }
+    rx_time_ns_ = stamp;
+
+    MidiEvent ev = {};
+    ev.time_ns = stamp;
+    ev.size    = size;
+    for( int ix=0; ix<size; ix++ ) { ev.data[ix] = msg[ix]; }
+    rx_queue_.Push( ev );
+}
+
+/**
+ * @brief MidiSend
+ * @note  UIスレッド等から呼ぶ。受信時刻を付けてキューへ積む
+ * @param[in]  msg
+ */
+void MidiCtrl::MidiSend( std::vector<unsigned char> *msg )
+{
+    MidiSendAt( msg->data(), msg->size(), midi_clock_ns() );
+}
+
+/**
+ * @brief MidiSendAt
+ * @note  時刻を指定してキューへ積む（時刻はsteady_clockのナノ秒）
+ * @param[in]  msg
+ * @param[in]  size
+ * @param[in]  time_ns
+ */
+void MidiCtrl::MidiSendAt( const unsigned char *msg, int size, uint64_t time_ns )
+{
+    if(size <= 0 || size > 3) { return; }
+
+    MidiEvent ev = {};
+    ev.time_ns = time_ns;
+    ev.size    = size;
+    for( int ix=0; ix<size; ix++ ) { ev.data[ix] = msg[ix]; }
+    tx_queue_.Push( ev );
+}
+
 /**
  * @brief midi_in_callback
  * @param[in]  deltatime
@@ -119,7 +214,7 @@ void MidiCtrl::MidiRecv( std::vector<unsigned char> *msg )
 static void midi_input_callback( double deltatime, std::vector<unsigned char> *message, void * user_data )
 {
     MidiCtrl* midictrl = (MidiCtrl*)user_data;
-    midictrl->MidiRecv( message );
+    midictrl->MidiInput( deltatime, message->data(), message->size() );
 
 #if 1
     for ( unsigned int ix=0; ix<message->size(); ix++ ) {
@@ -133,6 +228,83 @@ static void midi_input_callback( double deltatime, std::vector<unsigned char> *m
 
 ///////////////////////////////////////////////////////////////////////////////
 
+/**
+ * @brief BeginBlock
+ * @note  コールバックの先頭でオーディオスレッドから1回だけ呼ぶ（内部でブロックに分けて処理する場合も、
+ *        分ける前のフレーム数で呼ぶ）。
+ *        前回のBeginBlock以降に届いたイベントをキューから取り出し、時刻順に並べて
+ *        コールバック先頭からのサンプルオフセットを決める（1コールバック分遅れて発音される）。
+ * @param[in]  frames コールバックのフレーム数
+ * @param[in]  fs     サンプリング周波数
+ */
+void MidiCtrl::BeginBlock( int frames, float fs )
+{
+    BeginBlockAt( frames, fs, midi_clock_ns() );
+}
+
+/**
+ * @brief BeginBlockAt
+ * @note  BeginBlockの、今の時刻を指定する版
+ * @param[in]  frames コールバックのフレーム数
+ * @param[in]  fs     サンプリング周波数
+ * @param[in]  now_ns 今の時刻（steady_clockのナノ秒）
+ */
+void MidiCtrl::BeginBlockAt( int frames, float fs, uint64_t now_ns )
+{
+    uint64_t now = now_ns;
+    if( prev_block_ns_ == 0 ) { prev_block_ns_ = now; }
+
+    // 取り出し
+    pending_num_ = 0;
+    pending_pos_ = 0;
+    MidiEvent ev;
+    while( pending_num_ < kPendingMax && rx_queue_.Pop( &ev ) ) { pending_[pending_num_++] = ev; }
+    while( pending_num_ < kPendingMax && tx_queue_.Pop( &ev ) ) { pending_[pending_num_++] = ev; }
+
+    // 時刻順に整列（件数は少ないので挿入ソート）
+    for( int ix=1; ix<pending_num_; ix++ ) {
+        MidiEvent tmp = pending_[ix];
+        int jx = ix - 1;
+        for( ; jx >= 0 && pending_[jx].time_ns > tmp.time_ns; jx-- ) {
+            pending_[jx+1] = pending_[jx];
+        }
+        pending_[jx+1] = tmp;
+    }
+
+    // サンプルオフセットへ変換
+    for( int ix=0; ix<pending_num_; ix++ ) {
+        int offset = 0;
+        if( pending_[ix].time_ns > prev_block_ns_ ) {
+            offset = (int)( (double)(pending_[ix].time_ns - prev_block_ns_) * fs / 1e9 );
+        }
+        pending_offset_[ix] = (offset < frames) ? offset : frames - 1;
+    }
+
+    prev_block_ns_ = now;
+}
+
+/**
+ * @brief NextEventOffset
+ * @retval 次に処理するイベントのブロック内オフセット。なければkNoEvent
+ */
+int MidiCtrl::NextEventOffset()
+{
+    return (pending_pos_ < pending_num_) ? pending_offset_[pending_pos_] : kNoEvent;
+}
+
+/**
+ * @brief DispatchEvent
+ * @note  次のイベントを鍵盤状態へ反映する
+ */
+void MidiCtrl::DispatchEvent()
+{
+    if( pending_pos_ >= pending_num_ ) { return; }
+    const MidiEvent& ev = pending_[pending_pos_++];
+    MidiRecv( ev.data, ev.size );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
 /**
  * @brief KeyOn
  * @param[in] Note Num
@@ -143,6 +315,7 @@ void MidiCtrl::KeyOn( int nn, int v )
     if( key_table_[nn] != 0 ) { KeyOff(nn); }
     key_table_[nn]    =  v;
     dumper_table_[nn] = false;
+    key_pressure_[nn] = 0;
     on_key_nn_list_[on_key_num_] = nn + 256;  // +256は新規押鍵フラグ
     on_key_num_++;
     is_status_changed_ = true;
@@ -231,3 +404,48 @@ static bool midi_choose_port( RtMidiIn *rtmidi )
   return true;
 }
 
+
+/**
+ * @brief midi_clock_ns
+ */
+static uint64_t midi_clock_ns()
+{
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>( steady_clock::now().time_since_epoch() ).count();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Push
+ * @param[in]  ev
+ * @retval true  成功
+ * @retval false キューが満杯
+ */
+bool MidiEventQueue::Push( const MidiEvent& ev )
+{
+    uint32_t tail = tail_.load( std::memory_order_relaxed );
+    if( tail - head_.load( std::memory_order_acquire ) >= kCapacity ) {
+        return false;
+    }
+    buf_[tail & (kCapacity-1)] = ev;
+    tail_.store( tail + 1, std::memory_order_release );
+    return true;
+}
+
+/**
+ * @brief Pop
+ * @param[out] ev
+ * @retval true  成功
+ * @retval false キューが空
+ */
+bool MidiEventQueue::Pop( MidiEvent* ev )
+{
+    uint32_t head = head_.load( std::memory_order_relaxed );
+    if( head == tail_.load( std::memory_order_acquire ) ) {
+        return false;
+    }
+    *ev = buf_[head & (kCapacity-1)];
+    head_.store( head + 1, std::memory_order_release );
+    return true;
+}
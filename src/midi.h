@@ -4,6 +4,38 @@
 #pragma once
 
 #include <vector>
+#include <atomic>
+#include <cstdint>
+
+/**
+ * @struct MidiEvent
+ * @brief  受信したMIDIメッセージ（3バイト以下のもののみ）
+ */
+struct MidiEvent {
+    uint64_t time_ns;   // 受信時刻(steady_clock基準)
+    uint8_t  size;      // メッセージ長
+    uint8_t  data[3];   // メッセージ本体
+};
+
+/**
+ * @class MidiEventQueue
+ * @brief 1プロデューサ/1コンシューマ用のウェイトフリーなリングバッファ
+ */
+class MidiEventQueue {
+public:
+    static const uint32_t kCapacity = 256;  // 2のべき乗であること
+
+    MidiEventQueue() : head_(0), tail_(0) {}
+    ~MidiEventQueue() {}
+
+    bool Push( const MidiEvent& ev );  // プロデューサ側から呼ぶ
+    bool Pop( MidiEvent* ev );         // コンシューマ側から呼ぶ
+
+private:
+    MidiEvent             buf_[kCapacity];
+    std::atomic<uint32_t> head_;  // 次に読み出す位置
+    std::atomic<uint32_t> tail_;  // 次に書き込む位置
+};
 
 class MidiCtrl {
 private:
@@ -11,10 +43,17 @@ private:
         on_key_num_        = 0;
         dumper_            = false;
         is_status_changed_ = false;
+        rx_time_ns_        = 0;
+        prev_block_ns_     = 0;
+        pending_num_       = 0;
+        pending_pos_       = 0;
+        mod_wheel_         = 0;
+        channel_pressure_  = 0;
         for( int ix=0; ix<128; ix++ ) {
             key_table_[ix]      = 0;
             on_key_nn_list_[ix] = 0;
             dumper_table_[ix]   = 0;
+            key_pressure_[ix]   = 0;
         }
     }
     ~MidiCtrl() {}
@@ -25,6 +64,8 @@ private:
 
     bool Initialize();
 
+    static bool no_port_;
+
     void KeyOn( int nn, int v );
     void KeyOff( int nn );
 
@@ -35,19 +76,54 @@ private:
     bool dumper_table_[128];    // ダンパーオフで、リリースすべき鍵盤情報
     bool is_status_changed_;    // キーの押下状態が変更されたかのフラグ
 
+    // コントローラー（変調元）
+    int  mod_wheel_;            // モジュレーションホイール(CC#1)
+    int  channel_pressure_;     // チャンネルプレッシャー
+    int  key_pressure_[128];    // ポリフォニックキープレッシャー
+
+    // イベントキュー（RtMidiスレッド用とMidiSend用の2本。どちらもコンシューマはオーディオスレッド）
+    MidiEventQueue rx_queue_;
+    MidiEventQueue tx_queue_;
+    uint64_t       rx_time_ns_;     // 直前に受信したイベントの時刻（RtMidiスレッドのみ使用）
+
+    // 処理中ブロックのイベント（オーディオスレッドのみ使用）
+    static const int kPendingMax = 256;
+    MidiEvent pending_[kPendingMax];
+    int       pending_offset_[kPendingMax];  // コールバック先頭からのサンプルオフセット
+    int       pending_num_;
+    int       pending_pos_;
+    uint64_t  prev_block_ns_;       // 前回BeginBlockした時刻（前のコールバックの開始時刻）
+
 public:
+    static const int kNoEvent = 0x7FFFFFFF;
+
     static MidiCtrl* Create();
     static void      Destroy();
     static MidiCtrl* GetInstance();
 
-    void MidiRecv( std::vector<unsigned char> *msg );
-    void MidiSend( std::vector<unsigned char> *msg ) { MidiRecv(msg); }
+    // MIDIポートを開かない（オフラインレンダリング用。Createより前に呼ぶ）
+    static void NoPortMode();
+
+    void MidiRecv( const unsigned char *msg, int size );
+    void MidiInput( double deltatime, const unsigned char *msg, int size );
+    void MidiSend( std::vector<unsigned char> *msg );
+    void MidiSendAt( const unsigned char *msg, int size, uint64_t time_ns );  // 時刻を指定して送る
+
+    // オーディオスレッド側のイベント処理（BeginBlockはコールバック毎に1回、そのフレーム数で呼ぶ）
+    void BeginBlock( int frames, float fs );
+    void BeginBlockAt( int frames, float fs, uint64_t now_ns );
+    int  NextEventOffset();
+    void DispatchEvent();
 
     // key management
     bool IsStatusChanged();
     void ResetStatusChange();
 
     int GetVelocity(int nn) { return key_table_[nn]; };
+
+    // コントローラー（0～127）
+    int GetModWheel()         { return mod_wheel_; }
+    int GetAftertouch(int nn) { return (key_pressure_[nn] > channel_pressure_) ? key_pressure_[nn] : channel_pressure_; }
     int GetOnKeyNum(void)   { return on_key_num_; };
 
     // n番目に新しい押鍵キーのノートNOを取得。なければ、-1を返す。
@@ -0,0 +1,252 @@
+/**
+ * @file midi_file.cpp
+ */
+#include <cstdio>
+#include <algorithm>
+
+#include "midi_file.h"
+
+static const uint32_t kDefaultTempo = 500000;  // 120BPM
+
+static uint32_t mf_read_be( const uint8_t* p, int size );
+static bool     mf_read_vlq( const uint8_t* data, size_t size, size_t* pos, uint32_t* val );
+
+/**
+ * @brief ファイルを読み込む
+ *
+ * @param[in] path
+ * @retval true  成功
+ * @retval false 失敗
+ */
+bool MidiFile::Load( const char* path )
+{
+    FILE* fp = fopen( path, "rb" );
+    if( !fp ) {
+        fprintf(stderr, "unable to open MIDI file: %s\n", path);
+        return false;
+    }
+
+    std::vector<uint8_t> buf;
+    uint8_t chunk[4096];
+    size_t  num;
+    while( (num = fread( chunk, 1, sizeof(chunk), fp )) > 0 ) {
+        buf.insert( buf.end(), chunk, chunk + num );
+    }
+    fclose( fp );
+
+    return Parse( buf.data(), buf.size() );
+}
+
+/**
+ * @brief メモリ上のSMFを解析する
+ *
+ * @param[in] data
+ * @param[in] size
+ * @retval true  成功
+ * @retval false 失敗
+ */
+bool MidiFile::Parse( const uint8_t* data, size_t size )
+{
+    events_.clear();
+
+    // header chunk
+    if( size < 14 || mf_read_be( data, 4 ) != 0x4D546864 /* MThd */ ) {
+        fprintf(stderr, "not a Standard MIDI File\n");
+        return false;
+    }
+    uint32_t header_len = mf_read_be( &data[4], 4 );
+    int      format     = mf_read_be( &data[8], 2 );
+    int      track_num  = mf_read_be( &data[10], 2 );
+    int      division   = mf_read_be( &data[12], 2 );
+    if( format > 1 ) {
+        fprintf(stderr, "unsupported SMF format: %d\n", format);
+        return false;
+    }
+    if( division & 0x8000 ) {
+        fprintf(stderr, "SMPTE time division is not supported\n");
+        return false;
+    }
+
+    // track chunks
+    std::vector<TickEvent> tick_events;
+    size_t pos = 8 + header_len;
+    for( int track=0; track<track_num; track++ ) {
+        if( pos + 8 > size ) {
+            fprintf(stderr, "unexpected end of file\n");
+            return false;
+        }
+        uint32_t id  = mf_read_be( &data[pos],   4 );
+        uint32_t len = mf_read_be( &data[pos+4], 4 );
+        pos += 8;
+        if( pos + len > size ) {
+            fprintf(stderr, "unexpected end of file\n");
+            return false;
+        }
+        if( id == 0x4D54726B /* MTrk */ ) {
+            if( !ParseTrack( &data[pos], len, track, &tick_events ) ) {
+                return false;
+            }
+        }
+        else {
+            track--;  // 未知のチャンクは読み飛ばす
+        }
+        pos += len;
+    }
+
+    // tick順（同じtickならトラック順、トラック内の順）に並べる
+    std::stable_sort( tick_events.begin(), tick_events.end(),
+        []( const TickEvent& a, const TickEvent& b ) {
+            return (a.tick != b.tick) ? (a.tick < b.tick) : (a.track < b.track);
+        } );
+
+    // テンポマップを適用して秒へ変換する
+    uint32_t tempo     = kDefaultTempo;
+    uint32_t last_tick = 0;
+    double   time      = 0.0;
+    for( size_t ix=0; ix<tick_events.size(); ix++ ) {
+        const TickEvent& tev = tick_events[ix];
+        time     += (double)(tev.tick - last_tick) * tempo / division / 1e6;
+        last_tick = tev.tick;
+
+        if( tev.tempo != 0 ) {
+            tempo = tev.tempo;
+            continue;
+        }
+
+        MidiFileEvent ev;
+        ev.time = time;
+        ev.size = tev.size;
+        for( int jx=0; jx<3; jx++ ) { ev.data[jx] = tev.data[jx]; }
+        events_.push_back( ev );
+    }
+
+    return true;
+}
+
+/**
+ * @brief 最後のイベントの時刻[sec]
+ */
+double MidiFile::GetLength()
+{
+    return events_.empty() ? 0.0 : events_.back().time;
+}
+
+/**
+ * @brief 1トラック分のイベントを取り出す
+ *
+ * @param[in]  data  トラックチャンクの中身
+ * @param[in]  size
+ * @param[in]  track トラック番号
+ * @param[out] out   取り出したイベントを追加する
+ * @retval true  成功
+ * @retval false 失敗
+ */
+bool MidiFile::ParseTrack( const uint8_t* data, size_t size, int track, std::vector<TickEvent>* out )
+{
+    size_t   pos     = 0;
+    uint32_t tick    = 0;
+    uint8_t  running = 0;  // ランニングステータス
+
+    while( pos < size ) {
+        uint32_t delta;
+        if( !mf_read_vlq( data, size, &pos, &delta ) || pos >= size ) {
+            fprintf(stderr, "track %d: broken event\n", track);
+            return false;
+        }
+        tick += delta;
+
+        uint8_t status = data[pos];
+        if( status & 0x80 ) {
+            pos++;
+        }
+        else if( running ) {
+            status = running;  // データバイトから始まっている
+        }
+        else {
+            fprintf(stderr, "track %d: data byte without status\n", track);
+            return false;
+        }
+
+        if( status == 0xFF ) {
+            // meta event
+            if( pos >= size ) { break; }
+            uint8_t  type = data[pos++];
+            uint32_t len;
+            if( !mf_read_vlq( data, size, &pos, &len ) || pos + len > size ) {
+                fprintf(stderr, "track %d: broken meta event\n", track);
+                return false;
+            }
+            if( type == 0x51 && len == 3 ) {
+                TickEvent tev = {};
+                tev.tick  = tick;
+                tev.tempo = mf_read_be( &data[pos], 3 );
+                tev.track = track;
+                out->push_back( tev );
+            }
+            pos += len;
+            if( type == 0x2F ) { break; }  // end of track
+        }
+        else if( status == 0xF0 || status == 0xF7 ) {
+            // SysExは読み飛ばす
+            uint32_t len;
+            if( !mf_read_vlq( data, size, &pos, &len ) || pos + len > size ) {
+                fprintf(stderr, "track %d: broken SysEx\n", track);
+                return false;
+            }
+            pos += len;
+            running = 0;
+        }
+        else {
+            // channel message
+            running = status;
+            int len = ((status & 0xE0) == 0xC0) ? 1 : 2;  // プログラムチェンジとチャンネルプレッシャーは1バイト
+            if( pos + len > size ) {
+                fprintf(stderr, "track %d: broken channel message\n", track);
+                return false;
+            }
+            TickEvent tev = {};
+            tev.tick    = tick;
+            tev.track   = track;
+            tev.size    = 1 + len;
+            tev.data[0] = status;
+            for( int ix=0; ix<len; ix++ ) { tev.data[1+ix] = data[pos+ix]; }
+            out->push_back( tev );
+            pos += len;
+        }
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief ビッグエンディアンの整数を読む
+ */
+static uint32_t mf_read_be( const uint8_t* p, int size )
+{
+    uint32_t val = 0;
+    for( int ix=0; ix<size; ix++ ) {
+        val = (val << 8) | p[ix];
+    }
+    return val;
+}
+
+/**
+ * @brief 可変長数値を読む
+ */
+static bool mf_read_vlq( const uint8_t* data, size_t size, size_t* pos, uint32_t* val )
+{
+    *val = 0;
+    for( int ix=0; ix<4; ix++ ) {
+        if( *pos >= size ) {
+            return false;
+        }
+        uint8_t c = data[(*pos)++];
+        *val = (*val << 7) | (c & 0x7F);
+        if( !(c & 0x80) ) {
+            return true;
+        }
+    }
+    return false;
+}
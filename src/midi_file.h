@@ -0,0 +1,47 @@
+/**
+ * @file midi_file.h
+ */
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+/**
+ * @struct MidiFileEvent
+ * @brief  Standard MIDI Fileから取り出したチャンネルメッセージ
+ */
+struct MidiFileEvent {
+    double  time;     // 曲頭からの時刻[sec]
+    uint8_t size;     // メッセージ長
+    uint8_t data[3];  // メッセージ本体
+};
+
+/**
+ * @class MidiFile
+ * @brief Standard MIDI File(フォーマット0/1)の読み込み
+ */
+class MidiFile {
+public:
+    MidiFile(){}
+    ~MidiFile(){}
+
+    bool Load( const char* path );
+    bool Parse( const uint8_t* data, size_t size );
+
+    // 全トラックのチャンネルメッセージを時刻順に並べたもの
+    const std::vector<MidiFileEvent>& GetEvents() { return events_; }
+    double GetLength();
+
+private:
+    struct TickEvent {
+        uint32_t tick;
+        uint32_t tempo;     // テンポ変更(メタイベント)なら μs/四分音符、それ以外は0
+        int      track;
+        uint8_t  size;
+        uint8_t  data[3];
+    };
+
+    std::vector<MidiFileEvent> events_;
+
+    bool ParseTrack( const uint8_t* data, size_t size, int track, std::vector<TickEvent>* out );
+};
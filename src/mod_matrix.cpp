@@ -0,0 +1,109 @@
+/**
+ * @file mod_matrix.cpp
+ */
+#include <cstdio>
+#include <string.h>
+
+#include "mod_matrix.h"
+
+static const char* const kSourceName[ModMatrix::kSrcNum] = {
+    "lfo1", "lfo2", "env2", "velocity", "aftertouch", "modwheel"
+};
+
+static const char* const kDestName[ModMatrix::kDstNum] = {
+    "pitch", "cutoff", "amp", "pan"
+};
+
+/**
+ * @brief constructor
+ */
+ModMatrix::ModMatrix()
+{
+    Clear();
+}
+
+/**
+ * @brief 接続の設定
+ * @note  同じslotを設定し直すと置き換わる。amountが0なら接続を外す
+ *
+ * @param[in] slot   接続番号(0～kSlotNum-1)
+ * @param[in] src    変調元(Source)
+ * @param[in] dst    変調先(Dest)
+ * @param[in] amount 量
+ * @retval true  成功
+ * @retval false 引数が範囲外
+ */
+bool ModMatrix::SetSlot( int slot, int src, int dst, float amount )
+{
+    if( slot < 0 || slot >= kSlotNum || src < 0 || src >= kSrcNum || dst < 0 || dst >= kDstNum ) {
+        fprintf(stderr, "ModMatrix: invalid slot %d (src=%d dst=%d)\n", slot, src, dst);
+        return false;
+    }
+
+    // 前の設定を外す
+    for( int ix=0; ix<slot_num_; ix++ ) {
+        if( slot_[ix].no == slot ) {
+            slot_[ix] = slot_[--slot_num_];
+            break;
+        }
+    }
+
+    if( amount != 0.f ) {
+        Slot& s = slot_[slot_num_++];
+        s.no     = slot;
+        s.src    = src;
+        s.dst    = dst;
+        s.amount = amount;
+    }
+    return true;
+}
+
+/**
+ * @brief 全ての接続を外す
+ */
+void ModMatrix::Clear()
+{
+    slot_num_ = 0;
+}
+
+/**
+ * @brief 変調元の値から変調先の値を求める
+ *
+ * @param[in]  src 変調元の値(kSrcNum個)
+ * @param[out] dst 変調先の値(kDstNum個)
+ */
+void ModMatrix::Process( const float* src, float* dst ) const
+{
+    for( int ix=0; ix<kDstNum; ix++ ) {
+        dst[ix] = 0.f;
+    }
+    for( int ix=0; ix<slot_num_; ix++ ) {
+        dst[slot_[ix].dst] += src[slot_[ix].src] * slot_[ix].amount;
+    }
+}
+
+/**
+ * @brief 変調元の名前(パッチファイル用)から番号を求める
+ */
+int ModMatrix::SourceFromName( const char* name )
+{
+    for( int ix=0; ix<kSrcNum; ix++ ) {
+        if( strcmp( name, kSourceName[ix] ) == 0 ) {
+            return ix;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief 変調先の名前(パッチファイル用)から番号を求める
+ */
+int ModMatrix::DestFromName( const char* name )
+{
+    for( int ix=0; ix<kDstNum; ix++ ) {
+        if( strcmp( name, kDestName[ix] ) == 0 ) {
+            return ix;
+        }
+    }
+    return -1;
+}
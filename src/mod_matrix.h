@@ -0,0 +1,60 @@
+/**
+ * @file mod_matrix.h
+ */
+#pragma once
+
+/**
+ * @class ModMatrix
+ * @brief 変調元から変調先への接続表
+ * @note  使っている接続だけを詰めて持つ。変調先の値は接続毎の 変調元の値×量 の合計
+ */
+class ModMatrix {
+public:
+    // 変調元
+    enum Source
+    {
+        kSrcLfo1,        // -1～1
+        kSrcLfo2,        // -1～1
+        kSrcEnv2,        // 0～1
+        kSrcVelocity,    // 0～1
+        kSrcAftertouch,  // 0～1（チャンネルプレッシャーとポリフォニックキープレッシャーの大きい方）
+        kSrcModWheel,    // 0～1
+        kSrcNum
+    };
+
+    // 変調先
+    enum Dest
+    {
+        kDstPitch,   // 半音
+        kDstCutoff,  // 半音
+        kDstAmp,     // 音量の倍率 - 1（0なら変化なし、-1で無音）
+        kDstPan,     // -1(左)～1(右)
+        kDstNum
+    };
+
+    static const int kSlotNum = 8;  // 接続できる数
+
+    ModMatrix();
+    ~ModMatrix(){}
+
+    bool SetSlot( int slot, int src, int dst, float amount );
+    void Clear();
+
+    void Process( const float* src, float* dst ) const;  // src[kSrcNum] -> dst[kDstNum]
+
+    int  GetSlotNum() const { return slot_num_; }
+
+    static int SourceFromName( const char* name );  // 無ければ-1
+    static int DestFromName( const char* name );    // 無ければ-1
+
+private:
+    struct Slot {
+        int   no;      // SetSlotで指定した番号
+        int   src;
+        int   dst;
+        float amount;
+    };
+
+    Slot slot_[kSlotNum];  // 使っている接続（詰めて持つ）
+    int  slot_num_;
+};
@@ -0,0 +1,240 @@
+/**
+ * @file patch.cpp
+ * @brief 音色パラメータ
+ * @note  パッチファイルは1行に1つ「名前 = 値」の形式で書く（#以降はコメント）
+ *
+ *        mode    = poly     # poly, mono, legato
+ *        poly    = 16
+ *        steal   = released # oldest, quietest, released（全ボイス発音中の時に横取りするボイス）
+ *        same_note = 0      # 1なら同じノートを鳴らしているボイスを使い回す
+ *        attack  = 100      # ms
+ *        decay   = 200      # ms
+ *        sustain = 0.5
+ *        release = 1000     # ms
+ *        curve   = linear   # linear, exp
+ *
+ *        cutoff        = 20000  # Hz
+ *        resonance     = 0.707  # Q
+ *        fenv_amount   = 0      # semitones
+ *        fenv_attack   = 10     # ms
+ *        fenv_decay    = 300    # ms
+ *        fenv_sustain  = 0.0
+ *        fenv_release  = 300    # ms
+ *
+ *        control_rate  = 32     # 変調を求める間隔（サンプル）
+ *        lfo1_rate     = 5      # Hz（lfo2_も同じ）
+ *        lfo1_shape    = sine   # sine, triangle, saw, square, sh
+ *        lfo1_sync     = 1      # 1ならキーオン毎に位相を先頭へ戻す
+ *        env2_attack   = 10     # ms（2つ目のエンベロープ。env2_decay, env2_sustain, env2_releaseも同様）
+ *        mod1          = lfo1 pitch 0.2  # 変調元 変調先 量（mod1～mod8）
+ *                                         # 変調元: lfo1, lfo2, env2, velocity, aftertouch, modwheel
+ *                                         # 変調先: pitch(半音), cutoff(半音), amp(倍率-1), pan(-1～1)
+ *
+ *        unison        = 1      # 1ノートで重ねるボイス数(1～16)
+ *        unison_detune = 20     # 両端のデチューン（セント）
+ *        unison_spread = 0.5    # 両端の定位の広がり(0～1)
+ *        unison_phase  = random # random, reset（ノートの始めに位相をばらす/揃える）
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <string.h>
+
+#include "synth.h"
+#include "envelope.h"
+#include "lfo.h"
+#include "patch.h"
+
+static char* patch_trim( char* str );
+static bool  patch_lfo_shape( const char* val, int* shape );
+static bool  patch_mod_slot( const char* val, ModMatrix* matrix, int slot );
+
+/**
+ * @brief constructor（初期値）
+ */
+Patch::Patch()
+{
+    key_mode   = VoiceCtrl::kPoly;
+    poly_num   = 16;
+    steal_mode = VoiceCtrl::kStealReleasedFirst;
+    same_note_reuse = false;
+    attack_ms  = 100;
+    decay_ms   = 200;
+    sustain_lv = 0.5f;
+    release_ms = 1000;
+    env_curve  = Envelope::kLinear;
+
+    cutoff_hz   = 20000.f;
+    resonance   = 0.707f;
+    fenv_amount = 0.f;
+
+    fenv_attack_ms  = 10;
+    fenv_decay_ms   = 300;
+    fenv_sustain_lv = 0.f;
+    fenv_release_ms = 300;
+
+    control_frames = 32;
+    for( int ix=0; ix<kLfoNum; ix++ ) {
+        lfo_rate_hz[ix]  = 5.f;
+        lfo_shape[ix]    = Lfo::kSine;
+        lfo_key_sync[ix] = true;
+    }
+
+    env2_attack_ms  = 10;
+    env2_decay_ms   = 300;
+    env2_sustain_lv = 0.f;
+    env2_release_ms = 300;
+
+    unison_num          = 1;
+    unison_detune_cent  = 20.f;
+    unison_spread       = 0.5f;
+    unison_random_phase = true;
+}
+
+/**
+ * @brief パッチファイルを読み込む（書かれていないパラメータは今の値のまま）
+ *
+ * @param[in] path
+ * @retval true  成功
+ * @retval false ファイルを開けなかった
+ */
+bool Patch::Load( const char* path )
+{
+    FILE* fp = fopen( path, "r" );
+    if( !fp ) {
+        fprintf(stderr, "unable to open patch: %s\n", path);
+        return false;
+    }
+
+    char line[256];
+    int  line_no = 0;
+    while( fgets( line, sizeof(line), fp ) ) {
+        line_no++;
+
+        char* comment = strchr( line, '#' );
+        if( comment ) { *comment = '\0'; }
+
+        char* eq = strchr( line, '=' );
+        if( !eq ) {
+            if( *patch_trim( line ) != '\0' ) {
+                fprintf(stderr, "%s:%d: syntax error\n", path, line_no);
+            }
+            continue;
+        }
+        *eq = '\0';
+        const char* key = patch_trim( line );
+        const char* val = patch_trim( eq + 1 );
+
+        if( strcmp( key, "mode" ) == 0 ) {
+            if     ( strcmp( val, "poly" )   == 0 ) { key_mode = VoiceCtrl::kPoly; }
+            else if( strcmp( val, "mono" )   == 0 ) { key_mode = VoiceCtrl::kMono; }
+            else if( strcmp( val, "legato" ) == 0 ) { key_mode = VoiceCtrl::kLegato; }
+            else { fprintf(stderr, "%s:%d: unknown mode: %s\n", path, line_no, val); }
+        }
+        else if( strcmp( key, "poly" )    == 0 ) { poly_num   = atoi( val ); }
+        else if( strcmp( key, "steal" )   == 0 ) {
+            if     ( strcmp( val, "oldest" )   == 0 ) { steal_mode = VoiceCtrl::kStealOldest; }
+            else if( strcmp( val, "quietest" ) == 0 ) { steal_mode = VoiceCtrl::kStealQuietest; }
+            else if( strcmp( val, "released" ) == 0 ) { steal_mode = VoiceCtrl::kStealReleasedFirst; }
+            else { fprintf(stderr, "%s:%d: unknown steal mode: %s\n", path, line_no, val); }
+        }
+        else if( strcmp( key, "same_note" ) == 0 ) { same_note_reuse = (atoi( val ) != 0); }
+        else if( strcmp( key, "attack" )  == 0 ) { attack_ms  = atoi( val ); }
+        else if( strcmp( key, "decay" )   == 0 ) { decay_ms   = atoi( val ); }
+        else if( strcmp( key, "sustain" ) == 0 ) { sustain_lv = atof( val ); }
+        else if( strcmp( key, "release" ) == 0 ) { release_ms = atoi( val ); }
+        else if( strcmp( key, "curve" ) == 0 ) {
+            if     ( strcmp( val, "linear" ) == 0 ) { env_curve = Envelope::kLinear; }
+            else if( strcmp( val, "exp" )    == 0 ) { env_curve = Envelope::kExponential; }
+            else { fprintf(stderr, "%s:%d: unknown curve: %s\n", path, line_no, val); }
+        }
+        else if( strcmp( key, "cutoff" )       == 0 ) { cutoff_hz       = atof( val ); }
+        else if( strcmp( key, "resonance" )    == 0 ) { resonance       = atof( val ); }
+        else if( strcmp( key, "fenv_amount" )  == 0 ) { fenv_amount     = atof( val ); }
+        else if( strcmp( key, "fenv_attack" )  == 0 ) { fenv_attack_ms  = atoi( val ); }
+        else if( strcmp( key, "fenv_decay" )   == 0 ) { fenv_decay_ms   = atoi( val ); }
+        else if( strcmp( key, "fenv_sustain" ) == 0 ) { fenv_sustain_lv = atof( val ); }
+        else if( strcmp( key, "fenv_release" ) == 0 ) { fenv_release_ms = atoi( val ); }
+        else if( strcmp( key, "control_rate" ) == 0 ) { control_frames  = atoi( val ); }
+        else if( strncmp( key, "lfo", 3 ) == 0 && key[3] >= '1' && key[3] < '1' + kLfoNum && key[4] == '_' ) {
+            int         no    = key[3] - '1';
+            const char* param = &key[5];
+            if     ( strcmp( param, "rate" )  == 0 ) { lfo_rate_hz[no]  = atof( val ); }
+            else if( strcmp( param, "sync" )  == 0 ) { lfo_key_sync[no] = (atoi( val ) != 0); }
+            else if( strcmp( param, "shape" ) == 0 ) {
+                if( !patch_lfo_shape( val, &lfo_shape[no] ) ) {
+                    fprintf(stderr, "%s:%d: unknown lfo shape: %s\n", path, line_no, val);
+                }
+            }
+            else { fprintf(stderr, "%s:%d: unknown parameter: %s\n", path, line_no, key); }
+        }
+        else if( strcmp( key, "env2_attack" )  == 0 ) { env2_attack_ms  = atoi( val ); }
+        else if( strcmp( key, "env2_decay" )   == 0 ) { env2_decay_ms   = atoi( val ); }
+        else if( strcmp( key, "env2_sustain" ) == 0 ) { env2_sustain_lv = atof( val ); }
+        else if( strcmp( key, "env2_release" ) == 0 ) { env2_release_ms = atoi( val ); }
+        else if( strcmp( key, "unison" )        == 0 ) { unison_num         = atoi( val ); }
+        else if( strcmp( key, "unison_detune" ) == 0 ) { unison_detune_cent = atof( val ); }
+        else if( strcmp( key, "unison_spread" ) == 0 ) { unison_spread      = atof( val ); }
+        else if( strcmp( key, "unison_phase" )  == 0 ) {
+            if     ( strcmp( val, "random" ) == 0 ) { unison_random_phase = true; }
+            else if( strcmp( val, "reset" )  == 0 ) { unison_random_phase = false; }
+            else { fprintf(stderr, "%s:%d: unknown unison phase: %s\n", path, line_no, val); }
+        }
+        else if( strncmp( key, "mod", 3 ) == 0 && atoi( &key[3] ) >= 1 ) {
+            if( !patch_mod_slot( val, &mod_matrix, atoi( &key[3] ) - 1 ) ) {
+                fprintf(stderr, "%s:%d: invalid modulation: %s\n", path, line_no, val);
+            }
+        }
+        else {
+            fprintf(stderr, "%s:%d: unknown parameter: %s\n", path, line_no, key);
+        }
+    }
+
+    fclose( fp );
+    return true;
+}
+
+/**
+ * @brief LFOの波形名から番号を求める
+ */
+static bool patch_lfo_shape( const char* val, int* shape )
+{
+    if     ( strcmp( val, "sine" )     == 0 ) { *shape = Lfo::kSine; }
+    else if( strcmp( val, "triangle" ) == 0 ) { *shape = Lfo::kTriangle; }
+    else if( strcmp( val, "saw" )      == 0 ) { *shape = Lfo::kSaw; }
+    else if( strcmp( val, "square" )   == 0 ) { *shape = Lfo::kSquare; }
+    else if( strcmp( val, "sh" )       == 0 ) { *shape = Lfo::kSampleHold; }
+    else { return false; }
+    return true;
+}
+
+/**
+ * @brief 「変調元 変調先 量」を読んで変調の接続を設定する
+ */
+static bool patch_mod_slot( const char* val, ModMatrix* matrix, int slot )
+{
+    char src[32], dst[32];
+    float amount;
+    if( sscanf( val, "%31s %31s %f", src, dst, &amount ) != 3 ) {
+        return false;
+    }
+    int src_no = ModMatrix::SourceFromName( src );
+    int dst_no = ModMatrix::DestFromName( dst );
+    if( src_no < 0 || dst_no < 0 ) {
+        return false;
+    }
+    return matrix->SetSlot( slot, src_no, dst_no, amount );
+}
+
+/**
+ * @brief 前後の空白を取り除く
+ */
+static char* patch_trim( char* str )
+{
+    while( *str == ' ' || *str == '\t' ) { str++; }
+
+    char* end = str + strlen( str );
+    while( end > str && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r' || end[-1] == '\n') ) { end--; }
+    *end = '\0';
+
+    return str;
+}
@@ -0,0 +1,64 @@
+/**
+ * @file patch.h
+ */
+#pragma once
+
+#include "mod_matrix.h"
+
+/**
+ * @class Patch
+ * @brief 音色パラメータ
+ */
+class Patch {
+public:
+    Patch();
+    ~Patch(){}
+
+    bool Load( const char* path );
+
+    int   key_mode;    // VoiceCtrl::kPoly, kMono, kLegato
+    int   poly_num;    // ポリモード時の最大ボイス数
+    int   steal_mode;  // VoiceCtrl::kStealOldest, kStealQuietest, kStealReleasedFirst
+    bool  same_note_reuse;  // 同じノートを鳴らしているボイスを使い回す
+
+    // amp envelope
+    int   attack_ms;
+    int   decay_ms;
+    float sustain_lv;
+    int   release_ms;
+
+    int   env_curve;   // Envelope::kLinear, kExponential（アンプ、フィルタ共通）
+
+    // filter
+    float cutoff_hz;
+    float resonance;
+    float fenv_amount;  // フィルタエンベロープでカットオフを動かす幅（半音）
+
+    // filter envelope
+    int   fenv_attack_ms;
+    int   fenv_decay_ms;
+    float fenv_sustain_lv;
+    int   fenv_release_ms;
+
+    // modulation
+    int   control_frames;  // 変調を求める間隔[サンプル]
+
+    static const int kLfoNum = 2;
+    float lfo_rate_hz[kLfoNum];
+    int   lfo_shape[kLfoNum];     // Lfo::kSine, kTriangle, kSaw, kSquare, kSampleHold
+    bool  lfo_key_sync[kLfoNum];  // キーオン毎に位相を先頭へ戻す
+
+    // 2つ目のエンベロープ（変調元）
+    int   env2_attack_ms;
+    int   env2_decay_ms;
+    float env2_sustain_lv;
+    int   env2_release_ms;
+
+    ModMatrix mod_matrix;
+
+    // unison
+    int   unison_num;           // 1ノートで重ねる数(1～Voice::kMaxUnison)
+    float unison_detune_cent;   // 両端のデチューン（セント）
+    float unison_spread;        // 両端の定位の広がり(0～1)
+    bool  unison_random_phase;  // ノートの始めに位相をばらす（falseなら揃える）
+};
@@ -0,0 +1,248 @@
+/**
+ * @file render_pool.cpp
+ */
+#include <chrono>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RP_USE_SSE2
+#endif
+
+#include "common.h"
+#include "render_pool.h"
+#include "rt_thread.h"
+
+// ジョブを終えたワーカーが眠らずに次のRunを待つ時間[ns]
+//   Runの間隔（コールバックの周期）よりずっと短くする。SCHED_FIFOのワーカーが回り続けると
+//   yieldしても低い優先度のスレッドへCPUを譲らないので、ブロックの合間は眠らせる
+static const uint64_t kSpinNs = 50000;
+
+static uint64_t render_pool_clock_ns();
+static inline void render_pool_pause();
+
+/**
+ * @brief constructor
+ *
+ * @param[in] worker_num 呼び出しスレッドを含むワーカー数(1～kMaxWorkers)
+ * @param[in] priority   ワーカーのSCHED_FIFO優先度。オーディオスレッドのすぐ下にする（0ならそのまま）
+ */
+RenderPool::RenderPool( int worker_num, int priority )
+{
+    worker_num_  = MAX( 1, MIN( worker_num, kMaxWorkers ) );
+    priority_    = priority;
+    func_        = nullptr;
+    userdata_    = nullptr;
+    generation_  = 0;
+    remaining_   = 0;
+    sleeping_    = 0;
+    quit_        = false;
+
+    for( int ix=0; ix<kMaxWorkers; ix++ ) {
+        queue_[ix].range   = 0;
+        queue_[ix].time_ns = 0;
+        queue_[ix].job_num = 0;
+        thread_[ix]        = nullptr;
+    }
+
+    // ワーカー0は呼び出しスレッドが務める
+    for( int ix=1; ix<worker_num_; ix++ ) {
+        thread_[ix] = new std::thread( &RenderPool::WorkerMain, this, ix );
+    }
+}
+
+/**
+ * @brief destructor
+ */
+RenderPool::~RenderPool()
+{
+    {
+        std::lock_guard<std::mutex> lock( mutex_ );
+        quit_ = true;
+        generation_++;
+    }
+    cv_.notify_all();
+
+    for( int ix=1; ix<worker_num_; ix++ ) {
+        thread_[ix]->join();
+        delete thread_[ix];
+    }
+}
+
+/**
+ * @brief ジョブ0～job_num-1を実行し、全て終わるまで待つ
+ * @note  呼び出しスレッドもワーカー0として処理に加わる。同時に複数のスレッドから呼ばないこと。
+ *        ロックは取らない。待つのは他のワーカーが実行中のジョブだけ
+ *
+ * @param[in] func     ジョブ
+ * @param[in] userdata funcへ渡す
+ * @param[in] job_num  ジョブ数
+ */
+void RenderPool::Run( JobFunc func, void* userdata, int job_num )
+{
+    func_     = func;
+    userdata_ = userdata;
+
+    for( int ix=0; ix<worker_num_; ix++ ) {
+        queue_[ix].time_ns.store( 0, std::memory_order_relaxed );
+        queue_[ix].job_num.store( 0, std::memory_order_relaxed );
+    }
+    remaining_.store( job_num, std::memory_order_relaxed );
+
+    // ジョブを各ワーカーのキューへ連続した範囲で割り振る（ここまでの書き込みはrangeを読んだワーカーに見える）
+    for( int ix=0; ix<worker_num_; ix++ ) {
+        uint64_t begin = (uint64_t)job_num * ix / worker_num_;
+        uint64_t end   = (uint64_t)job_num * (ix+1) / worker_num_;
+        queue_[ix].range.store( (end << 32) | begin, std::memory_order_release );
+    }
+
+    // ワーカーを起こす
+    //   眠ろうとしているワーカーは、ロックを持ったままgeneration_を確かめてから待つ。
+    //   一度ロックを取ってから起こせば、確かめた後で待つ前のワーカーを起こし損ねることは無い
+    generation_.fetch_add( 1 );
+    if( sleeping_.load() > 0 ) {
+        { std::lock_guard<std::mutex> lock( mutex_ ); }
+        cv_.notify_all();
+    }
+
+    Work( 0 );
+
+    // 他のワーカーが処理中のジョブが終わるまで待つ
+    while( remaining_.load( std::memory_order_acquire ) > 0 ) {
+        render_pool_pause();
+    }
+}
+
+/**
+ * @brief キューと状態を物理メモリに載せる
+ * @note  全てコンストラクタで書き込んでいるので、読むだけでよい（ワーカーが動いていても呼べる）
+ * @return プリフォルトしたバイト数
+ */
+size_t RenderPool::Prefault()
+{
+    return RtThread::Prefault( this, sizeof(RenderPool) );
+}
+
+/**
+ * @brief GetWorkerTime
+ */
+uint32_t RenderPool::GetWorkerTime( int worker )
+{
+    return queue_[worker].time_ns.load( std::memory_order_relaxed );
+}
+
+/**
+ * @brief GetWorkerJobNum
+ */
+int RenderPool::GetWorkerJobNum( int worker )
+{
+    return queue_[worker].job_num.load( std::memory_order_relaxed );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief ワーカースレッド本体
+ *
+ * @param[in] worker ワーカー番号
+ */
+void RenderPool::WorkerMain( int worker )
+{
+    uint32_t seen = 0;  // 最後に見たRunの番号
+
+    // FTZ/DAZはスレッド毎の設定なので、オーディオスレッドと同じにしておく
+    RtThread::EnableFlushToZero();
+    RtThread::PrefaultStack();
+    if( priority_ > 0 ) {
+        RtThread::SetFifoPriority( priority_ );  // 権限が無ければそのまま
+    }
+
+    for(;;) {
+        // 次のRunを待つ（kSpinNsだけ回って待ち、来なければ起こされるまで眠る）
+        uint64_t spin_start = render_pool_clock_ns();
+        while( generation_.load( std::memory_order_acquire ) == seen ) {
+            if( render_pool_clock_ns() - spin_start < kSpinNs ) {
+                render_pool_pause();
+                continue;
+            }
+            std::unique_lock<std::mutex> lock( mutex_ );
+            sleeping_++;
+            cv_.wait( lock, [&]{ return generation_.load() != seen; } );
+            sleeping_--;
+        }
+        seen = generation_.load( std::memory_order_acquire );
+
+        if( quit_ ) {
+            return;
+        }
+
+        Work( worker );
+    }
+}
+
+/**
+ * @brief 取れるジョブが無くなるまで処理する
+ * @note  処理時間とジョブ数はジョブ毎に足し、終わったジョブを数えるのはその後にする
+ *        （Runが戻った時には全ワーカーの値が揃っている）
+ *
+ * @param[in] worker ワーカー番号
+ */
+void RenderPool::Work( int worker )
+{
+    uint64_t start = render_pool_clock_ns();
+    int      job;
+
+    while( Take( worker, &job ) ) {
+        func_( job, userdata_ );
+
+        uint64_t now = render_pool_clock_ns();
+        queue_[worker].time_ns.fetch_add( (uint32_t)(now - start), std::memory_order_relaxed );
+        queue_[worker].job_num.fetch_add( 1, std::memory_order_relaxed );
+        start = now;
+
+        remaining_.fetch_sub( 1, std::memory_order_release );
+    }
+}
+
+/**
+ * @brief 次のジョブを取り出す。自分のキューが空なら他のワーカーのキューから盗む
+ *
+ * @param[in]  worker ワーカー番号
+ * @param[out] job    ジョブ番号
+ * @retval true  取り出せた
+ * @retval false どのキューも空
+ */
+bool RenderPool::Take( int worker, int* job )
+{
+    for( int ix=0; ix<worker_num_; ix++ ) {
+        Queue&   q     = queue_[(worker + ix) % worker_num_];
+        uint64_t range = q.range.load( std::memory_order_acquire );
+        while( (uint32_t)range < (uint32_t)(range >> 32) ) {
+            if( q.range.compare_exchange_weak( range, range + 1, std::memory_order_acq_rel, std::memory_order_acquire ) ) {
+                *job = (int)(uint32_t)range;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief 回って待つ間にCPUへ知らせる（同じコアの他のスレッドと電力へ譲る）
+ */
+static inline void render_pool_pause()
+{
+#ifdef RP_USE_SSE2
+    _mm_pause();
+#else
+    std::this_thread::yield();
+#endif
+}
+
+/**
+ * @brief render_pool_clock_ns
+ */
+static uint64_t render_pool_clock_ns()
+{
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>( steady_clock::now().time_since_epoch() ).count();
+}
@@ -0,0 +1,71 @@
+/**
+ * @file render_pool.h
+ */
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @class RenderPool
+ * @brief 1ブロック分のレンダリングジョブを固定数のワーカースレッドで分担する。
+ *        ジョブはワーカー毎のキューへ均等に割り振り、自分のキューが空になったワーカーは他のキューから盗む。
+ *        Runは全ジョブが終わるのを待つだけで、ワーカーが起きてくるのは待たない（起きる前に呼び出しスレッドが全部処理してもよい）
+ */
+class RenderPool {
+public:
+    typedef void (*JobFunc)( int job, void* userdata );
+
+    static const int kMaxWorkers = 16;
+
+    RenderPool( int worker_num, int priority = 0 );  // worker_num: Runを呼ぶスレッド自身を含むワーカー数
+                                                     // priority: ワーカーのSCHED_FIFO優先度（0なら要求しない）
+    ~RenderPool();
+
+    void Run( JobFunc func, void* userdata, int job_num );
+    size_t Prefault();  // キューを物理メモリに載せる。戻り値はバイト数（ワーカーのスタックは各ワーカーが載せる）
+
+    int      GetWorkerNum() { return worker_num_; }
+    uint32_t GetWorkerTime( int worker );     // 直前のRunでジョブ処理にかかった時間[ns]
+    int      GetWorkerJobNum( int worker );   // 直前のRunで処理したジョブ数
+    int      GetSleepingNum() { return sleeping_.load(); }  // 眠って次のRunを待っているワーカー数
+
+private:
+    RenderPool(const RenderPool&);
+    RenderPool& operator=(const RenderPool&);
+
+    // ワーカー毎のジョブキュー
+    //   range: ジョブ番号の範囲[next, end)。下位32bitがnext、上位32bitがend
+    //   （前のRunのワーカーが遅れて取りに来ても、範囲の片方だけ新しい値を見ることが無いよう1語にまとめる）
+    struct alignas(64) Queue {
+        std::atomic<uint64_t> range;
+        std::atomic<uint32_t> time_ns;
+        std::atomic<int>      job_num;
+    };
+
+    int    worker_num_;
+    int    priority_;
+    Queue  queue_[kMaxWorkers];
+
+    std::thread* thread_[kMaxWorkers];
+
+    // 処理中のジョブ
+    JobFunc func_;
+    void*   userdata_;
+
+    std::atomic<uint32_t> generation_;   // Run毎に増える
+    std::atomic<int>      remaining_;    // 今回のRunで終わっていないジョブ数
+    std::atomic<int>      sleeping_;     // 待機中のワーカー数
+    std::atomic<bool>     quit_;
+
+    std::mutex              mutex_;
+    std::condition_variable cv_;
+
+    void WorkerMain( int worker );
+    void Work( int worker );
+    bool Take( int worker, int* job );
+};
@@ -0,0 +1,218 @@
+/**
+ * @file rt_thread.cpp
+ */
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define RT_USE_MXCSR
+#endif
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#endif
+
+#include "common.h"
+#include "rt_thread.h"
+
+const size_t RtThread::kStackPrefaultBytes;
+
+static const size_t kPageSize = 4096;  // プリフォルトの刻み（実際のページより小さければよい）
+
+#if defined(RT_USE_MXCSR)
+static const unsigned int kMxcsrFtzDaz = 0x8040;   // FTZ(bit15) | DAZ(bit6)
+#elif defined(__aarch64__)
+static const uint64_t     kFpcrFz      = 1ull << 24;
+#endif
+
+/**
+ * @brief constructor
+ */
+RtThread::Status::Status()
+{
+    ftz            = false;
+    sched_request  = false;
+    sched_ok       = false;
+    policy         = -1;
+    priority       = 0;
+    lock           = kLockNone;
+    prefault_bytes = 0;
+}
+
+/**
+ * @brief 設定の結果を書き出す
+ */
+void RtThread::Status::Print( FILE* fp ) const
+{
+    static const char* kLockName[] = { "no", "current pages", "current and future pages" };
+    const char* policy_name = "unknown";
+#ifndef _WIN32
+    if( policy == SCHED_FIFO )  { policy_name = "SCHED_FIFO"; }
+    if( policy == SCHED_RR )    { policy_name = "SCHED_RR"; }
+    if( policy == SCHED_OTHER ) { policy_name = "SCHED_OTHER"; }
+#endif
+
+    fprintf(fp, "RT: flush-to-zero %s\n", ftz ? "on" : "unavailable");
+    fprintf(fp, "RT: scheduling %s priority %d%s\n", policy_name, priority,
+        !sched_request ? "" : sched_ok ? " (requested)" : " (SCHED_FIFO request failed)");
+    fprintf(fp, "RT: memory lock %s, prefaulted %zu KiB\n", kLockName[lock], prefault_bytes / 1024);
+}
+
+/**
+ * @brief 呼び出したスレッドで、非正規化数を0として扱う(FTZ/DAZ)
+ * @note  減衰していくフィルターやエンベロープの尾が非正規化数になり、処理が極端に遅くなるのを防ぐ
+ *
+ * @retval true  設定した
+ * @retval false このCPUでは設定できない
+ */
+bool RtThread::EnableFlushToZero()
+{
+#if defined(RT_USE_MXCSR)
+    _mm_setcsr( _mm_getcsr() | kMxcsrFtzDaz );
+#elif defined(__aarch64__)
+    uint64_t fpcr;
+    __asm__ __volatile__( "mrs %0, fpcr" : "=r"(fpcr) );
+    __asm__ __volatile__( "msr fpcr, %0" : : "r"(fpcr | kFpcrFz) );
+#endif
+    return IsFlushToZero();
+}
+
+/**
+ * @brief 呼び出したスレッドでFTZ/DAZが有効か
+ */
+bool RtThread::IsFlushToZero()
+{
+#if defined(RT_USE_MXCSR)
+    return (_mm_getcsr() & kMxcsrFtzDaz) == kMxcsrFtzDaz;
+#elif defined(__aarch64__)
+    uint64_t fpcr;
+    __asm__ __volatile__( "mrs %0, fpcr" : "=r"(fpcr) );
+    return (fpcr & kFpcrFz) != 0;
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief 呼び出したスレッドをSCHED_FIFOにする
+ *
+ * @param[in] priority 優先度（範囲外なら最小/最大に丸める）
+ * @retval true  成功
+ * @retval false 失敗（権限が無い等。設定は変わらない）
+ */
+bool RtThread::SetFifoPriority( int priority )
+{
+#ifndef _WIN32
+    struct sched_param param;
+    param.sched_priority = MAX( sched_get_priority_min( SCHED_FIFO ), MIN( priority, sched_get_priority_max( SCHED_FIFO ) ) );
+    return pthread_setschedparam( pthread_self(), SCHED_FIFO, &param ) == 0;
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief 呼び出したスレッドのスケジューリングポリシーと優先度
+ *
+ * @param[out] policy   SCHED_xxx
+ * @param[out] priority
+ * @retval true  取得できた
+ * @retval false 取得できない
+ */
+bool RtThread::GetPriority( int* policy, int* priority )
+{
+#ifndef _WIN32
+    struct sched_param param;
+    if( pthread_getschedparam( pthread_self(), policy, &param ) != 0 ) {
+        return false;
+    }
+    *priority = param.sched_priority;
+    return true;
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief プロセスのメモリをロックし、ページアウトされないようにする
+ * @note  ロックできる量に上限がある時は、今後の確保が失敗しないよう今あるページだけをロックする
+ *
+ * @return kLockXxx
+ */
+int RtThread::LockMemory()
+{
+#ifndef _WIN32
+    struct rlimit limit;
+    if( getrlimit( RLIMIT_MEMLOCK, &limit ) == 0 && limit.rlim_cur == RLIM_INFINITY ) {
+        if( mlockall( MCL_CURRENT | MCL_FUTURE ) == 0 ) {
+            return kLockAll;
+        }
+    }
+    if( mlockall( MCL_CURRENT ) == 0 ) {
+        return kLockCurrent;
+    }
+#endif
+    return kLockNone;
+}
+
+/**
+ * @brief 範囲内の全ページを読んで、物理メモリに載せておく
+ *
+ * @param[in] ptr   先頭
+ * @param[in] bytes バイト数
+ * @return 読んだバイト数
+ */
+size_t RtThread::Prefault( const void* ptr, size_t bytes )
+{
+    const volatile uint8_t* p = (const volatile uint8_t*)ptr;
+    for( size_t ofs=0; ofs<bytes; ofs+=kPageSize ) {
+        (void)p[ofs];
+    }
+    if( bytes > 0 ) {
+        (void)p[bytes - 1];
+    }
+    return bytes;
+}
+
+/**
+ * @brief 範囲内の全ページに同じ値を書き戻して、書き込めるページとして物理メモリに載せておく
+ * @note  確保しただけのページは、読んでもゼロページが割り当たるだけで、最初の書き込みで改めてフォルトする。
+ *        値は変えないが、他のスレッドが書いている最中のメモリには使わないこと
+ *
+ * @param[in] ptr   先頭
+ * @param[in] bytes バイト数
+ * @return 書いたバイト数
+ */
+size_t RtThread::PrefaultWritable( void* ptr, size_t bytes )
+{
+    volatile uint8_t* p = (volatile uint8_t*)ptr;
+    for( size_t ofs=0; ofs<bytes; ofs+=kPageSize ) {
+        p[ofs] = p[ofs];
+    }
+    if( bytes > 0 ) {
+        p[bytes - 1] = p[bytes - 1];
+    }
+    return bytes;
+}
+
+/**
+ * @brief 呼び出したスレッドのスタックをkStackPrefaultBytes分使っておく
+ * @note  コールバックの途中で初めてスタックを伸ばした時のページフォルトを避ける
+ *
+ * @return 書いたバイト数
+ */
+size_t RtThread::PrefaultStack()
+{
+    // volatileを通して書き、最適化で消されないようにする
+    uint8_t           stack[kStackPrefaultBytes];
+    volatile uint8_t* p = stack;
+    for( size_t ofs=0; ofs<kStackPrefaultBytes; ofs+=kPageSize ) {
+        p[ofs] = 0;
+    }
+    return kStackPrefaultBytes;
+}
@@ -0,0 +1,53 @@
+/**
+ * @file rt_thread.h
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+
+/**
+ * @class RtThread
+ * @brief オーディオスレッドをリアルタイム処理向けに整える
+ * @note  FTZ/DAZとスケジューリングは呼び出したスレッドにだけ効く。
+ *        メモリのロックとプリフォルトはプロセス全体に効く
+ */
+class RtThread {
+public:
+    // メモリのロック状態
+    enum {
+        kLockNone = 0,   // ロックしていない
+        kLockCurrent,    // 今あるページだけロックした
+        kLockAll,        // 今後確保するページもロックする
+    };
+
+    /**
+     * @brief 設定の結果
+     */
+    struct Status {
+        bool   ftz;             // FTZ/DAZを設定できた
+        bool   sched_request;   // SCHED_FIFOを要求した
+        bool   sched_ok;        // 要求が通った
+        int    policy;          // 実際のスケジューリングポリシー(SCHED_xxx、不明なら-1)
+        int    priority;        // 実際の優先度
+        int    lock;            // kLockXxx
+        size_t prefault_bytes;  // プリフォルトしたバイト数
+
+        Status();
+        void Print( FILE* fp ) const;
+    };
+
+    static bool   EnableFlushToZero();
+    static bool   IsFlushToZero();
+    static bool   SetFifoPriority( int priority );
+    static bool   GetPriority( int* policy, int* priority );
+    static int    LockMemory();
+    static size_t Prefault( const void* ptr, size_t bytes );          // 読むだけ（読み出し専用のmapにも使える）
+    static size_t PrefaultWritable( void* ptr, size_t bytes );        // 書き込みまで済ませる（確保しただけのページ用）
+    static size_t PrefaultStack();
+
+    static const size_t kStackPrefaultBytes = 256 * 1024;
+
+private:
+    RtThread();
+};
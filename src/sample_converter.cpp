@@ -0,0 +1,347 @@
+/**
+ * @file sample_converter.cpp
+ */
+#include <cstdint>
+#include <cstdio>
+#include <string.h>
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SC_USE_SSE2
+#endif
+
+#include "common.h"
+#include "sample_converter.h"
+
+static const int   kChunkFrames = 256;              // 一度に変換するフレーム数（作業バッファの大きさ）
+static const float kS16Scale    = 32767.f;
+static const float kS32Scale    = 2147483647.f;     // floatでは2^31になる
+static const float kS32Max      = 2147483520.f;     // 2^31未満で最大のfloat
+static const float kS24Scale    = 8388607.f;        // S32へのディザは24bitの分解能で加える
+
+template<bool Dither> static void convert_s16( void* dst, const float* src, int num, uint32_t* rand );
+template<bool Dither> static void convert_s32( void* dst, const float* src, int num, uint32_t* rand );
+static void convert_float32( void* dst, const float* src, int num, uint32_t* rand );
+static void convert_float64( void* dst, const float* src, int num, uint32_t* rand );
+static void interleave_stereo( char* dst, const uint8_t* left, const uint8_t* right, int num, int bytes );
+
+/**
+ * @brief constructor
+ */
+SampleConverter::SampleConverter()
+{
+    rand_[0] = 0x12345678u;
+    rand_[1] = 0x9ABCDEF1u;
+    rand_[2] = 0x0F1E2D3Cu;
+    rand_[3] = 0x4B5A6978u;
+    Setup( kFloat32, false );
+}
+
+/**
+ * @brief 書き込む形式を決め、変換関数を選ぶ
+ *
+ * @param[in] format kFloat32, kFloat64, kS32, kS16
+ * @param[in] dither trueなら整数形式にTPDFディザを加える（float形式では無視する）
+ * @retval true  成功
+ * @retval false 対応していない形式（設定は変えない）
+ */
+bool SampleConverter::Setup( int format, bool dither )
+{
+    switch( format ) {
+        case kFloat32:
+            convert_ = convert_float32;
+            bytes_   = 4;
+            dither   = false;
+            break;
+        case kFloat64:
+            convert_ = convert_float64;
+            bytes_   = 8;
+            dither   = false;
+            break;
+        case kS32:
+            convert_ = dither ? convert_s32<true> : convert_s32<false>;
+            bytes_   = 4;
+            break;
+        case kS16:
+            convert_ = dither ? convert_s16<true> : convert_s16<false>;
+            bytes_   = 2;
+            break;
+        default:
+            fprintf(stderr, "SampleConverter: unsupported format %d\n", format);
+            return false;
+    }
+    format_ = format;
+    dither_ = dither;
+    return true;
+}
+
+/**
+ * @brief 1回の書き込み領域分をまとめて変換して書き込む
+ * @note  areas[ch].ptrは書いた分だけ進める。
+ *        チャンネル毎に連続していれば変換結果を直接書き、インターリーブのステレオは2チャンネル並べて書く
+ *
+ * @param[in,out] areas    書き込み先(channels個)
+ * @param[in]     buf      planarの入力(channels個、framesサンプルずつ)
+ * @param[in]     channels
+ * @param[in]     frames
+ */
+void SampleConverter::Write( struct SoundIoChannelArea* areas, const float* const* buf, int channels, int frames )
+{
+    alignas(16) uint8_t tmp[2][kChunkFrames * 8];
+
+    const bool stereo = (channels == 2 && areas[0].step == 2 * bytes_ && areas[1].step == areas[0].step &&
+                         areas[1].ptr == areas[0].ptr + bytes_);
+
+    for( int pos=0; pos<frames; pos+=kChunkFrames ) {
+        int num = MIN( kChunkFrames, frames - pos );
+
+        if( stereo ) {
+            convert_( tmp[0], buf[0] + pos, num, rand_ );
+            convert_( tmp[1], buf[1] + pos, num, rand_ );
+            interleave_stereo( areas[0].ptr, tmp[0], tmp[1], num, bytes_ );
+            areas[0].ptr += areas[0].step * num;
+            areas[1].ptr += areas[1].step * num;
+            continue;
+        }
+
+        for( int ch=0; ch<channels; ch++ ) {
+            const int step = areas[ch].step;
+            if( step == bytes_ ) {
+                convert_( areas[ch].ptr, buf[ch] + pos, num, rand_ );
+            }
+            else {
+                convert_( tmp[0], buf[ch] + pos, num, rand_ );
+                char* ptr = areas[ch].ptr;
+                for( int ix=0; ix<num; ix++ ) {
+                    memcpy( ptr + step * ix, &tmp[0][bytes_ * ix], bytes_ );
+                }
+            }
+            areas[ch].ptr += step * num;
+        }
+    }
+}
+
+/**
+ * @brief libsoundioの形式から変換する形式を求める
+ */
+int SampleConverter::FromSoundIoFormat( enum SoundIoFormat format )
+{
+    if( format == SoundIoFormatFloat32NE ) { return kFloat32; }
+    if( format == SoundIoFormatFloat64NE ) { return kFloat64; }
+    if( format == SoundIoFormatS32NE )     { return kS32; }
+    if( format == SoundIoFormatS16NE )     { return kS16; }
+    return -1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// 1チャンネル分の変換
+//   整数形式は x * scale (+ディザ) を最も近い整数へ丸め、範囲外は端の値にする
+//   ディザは一様乱数2つの和（-1～1LSBの三角分布）
+//   S32は2^31倍するとfloatの刻みが1LSBより粗くディザが消えるので、
+//   ディザ付きのときは24bitで丸めてから8bit左へずらす（実際のDACの分解能も24bit程度）
+
+#ifdef SC_USE_SSE2
+
+/**
+ * @brief 4レーン分のxorshift32
+ */
+static inline __m128i converter_xorshift( __m128i s )
+{
+    s = _mm_xor_si128( s, _mm_slli_epi32( s, 13 ) );
+    s = _mm_xor_si128( s, _mm_srli_epi32( s, 17 ) );
+    s = _mm_xor_si128( s, _mm_slli_epi32( s, 5 ) );
+    return s;
+}
+
+/**
+ * @brief TPDFディザ(-1～1)を4つ求める
+ */
+static inline __m128 converter_tpdf( __m128i* state )
+{
+    // 上位23bitを仮数部にして[1, 2)のfloatを作る
+    const __m128i exp_one = _mm_set1_epi32( 0x3F800000 );
+    __m128i r1 = converter_xorshift( *state );
+    __m128i r2 = converter_xorshift( r1 );
+    *state = r2;
+    __m128 u1 = _mm_castsi128_ps( _mm_or_si128( _mm_srli_epi32( r1, 9 ), exp_one ) );
+    __m128 u2 = _mm_castsi128_ps( _mm_or_si128( _mm_srli_epi32( r2, 9 ), exp_one ) );
+    return _mm_sub_ps( u1, u2 );
+}
+
+/**
+ * @brief 4サンプルを整数へ変換する（飽和、ディザ付き）
+ */
+template<bool Dither>
+static inline __m128i converter_to_int( __m128 x, __m128 scale, __m128 lo, __m128 hi, __m128i* state )
+{
+    x = _mm_mul_ps( x, scale );
+    if( Dither ) {
+        x = _mm_add_ps( x, converter_tpdf( state ) );
+    }
+    x = _mm_min_ps( _mm_max_ps( x, lo ), hi );
+    return _mm_cvtps_epi32( x );
+}
+
+template<bool Dither>
+static void convert_s16( void* dst, const float* src, int num, uint32_t* rand )
+{
+    const __m128 scale = _mm_set1_ps( kS16Scale );
+    const __m128 lo    = _mm_set1_ps( -32768.f );
+    const __m128 hi    = _mm_set1_ps( 32767.f );
+    __m128i state = _mm_loadu_si128( (const __m128i*)rand );
+    int16_t* out  = (int16_t*)dst;
+
+    int ix = 0;
+    for( ; ix+8<=num; ix+=8 ) {
+        __m128i a = converter_to_int<Dither>( _mm_loadu_ps( &src[ix] ),     scale, lo, hi, &state );
+        __m128i b = converter_to_int<Dither>( _mm_loadu_ps( &src[ix + 4] ), scale, lo, hi, &state );
+        _mm_storeu_si128( (__m128i*)&out[ix], _mm_packs_epi32( a, b ) );
+    }
+    for( ; ix<num; ix+=4 ) {
+        // 端数は4個に詰め直して同じ処理をする
+        alignas(16) float   pad[4] = { 0.f, 0.f, 0.f, 0.f };
+        alignas(16) int16_t res[8];
+        int rest = MIN( 4, num - ix );
+        memcpy( pad, &src[ix], sizeof(float) * rest );
+        __m128i a = converter_to_int<Dither>( _mm_load_ps( pad ), scale, lo, hi, &state );
+        _mm_store_si128( (__m128i*)res, _mm_packs_epi32( a, a ) );
+        memcpy( &out[ix], res, sizeof(int16_t) * rest );
+    }
+
+    _mm_storeu_si128( (__m128i*)rand, state );
+}
+
+template<bool Dither>
+static void convert_s32( void* dst, const float* src, int num, uint32_t* rand )
+{
+    const __m128 scale = _mm_set1_ps( Dither ? kS24Scale : kS32Scale );
+    const __m128 lo    = _mm_set1_ps( Dither ? -8388608.f : -2147483648.f );
+    const __m128 hi    = _mm_set1_ps( Dither ? 8388607.f : kS32Max );
+    const int    shift = Dither ? 8 : 0;
+    __m128i state = _mm_loadu_si128( (const __m128i*)rand );
+    int32_t* out  = (int32_t*)dst;
+
+    int ix = 0;
+    for( ; ix+4<=num; ix+=4 ) {
+        __m128i a = converter_to_int<Dither>( _mm_loadu_ps( &src[ix] ), scale, lo, hi, &state );
+        _mm_storeu_si128( (__m128i*)&out[ix], _mm_slli_epi32( a, shift ) );
+    }
+    if( ix < num ) {
+        alignas(16) float   pad[4] = { 0.f, 0.f, 0.f, 0.f };
+        alignas(16) int32_t res[4];
+        int rest = num - ix;
+        memcpy( pad, &src[ix], sizeof(float) * rest );
+        __m128i a = converter_to_int<Dither>( _mm_load_ps( pad ), scale, lo, hi, &state );
+        _mm_store_si128( (__m128i*)res, _mm_slli_epi32( a, shift ) );
+        memcpy( &out[ix], res, sizeof(int32_t) * rest );
+    }
+
+    _mm_storeu_si128( (__m128i*)rand, state );
+}
+
+static void convert_float64( void* dst, const float* src, int num, uint32_t* /*rand*/ )
+{
+    double* out = (double*)dst;
+
+    int ix = 0;
+    for( ; ix+4<=num; ix+=4 ) {
+        __m128 x = _mm_loadu_ps( &src[ix] );
+        _mm_storeu_pd( &out[ix],     _mm_cvtps_pd( x ) );
+        _mm_storeu_pd( &out[ix + 2], _mm_cvtps_pd( _mm_movehl_ps( x, x ) ) );
+    }
+    for( ; ix<num; ix++ ) {
+        out[ix] = src[ix];
+    }
+}
+
+/**
+ * @brief 2チャンネル分の変換結果を交互に並べて書く
+ */
+static void interleave_stereo( char* dst, const uint8_t* left, const uint8_t* right, int num, int bytes )
+{
+    // 16byteずつ読み、unpackで交互に並べる
+    const int per_vec = 16 / bytes;
+    int ix = 0;
+    for( ; ix+per_vec<=num; ix+=per_vec ) {
+        __m128i l = _mm_loadu_si128( (const __m128i*)&left[ix * bytes] );
+        __m128i r = _mm_loadu_si128( (const __m128i*)&right[ix * bytes] );
+        __m128i a, b;
+        if( bytes == 2 )      { a = _mm_unpacklo_epi16( l, r ); b = _mm_unpackhi_epi16( l, r ); }
+        else if( bytes == 4 ) { a = _mm_unpacklo_epi32( l, r ); b = _mm_unpackhi_epi32( l, r ); }
+        else                  { a = _mm_unpacklo_epi64( l, r ); b = _mm_unpackhi_epi64( l, r ); }
+        _mm_storeu_si128( (__m128i*)&dst[ix * bytes * 2],      a );
+        _mm_storeu_si128( (__m128i*)&dst[ix * bytes * 2 + 16], b );
+    }
+    for( ; ix<num; ix++ ) {
+        memcpy( &dst[ix * bytes * 2],         &left[ix * bytes],  bytes );
+        memcpy( &dst[ix * bytes * 2 + bytes], &right[ix * bytes], bytes );
+    }
+}
+
+#else
+
+/**
+ * @brief TPDFディザ(-1～1)
+ */
+static inline float converter_tpdf( uint32_t* state )
+{
+    uint32_t s = *state;
+    s ^= s << 13; s ^= s >> 17; s ^= s << 5;
+    uint32_t r1 = s;
+    s ^= s << 13; s ^= s >> 17; s ^= s << 5;
+    *state = s;
+    return (float)(r1 >> 9) * (1.f / 8388608.f) - (float)(s >> 9) * (1.f / 8388608.f);
+}
+
+template<bool Dither>
+static void convert_s16( void* dst, const float* src, int num, uint32_t* rand )
+{
+    int16_t* out = (int16_t*)dst;
+    for( int ix=0; ix<num; ix++ ) {
+        float x = src[ix] * kS16Scale + (Dither ? converter_tpdf( rand ) : 0.f);
+        x = MAX( -32768.f, MIN( 32767.f, x ) );
+        out[ix] = (int16_t)lrintf( x );
+    }
+}
+
+template<bool Dither>
+static void convert_s32( void* dst, const float* src, int num, uint32_t* rand )
+{
+    int32_t* out = (int32_t*)dst;
+    for( int ix=0; ix<num; ix++ ) {
+        if( Dither ) {
+            float x = src[ix] * kS24Scale + converter_tpdf( rand );
+            x = MAX( -8388608.f, MIN( 8388607.f, x ) );
+            out[ix] = (int32_t)((uint32_t)lrintf( x ) << 8);
+        }
+        else {
+            float x = src[ix] * kS32Scale;
+            x = MAX( -2147483648.f, MIN( kS32Max, x ) );
+            out[ix] = (int32_t)lrintf( x );
+        }
+    }
+}
+
+static void convert_float64( void* dst, const float* src, int num, uint32_t* /*rand*/ )
+{
+    double* out = (double*)dst;
+    for( int ix=0; ix<num; ix++ ) {
+        out[ix] = src[ix];
+    }
+}
+
+static void interleave_stereo( char* dst, const uint8_t* left, const uint8_t* right, int num, int bytes )
+{
+    for( int ix=0; ix<num; ix++ ) {
+        memcpy( &dst[ix * bytes * 2],         &left[ix * bytes],  bytes );
+        memcpy( &dst[ix * bytes * 2 + bytes], &right[ix * bytes], bytes );
+    }
+}
+
+#endif
+
+static void convert_float32( void* dst, const float* src, int num, uint32_t* /*rand*/ )
+{
+    memcpy( dst, src, sizeof(float) * num );
+}
@@ -0,0 +1,49 @@
+/**
+ * @file sample_converter.h
+ */
+#pragma once
+
+#include <cstdint>
+
+#include <soundio/soundio.h>
+
+/**
+ * @class SampleConverter
+ * @brief planarのfloatバッファを、デバイスの形式でSoundIoChannelAreaへまとめて書き込む
+ * @note  変換関数は形式を決めた時(Setup)に1回だけ選ぶ。
+ *        整数形式は範囲外の値を飽和させ、指定があればTPDF(±1LSBの三角分布)ディザを加える
+ */
+class SampleConverter {
+public:
+    enum {
+        kFloat32 = 0,
+        kFloat64,
+        kS32,
+        kS16
+    };
+
+    SampleConverter();
+    ~SampleConverter(){}
+
+    bool Setup( int format, bool dither );
+    void Write( struct SoundIoChannelArea* areas, const float* const* buf, int channels, int frames );
+
+    int  GetFormat()    { return format_; }
+    int  GetBytes()     { return bytes_; }   // 1サンプルのバイト数
+    bool IsDithering()  { return dither_; }
+
+    static int FromSoundIoFormat( enum SoundIoFormat format );  // 対応していなければ-1
+
+private:
+    SampleConverter(const SampleConverter&);
+    SampleConverter& operator=(const SampleConverter&);
+
+    // 1チャンネル分(num個)を変換してdstへ詰めて書く
+    typedef void (*ConvertFunc)( void* dst, const float* src, int num, uint32_t* rand );
+
+    int         format_;
+    int         bytes_;
+    bool        dither_;
+    ConvertFunc convert_;
+    uint32_t    rand_[4];  // ディザ用の乱数の状態（SIMDのレーン毎）
+};
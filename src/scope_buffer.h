@@ -0,0 +1,121 @@
+/**
+ * @file scope_buffer.h
+ */
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/**
+ * @class ScopeBuffer
+ * @brief 波形表示用のリングバッファ(1書き手/1読み手)
+ *        書き手(オーディオスレッド)はブロック単位でまとめて書き込み、
+ *        読み手(UIスレッド)は直近のnum個をロックせずに取り出す。
+ * @note  読み出し中に書き手が追い越した場合はやり直す（シーケンスロック方式）。
+ *        書き手は待たされない
+ *
+ * @tparam T 要素の型（memcpyでコピーできること）
+ * @tparam N 容量（2のべき乗）。読み出す数より十分大きくしておくと追い越されにくい
+ */
+template<typename T, size_t N>
+class ScopeBuffer {
+    static_assert( N > 0 && (N & (N-1)) == 0, "ScopeBuffer: N must be a power of two" );
+    static_assert( std::is_trivially_copyable<T>::value, "ScopeBuffer: T must be trivially copyable" );
+
+public:
+    static const size_t kCapacity = N;
+    static const int    kRetryNum = 4;  // Snapshotが諦めるまでのやり直し回数
+
+    ScopeBuffer() : begin_( 0 ), written_( 0 )
+    {
+        memset( buf_, 0, sizeof(buf_) );
+    }
+
+    /**
+     * @brief まとめて書き込む（書き手専用）
+     * @note  numが容量を超える場合は末尾の容量分だけ残す
+     *
+     * @param[in] data 書き込むデータ
+     * @param[in] num  データ数
+     */
+    void Write( const T* data, size_t num )
+    {
+        uint64_t pos = written_.load( std::memory_order_relaxed );
+        if( num > N ) {
+            data += num - N;
+            pos  += num - N;
+            num   = N;
+        }
+
+        // これから上書きする範囲を先に知らせる
+        begin_.store( pos + num, std::memory_order_relaxed );
+        std::atomic_thread_fence( std::memory_order_release );
+
+        size_t ofs   = (size_t)pos & (N - 1);
+        size_t first = (num < N - ofs) ? num : N - ofs;
+        memcpy( &buf_[ofs], data, first * sizeof(T) );
+        memcpy( &buf_[0], data + first, (num - first) * sizeof(T) );
+
+        written_.store( pos + num, std::memory_order_release );
+    }
+
+    /**
+     * @brief 直近のnum個を古い順に取り出す（読み手専用）
+     * @note  まだnum個書かれていなければ先頭を0で埋める
+     *
+     * @param[out] out 格納先(num個)
+     * @param[in]  num 取り出す数(N以下)
+     * @retval true  取り出せた
+     * @retval false 書き手に追い越され続けた（outの内容は不定）
+     */
+    bool Snapshot( T* out, size_t num ) const
+    {
+        if( num > N ) {
+            return false;
+        }
+
+        for( int retry=0; retry<kRetryNum; retry++ ) {
+            uint64_t end   = written_.load( std::memory_order_acquire );
+            size_t   valid = (end < num) ? (size_t)end : num;
+            uint64_t start = end - valid;
+
+            memset( out, 0, (num - valid) * sizeof(T) );
+            T* dst = out + (num - valid);
+
+            size_t ofs   = (size_t)start & (N - 1);
+            size_t first = (valid < N - ofs) ? valid : N - ofs;
+            memcpy( dst, &buf_[ofs], first * sizeof(T) );
+            memcpy( dst + first, &buf_[0], (valid - first) * sizeof(T) );
+
+            // コピー中に読んだ範囲[start, end)が上書きされ始めていなければ成功
+            std::atomic_thread_fence( std::memory_order_acquire );
+            if( begin_.load( std::memory_order_relaxed ) <= start + N ) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief これまでに書き込まれた総数
+     */
+    uint64_t GetWritten() const
+    {
+        return written_.load( std::memory_order_acquire );
+    }
+
+private:
+    ScopeBuffer(const ScopeBuffer&);
+    ScopeBuffer& operator=(const ScopeBuffer&);
+
+    // 書き手が更新する位置（読み手は読むだけ）。データとは別のキャッシュラインに置く
+    alignas(64) std::atomic<uint64_t> begin_;    // 書き込み中の範囲の終端
+    std::atomic<uint64_t>             written_;  // 書き込み済みの総数
+    alignas(64) T buf_[N];
+};
+
+template<typename T, size_t N> const size_t ScopeBuffer<T, N>::kCapacity;
+template<typename T, size_t N> const int    ScopeBuffer<T, N>::kRetryNum;
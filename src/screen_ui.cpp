@@ -3,7 +3,9 @@
  */
 #include <thread>
 #include <chrono>
+#include <string>
 #include <stdio.h>
+#include <string.h>
 
 #include <fmt/format.h>
 
@@ -14,8 +16,6 @@
 #define NANOVG_GLES3_IMPLEMENTATION
 #include "nanovg_gl.h"
 
-#include "fifo.h"
-
 #include "synth.h"
 
 #include "screen_ui.h"
@@ -66,7 +66,6 @@ ScreenUI* ScreenUI::GetInstance()
 bool ScreenUI::Initialize()
 {
     frame_count_ = 0;
-    waveform_ = new FIFO( kSampleNum, sizeof(float) );
 
     ////////////////////////////////////////////////////////////////
     // GLFW initialize
@@ -126,7 +125,11 @@ void ScreenUI::Start()
     while (!glfwWindowShouldClose(glfw_window_)) {
         info_pos_y = 15.f;
 
-        WaveformGet(wavedata_, kSampleNum);
+        // 書き込みに追い越されたら前回の波形を描く
+        float snapshot[kSampleNum];
+        if( WaveformGet( snapshot, kSampleNum ) ) {
+            memcpy( wavedata_, snapshot, sizeof(wavedata_) );
+        }
 
         glClearColor(0.1f, 0.1f, 0.2f, 0.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -200,7 +203,9 @@ void ScreenUI::DrawProcTime()
     static uint32_t max_time = 0;
     static uint32_t max_time_hold_count = 0;  // max time hold time(count);
     static uint32_t min_time = 0;
-    float w = (float)kWidth / 20833.3333f;
+    static uint32_t p99_time = 0;
+    static uint32_t p999_time = 0;
+    float w = (float)kWidth / (float)synth->GetProcBudget();  // 画面幅 = コールバック1回の予算
 
     if( frame_count_ % 5 == 0 ) {
         now_time = synth->GetProcTime();
@@ -219,6 +224,10 @@ void ScreenUI::DrawProcTime()
         if( (min_time > now_time) || (min_time == 0) ) {
             min_time = now_time;
         }
+
+        LatencyHistogram& hist = synth->GetProcHistogram();
+        p99_time  = hist.GetPercentile( 99.0 );
+        p999_time = hist.GetPercentile( 99.9 );
     }
 
     // text
@@ -226,7 +235,10 @@ void ScreenUI::DrawProcTime()
     nvgFontFace(vg_, "sans-bold");
     nvgTextAlign(vg_, NVG_ALIGN_LEFT | NVG_ALIGN_MIDDLE);
     nvgFillColor(vg_, nvgRGBA(255,255,255,200));
-    nvgText(vg_, 10, info_pos_y, fmt::format("SigProcTime: {}", now_time).c_str(), NULL);
+    nvgText(vg_, 10, info_pos_y, fmt::format("SigProcTime(us): {:.1f} p99 {:.1f} p99.9 {:.1f} max {:.1f} miss {}",
+        now_time / 1000.0f, p99_time / 1000.0f, p999_time / 1000.0f,
+        synth->GetProcHistogram().GetMax() / 1000.0f,
+        synth->GetProcHistogram().GetDeadlineMiss()).c_str(), NULL);
 
     //max
     nvgBeginPath(vg_);
@@ -254,26 +266,46 @@ void ScreenUI::DrawProcTime()
 
 
     info_pos_y += 35;
+
+    nvgText(vg_, 10, info_pos_y, fmt::format("Voices: {}", synth->GetActiveVoiceNum()).c_str(), NULL);
+    info_pos_y += 15;
+
+    // worker
+    int thread_num = synth->GetRenderThreadNum();
+    if( thread_num > 1 ) {
+        std::string text = "Worker(us):";
+        for( int ix=0; ix<thread_num; ix++ ) {
+            text += fmt::format(" {}", synth->GetRenderWorkerTime( ix ) / 1000);
+        }
+        nvgText(vg_, 10, info_pos_y, text.c_str(), NULL);
+        info_pos_y += 15;
+    }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
 /**
- * @brief WaveformPut
+ * @brief 波形を1ブロック分まとめて追加する（オーディオスレッドから呼ぶ）
+ *
+ * @param[in] data 波形データ
+ * @param[in] num  データ数
  */
-void ScreenUI::WaveformPut( float wavedata_ )
+void ScreenUI::WaveformPut( const float* data, int num )
 {
-    waveform_->Put( &wavedata_ );
+    waveform_.Write( data, num );
 }
 
 /**
- * @brief WaveformGet
+ * @brief 直近の波形を古い順に取り出す（UIスレッドから呼ぶ）
+ *
+ * @param[out] buf 格納先
+ * @param[in]  num 取り出す数
+ * @retval true  取り出せた
+ * @retval false 書き込みに追い越された
  */
-void ScreenUI::WaveformGet( float* buf, int num )
+bool ScreenUI::WaveformGet( float* buf, int num )
 {
-    waveform_->SnoopFromTail(buf, num);
-    //memcpy( buf, waveform_->buffer_, sizeof(float) * num );
-    return;
+    return waveform_.Snapshot( buf, num );
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -3,7 +3,7 @@
  */
 #pragma once
 
-#include "fifo.h"
+#include "scope_buffer.h"
 #include "keyctrl.h"
 
 struct GLFWwindow;
@@ -26,8 +26,8 @@ public:
 
     void Start();
 
-    void WaveformPut( float data );
-    void WaveformGet( float* buf, int num );
+    void WaveformPut( const float* data, int num );
+    bool WaveformGet( float* buf, int num );
 
 private:
     ScreenUI(){}
@@ -43,8 +43,9 @@ private:
     static const int kWidth  = 480;
     static const int kHeight = 320;
     static const int kSampleNum = 256;
+    static const int kScopeNum  = kSampleNum * 4;  // 描画中に追い越されないよう余裕を持たせる
 
-    FIFO* waveform_;
+    ScopeBuffer<float, kScopeNum> waveform_;
     float wavedata_[kSampleNum];
 
     float    now_fps_;
@@ -2,10 +2,10 @@
  * @file synth.cpp
  */
 #include <iostream>
-#include <list>
-#include <chrono>  // for high_resolution_clock
+#include <chrono>  // for steady_clock
 
 #include <math.h>
+#include <string.h>
 
 #include "common.h"
 #include "waveform.h"
@@ -15,10 +15,11 @@
 #include "synth.h"
 #include "voice.h"
 
-#include "screen_ui.h"
 
-
-static double synth_signal_callback( void* userdata );
+static void synth_render_callback( float* const* out, int frames, int channels, void* userdata );
+static void voicectrl_render_job( int job, void* userdata );
+static int  voicectrl_bit_index( uint64_t bits );
+static int  voicectrl_bit_count( uint64_t bits );
 
 Synth* Synth::instance_ = nullptr;
 
@@ -27,23 +28,34 @@ Synth* Synth::instance_ = nullptr;
  * @brief Create
  */
 Synth* Synth::Create( float tuning )
+{
+    AudioCtrl* audioctrl = AudioCtrl::GetInstance();
+    return Create( tuning, audioctrl->SampleRateGet() );
+}
+
+/**
+ * @brief Create
+ * @note  AudioCtrlが無ければ、RenderBlockを直接呼んでレンダリングする
+ */
+Synth* Synth::Create( float tuning, float fs )
 {
     if (!instance_)
     {
         instance_ = new Synth();
-        instance_->Initialize( tuning );
+        instance_->Initialize( tuning, fs );
     }
     return instance_;
 }
 
-
 /**
  * @brief Destroy
  */
 void Synth::Destroy()
 {
     AudioCtrl* audioctrl = AudioCtrl::GetInstance();
-    audioctrl->SignalCallbackUnset();
+    if( audioctrl ) {
+        audioctrl->RenderCallbackUnset();
+    }
 
     delete instance_->voicectrl_;
 
@@ -62,18 +74,31 @@ Synth* Synth::GetInstance()
 /**
  * @brief initialize class
  */
-void Synth::Initialize( float tuning )
+void Synth::Initialize( float tuning, float fs )
 {
     audioctrl_ = AudioCtrl::GetInstance();
+    fs_        = fs;
+
+    sigproc_time_   = 0;
+    sigproc_budget_ = (uint32_t)(AudioCtrl::kMaxBlockFrames * 1.0e9 / fs_);
+    proc_hist_.Reset();
+    for( int ix=0; ix<=VoiceBank::kLaneNum; ix++ ) {
+        proc_ns_by_voices_[ix]  = 0;
+        proc_num_by_voices_[ix] = 0;
+    }
+    monitor_func_     = nullptr;
+    monitor_userdata_ = nullptr;
 
     // create waveform
-    Waveform* wf = Waveform::Create( tuning, audioctrl_->SampleRateGet() );
+    Waveform* wf = Waveform::Create( tuning, fs_ );
 
     // create Voice controller
     voicectrl_ = new VoiceCtrl();
 
     // set audio callback
-    audioctrl_->SignalCallbackSet( synth_signal_callback, this );
+    if( audioctrl_ ) {
+        audioctrl_->RenderCallbackSet( synth_render_callback, this );
+    }
 }
 
 /**
@@ -81,50 +106,173 @@ void Synth::Initialize( float tuning )
  */
 void Synth::Start()
 {
-    audioctrl_->Start();
+    // 確保済みのメモリをロックし、コールバックで触るものを物理メモリに載せておく
+    RtThread::Status status;
+    status.lock            = RtThread::LockMemory();
+    status.prefault_bytes += RtThread::Prefault( Waveform::GetInstance(), sizeof(Waveform) );
+    status.prefault_bytes += RtThread::Prefault( Waveform::GetInstance()->GetWTBase(), Waveform::GetInstance()->GetWTBytes() );
+    status.prefault_bytes += voicectrl_->Prefault();
+    status.prefault_bytes += RtThread::Prefault( this, sizeof(Synth) );
+
+    if( audioctrl_ ) {
+        audioctrl_->Start();
+
+        // FTZ/DAZ・優先度・スタックはオーディオスレッド自身が設定する
+        RtThread::Status audio;
+        if( audioctrl_->RtStatusGet( &audio, 1000 ) ) {
+            audio.lock            = status.lock;
+            audio.prefault_bytes += status.prefault_bytes;
+            status = audio;
+        }
+    }
+
+    rt_status_ = status;
+    rt_status_.Print( stderr );
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
-inline unsigned long long rdtsc() {
-    unsigned long long ret;
-    __asm__ volatile ("rdtsc" : "=A" (ret));
-    return ret;
+/**
+ * @brief synth_clock_ns
+ */
+static inline uint64_t synth_clock_ns()
+{
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>( steady_clock::now().time_since_epoch() ).count();
 }
 
 /**
- * @brief Signal callback
+ * @brief Render block
+ * @note  VoiceBank::kMaxChannelsを超えるチャンネルは無音にする
+ *
+ * @param[out] out      planar output (channels個の、framesサンプルずつのバッファ)
+ * @param[in]  frames   number of frames
+ * @param[in]  channels number of channels
  */
-float Synth::SignalCallback()
+void Synth::RenderBlock( float* const* out, int frames, int channels )
 {
-    unsigned long long start = rdtsc();
+    uint64_t start = synth_clock_ns();
+    uint32_t budget = (uint32_t)(frames * 1.0e9 / fs_);  // このコールバックで許される処理時間
 
-    MidiCtrl* midictrl = MidiCtrl::GetInstance();
+    MidiCtrl*   midictrl = MidiCtrl::GetInstance();
+    MonitorFunc monitor  = monitor_func_;
+
+    const int mix_channels = MIN( channels, VoiceBank::kMaxChannels );
+    float*    ptr[VoiceBank::kMaxChannels];
+
+    // 前回のコールバック以降に届いたMIDIイベントを取り出し、このコールバック全体の中での位置を決める
+    midictrl->BeginBlock( frames, fs_ );
+
+    for( int done=0; done<frames; ) {
+        int block = MIN( frames - done, AudioCtrl::kMaxBlockFrames );
+
+        // イベントの発生位置でブロックを区切りながらレンダリングする（posはコールバック先頭からの位置）
+        int pos = done;
+        while( pos < done + block ) {
+            while( midictrl->NextEventOffset() <= pos ) {
+                midictrl->DispatchEvent();
+            }
 
-    if( midictrl->IsStatusChanged() ) {
-        voicectrl_->Trigger();            // トリガー/リリース処理
-        midictrl->ResetStatusChange();  // 鍵盤状態変更フラグを落とす
+            if( midictrl->IsStatusChanged() ) {
+                voicectrl_->Trigger();            // トリガー/リリース処理
+                midictrl->ResetStatusChange();  // 鍵盤状態変更フラグを落とす
+            }
+
+            // 各ボイスの信号処理を行いMIXする（ボイスコントローラーの仕事）。
+            int next = MIN( done + block, midictrl->NextEventOffset() );
+            for( int ch=0; ch<mix_channels; ch++ ) {
+                ptr[ch] = out[ch] + pos;
+            }
+            voicectrl_->RenderBlock( ptr, mix_channels, next - pos );
+            pos = next;
+        }
+
+        for( int ch=mix_channels; ch<channels; ch++ ) {
+            memset( out[ch] + done, 0, sizeof(float) * block );
+        }
+
+        if( monitor ) {
+            monitor( out[0] + done, block, monitor_userdata_ );
+        }
+
+        done += block;
     }
 
-    // 各ボイスの信号処理を行いステレオMIXする（ボイスコントローラーの仕事）。
-    float val = voicectrl_->SignalProcess();
+    uint32_t elapsed = (uint32_t)MIN( synth_clock_ns() - start, (uint64_t)UINT32_MAX );
+    sigproc_time_   = elapsed;
+    sigproc_budget_ = budget;
+    proc_hist_.Record( elapsed, budget );
 
-    ScreenUI* screen_ui = ScreenUI::GetInstance();
-    screen_ui->WaveformPut(val);
+    int voices = voicectrl_->GetActiveVoiceNum();
+    proc_ns_by_voices_[voices].store( proc_ns_by_voices_[voices].load( std::memory_order_relaxed ) + elapsed, std::memory_order_relaxed );
+    proc_num_by_voices_[voices].store( proc_num_by_voices_[voices].load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+}
 
-    unsigned long long stop = rdtsc();
-    sigproc_time_ = stop - start;
+/**
+ * @brief 出力を監視する関数を設定する
+ *
+ * @param[in] func     RenderBlockからブロック毎に呼ぶ（オーディオスレッドで呼ばれる）
+ * @param[in] userdata funcへ渡す
+ */
+void Synth::MonitorSet( MonitorFunc func, void* userdata )
+{
+    monitor_userdata_ = userdata;
+    monitor_func_     = func;
+}
 
-    return val;
+/**
+ * @brief MonitorUnset
+ */
+void Synth::MonitorUnset()
+{
+    monitor_func_     = nullptr;
+    monitor_userdata_ = nullptr;
 }
 
 /**
- * @brief Signal callback handler
+ * @brief コールバック処理時間の統計を書き出す
+ *
+ * @param[in] path 出力先ファイル（"-"なら標準エラー）
+ * @retval true  成功
+ * @retval false 失敗
  */
-static double synth_signal_callback( void* userdata )
+bool Synth::DumpProcStats( const char* path )
+{
+    FILE* fp = (strcmp( path, "-" ) == 0) ? stderr : fopen( path, "w" );
+    if( !fp ) {
+        fprintf(stderr, "Synth: can't open %s\n", path);
+        return false;
+    }
+
+    rt_status_.Print( fp );
+    if( audioctrl_ ) {
+        audioctrl_->DumpUnderflows( fp );
+    }
+    fprintf(fp, "budget of the last callback: %uns\n", sigproc_budget_);
+    proc_hist_.Dump( fp );
+
+    fprintf(fp, "callback time by active voices:\n");
+    for( int ix=0; ix<=VoiceBank::kLaneNum; ix++ ) {
+        uint32_t num = proc_num_by_voices_[ix].load( std::memory_order_relaxed );
+        if( num != 0 ) {
+            fprintf(fp, "  %2d voices : count=%u mean=%lluns\n", ix, num,
+                (unsigned long long)(proc_ns_by_voices_[ix].load( std::memory_order_relaxed ) / num));
+        }
+    }
+
+    if( fp != stderr ) {
+        fclose( fp );
+    }
+    return true;
+}
+
+/**
+ * @brief Render callback handler
+ */
+static void synth_render_callback( float* const* out, int frames, int channels, void* userdata )
 {
     Synth* synth = (Synth*)userdata;
-    return synth->SignalCallback();
+    synth->RenderBlock( out, frames, channels );
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -135,13 +283,198 @@ static double synth_signal_callback( void* userdata )
 VoiceCtrl::VoiceCtrl()
 {
     key_mode_         = kPoly;
-    current_voice_no_ = 0;
+    current_slot_     = 0;
     unison_num_       = 1;
     poly_num_         = 16;  // 16 voices
+    control_frames_   = 32;
     for(int ix=0; ix<kVoiceNum; ix++) {
         voice_[ix] = new Voice();
         voice_[ix]->SetNo(ix);
+        voice_[ix]->SetModMatrix( &mod_matrix_ );
+    }
+    bank_ = new VoiceBank( Waveform::GetInstance()->GetWTBase(), Waveform::GetInstance()->GetSamplerate() );
+    pool_ = nullptr;
+
+    active_mask_ = 0;
+    active_num_  = 0;
+
+    steal_mode_        = kStealReleasedFirst;
+    same_note_reuse_   = false;
+    steal_fade_frames_ = (int)(Waveform::GetInstance()->GetSamplerate() * kStealFadeMs / 1000.f);
+    age_count_         = 0;
+    for( int ix=0; ix<kVoiceNum; ix++ ) {
+        voice_age_[ix] = 0;
+    }
+    LayoutSlots();
+}
+
+/**
+ * @brief VoiceCtrl destructor
+ */
+VoiceCtrl::~VoiceCtrl()
+{
+    delete pool_;
+    delete bank_;
+    for(int ix=0; ix<kVoiceNum; ix++) {
+        delete voice_[ix];
+    }
+}
+
+/**
+ * @brief 音色の設定
+ * @note  発音中に呼ばないこと
+ *
+ * @param[in] patch
+ */
+void VoiceCtrl::SetPatch( const Patch& patch )
+{
+    key_mode_   = patch.key_mode;
+    unison_num_ = MAX( 1, MIN( patch.unison_num, Voice::kMaxUnison ) );
+    LayoutSlots();
+    poly_num_   = MAX( 1, MIN( patch.poly_num, slot_num_ ) );
+    steal_mode_      = patch.steal_mode;
+    same_note_reuse_ = patch.same_note_reuse;
+    control_frames_  = MAX( 1, MIN( patch.control_frames, VoiceBank::kMaxFrames ) );
+    mod_matrix_      = patch.mod_matrix;
+    // カットオフはノートNo単位で持つ
+    float cutoff_nn  = 69.f + 12.f * log2f( MAX( patch.cutoff_hz, 1.f ) / 440.f );
+    float resonance  = MAX( patch.resonance, 0.1f );
+
+    for( int ix=0; ix<kVoiceNum; ix++ ) {
+        voice_[ix]->SetEnvelope( patch.attack_ms, patch.decay_ms, patch.sustain_lv, patch.release_ms );
+        voice_[ix]->SetEnvelopeCurve( (Envelope::Curve)patch.env_curve );
+        voice_[ix]->SetFilter( cutoff_nn, resonance, patch.fenv_amount );
+        voice_[ix]->SetFilterEnvelope( patch.fenv_attack_ms, patch.fenv_decay_ms, patch.fenv_sustain_lv, patch.fenv_release_ms );
+        voice_[ix]->SetEnvelope2( patch.env2_attack_ms, patch.env2_decay_ms, patch.env2_sustain_lv, patch.env2_release_ms );
+        for( int no=0; no<Voice::kLfoNum; no++ ) {
+            voice_[ix]->SetLfo( no, patch.lfo_rate_hz[no], (Lfo::Shape)patch.lfo_shape[no], patch.lfo_key_sync[no] );
+        }
+        voice_[ix]->SetUnison( unison_num_, patch.unison_detune_cent, patch.unison_spread, patch.unison_random_phase );
+    }
+}
+
+/**
+ * @brief ユニゾン数に合わせてスロット（1ノート分の連続したレーン）を並べる
+ * @note  スロットがレーン幅に収まるならグループ内に詰めて並べ（余ったレーンは使わない）、
+ *        収まらなければ複数のグループをまとめて1つのスロットにする
+ */
+void VoiceCtrl::LayoutSlots()
+{
+    const int width = VoiceBank::LaneWidth();
+
+    slot_num_    = 0;
+    master_mask_ = 0;
+    if( unison_num_ <= width ) {
+        int per_group = width / unison_num_;
+        for( int group=0; group<VoiceBank::GroupNum(); group++ ) {
+            for( int ix=0; ix<per_group; ix++ ) {
+                slot_lane_[slot_num_++] = group * width + ix * unison_num_;
+            }
+        }
+        job_span_ = 1;
+    }
+    else {
+        job_span_ = (unison_num_ + width - 1) / width;
+        for( int group=0; group+job_span_<=VoiceBank::GroupNum(); group+=job_span_ ) {
+            slot_lane_[slot_num_++] = group * width;
+        }
+    }
+
+    for( int slot=0; slot<slot_num_; slot++ ) {
+        master_mask_ |= (1ull << slot_lane_[slot]);
+    }
+    current_slot_ = 0;
+}
+
+/**
+ * @brief スロットの先頭のボイスが鳴らすレーン
+ */
+uint64_t VoiceCtrl::StackMask( int lane )
+{
+    return ((1ull << unison_num_) - 1) << lane;
+}
+
+/**
+ * @brief 1ジョブで処理するレーン
+ *
+ * @param[in] first_group ジョブの先頭のグループ番号
+ */
+uint64_t VoiceCtrl::JobLaneMask( int first_group )
+{
+    const int lane_num = job_span_ * VoiceBank::LaneWidth();
+    return (lane_num >= 64) ? ~0ull : (((1ull << lane_num) - 1) << (first_group * VoiceBank::LaneWidth()));
+}
+
+/**
+ * @brief 発音処理に使うスレッド数を設定する
+ * @note  レンダリング中に呼ばないこと
+ *
+ * @param[in] num スレッド数（レンダリングを呼ぶスレッドを含む）。1以下ならシングルスレッド
+ */
+void VoiceCtrl::SetRenderThreadNum( int num )
+{
+    // ワーカーはオーディオスレッドのすぐ下の優先度にする（オーディオスレッドがSCHED_FIFOを要求しないなら要求しない）
+    int rt_priority = AudioCtrl::RealtimeGet();
+    int priority    = (rt_priority > 0) ? MAX( 1, rt_priority - 1 ) : 0;
+
+    delete pool_;
+    pool_ = (num > 1) ? new RenderPool( num, priority ) : nullptr;
+}
+
+/**
+ * @brief nnを鳴らしているボイスがあるか
+ * @note  発音中（リリース中も含む）のスロットの先頭のボイスのノートNoを見る
+ *
+ * @param[in] nn ノートNo
+ */
+bool VoiceCtrl::IsNoteActive( int nn )
+{
+    for( int slot=0; slot<slot_num_; slot++ ) {
+        int lane = slot_lane_[slot];
+        if( (active_mask_ & (1ull << lane)) && voice_[lane]->GetNoteNo() == nn ) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief レンダリングで触るものを物理メモリに載せる（レンダリングを始める前に呼ぶ）
+ * @note  VoiceCtrl自身と、別に確保しているボイス、VoiceBank、RenderPoolのキュー
+ * @return プリフォルトしたバイト数
+ */
+size_t VoiceCtrl::Prefault()
+{
+    size_t bytes = RtThread::Prefault( this, sizeof(VoiceCtrl) );
+    for( int ix=0; ix<kVoiceNum; ix++ ) {
+        bytes += RtThread::PrefaultWritable( voice_[ix], sizeof(Voice) );
+    }
+    bytes += bank_->Prefault();
+    if( pool_ ) {
+        bytes += pool_->Prefault();
+    }
+    return bytes;
+}
+
+/**
+ * @brief GetRenderThreadNum
+ */
+int VoiceCtrl::GetRenderThreadNum()
+{
+    return pool_ ? pool_->GetWorkerNum() : 1;
+}
+
+/**
+ * @brief ワーカー毎の直前のブロックの処理時間[ns]
+ *
+ * @param[in] worker ワーカー番号（0はレンダリングを呼ぶスレッド）
+ */
+uint32_t VoiceCtrl::GetRenderWorkerTime( int worker )
+{
+    if( !pool_ || worker >= pool_->GetWorkerNum() ) {
+        return 0;
     }
+    return pool_->GetWorkerTime( worker );
 }
 
 #if 0
@@ -182,19 +515,78 @@ void VoiceCtrl::NoteOff( int notenum )
 #endif
 
 /**
- * @brief GetNextOffVoice
+ * @brief 新しいノートを鳴らすスロットを選ぶ（ポリ数分のスロットから）
+ *
+ * @param[in]  nn    鳴らすノートNo
+ * @param[out] steal 鳴っている音を横取りする(フェードアウトが要る)ならtrue
+ * @retval 選んだスロット
  */
-Voice* VoiceCtrl::GetNextOffVoice()
+int VoiceCtrl::SelectSlot( int nn, bool* steal )
 {
-    int current_voice_no = current_voice_no_;
-    for( int i=0; i<kVoiceNum; i++ ) {
-        current_voice_no = (current_voice_no + 1) % kVoiceNum;
-        if( !voice_[current_voice_no]->IsKeyOn() ) {
-            return voice_[current_voice_no];
+    *steal = false;
+
+    // 同じノートを鳴らしている（リリース中の）ボイスがあれば、そのまま鳴らし直す（今のレベルからアタックする）
+    if( same_note_reuse_ ) {
+        for( int slot=0; slot<poly_num_; slot++ ) {
+            int lane = slot_lane_[slot];
+            if( (active_mask_ & (1ull << lane)) && voice_[lane]->GetNoteNo() == nn ) {
+                return slot;
+            }
+        }
+    }
+
+    // 休止中のスロットを、前回選んだスロットの次から順に探す
+    int slot = current_slot_;
+    for( int i=0; i<poly_num_; i++ ) {
+        slot = (slot + 1) % poly_num_;
+        if( (active_mask_ & (1ull << slot_lane_[slot])) == 0 ) {
+            return slot;
         }
     }
-    // どれもオンだった。
-    return nullptr;
+
+    // 全て発音中なので横取りする
+    int  best     = 0;
+    bool best_off = !voice_[slot_lane_[0]]->IsKeyOn();
+    for( int ix=1; ix<poly_num_; ix++ ) {
+        int    lane      = slot_lane_[ix];
+        int    best_lane = slot_lane_[best];
+        Voice* v         = voice_[lane];
+        bool   off       = !v->IsKeyOn();
+        switch( steal_mode_ ) {
+            case kStealQuietest:
+                // アンプエンベロープのレベルが一番小さいボイス
+                if( v->GetLevel() < voice_[best_lane]->GetLevel() ) {
+                    best = ix;
+                }
+                break;
+            case kStealReleasedFirst:
+                // リリース中のボイスを優先し、その中で一番古いボイス
+                if( (off && !best_off) ||
+                    (off == best_off && (int32_t)(voice_age_[lane] - voice_age_[best_lane]) < 0) ) {
+                    best = ix; best_off = off;
+                }
+                break;
+            case kStealOldest:
+            default:
+                // 一番古くトリガーされたボイス
+                if( (int32_t)(voice_age_[lane] - voice_age_[best_lane]) < 0 ) {
+                    best = ix;
+                }
+                break;
+        }
+    }
+    *steal = true;
+    return best;
+}
+
+/**
+ * @brief ボイスをトリガーし、発音中のボイスに加える
+ */
+void VoiceCtrl::TriggerVoice( Voice* v )
+{
+    v->Trigger();
+    active_mask_ |= StackMask( v->GetNo() );
+    voice_age_[v->GetNo()] = ++age_count_;
 }
 
 /**
@@ -219,14 +611,13 @@ void VoiceCtrl::TriggerPoly()
     //// まずキーリリース処理
     // オンボイスリストからみて、キーボードテーブル上でノートオフ(ベロシティ値=0)に
     // なっているかをチェック→ノートオフならリリースする
-    for( std::list<Voice*>::iterator v=on_voices_.begin(); v != on_voices_.end(); ) {
-        if( midictrl->GetVelocity( (*v)->GetNoteNo() ) == 0 ) {
-            (*v)->Release();
-            v = on_voices_.erase(v);
-        }
-        else {
-            v++;
+    for( int no=on_voices_.First(); no != VoiceList::kNone; ) {
+        int next = on_voices_.Next( no );
+        if( midictrl->GetVelocity( voice_[no]->GetNoteNo() ) == 0 ) {
+            voice_[no]->Release();
+            on_voices_.Remove( no );
         }
+        no = next;
     }
 
     //// トリガー処理
@@ -242,37 +633,36 @@ void VoiceCtrl::TriggerPoly()
         // これは、このアルゴリズムではnote on/offは鍵盤の状態を変更するだけで、もし同一時刻にoff→onの順で同時にきた場合、
         // 結果的にnoteoffは無視される事になるため。
         // このような事にならないために、同一ノートの複数ボイス発音は不可とする。
-        for( std::list<Voice*>::iterator v=on_voices_.begin(); v != on_voices_.end(); ) {
-            if((*v)->GetNoteNo() == noteNo) {
-                (*v)->Release();
-                v = on_voices_.erase(v);
+        for( int no=on_voices_.First(); no != VoiceList::kNone; ) {
+            int next = on_voices_.Next( no );
+            if( voice_[no]->GetNoteNo() == noteNo ) {
+                voice_[no]->Release();
+                on_voices_.Remove( no );
             }
-            else v++;
+            no = next;
         }
 
-        // ユニゾンボイスの数だけ、トリガー処理
-        Voice* pUnisonMasterVoice;
-        for(int u = 0; u < unison_num_; u++) {
-            //// トリガーするボイスの決定
-            // キーオフされているボイスを取得。もし全部ビジーだったら、一番古くからオンになっているボイスを取得
-            // ※ただし、ベース音は除くなどの工夫の余地はある
-            Voice* v = GetNextOffVoice();
-            if(v == NULL){
-                v = on_voices_.front();    // オン中で一番古いボイス
-                if(v == NULL) return;
-                on_voices_.pop_front();
-            }
-            current_voice_no_ = v->GetNo();
-            if(u==0) pUnisonMasterVoice = v; // ユニソンマスターボイスの退避
-
-            // ノートNO等の設定とトリガー
+        //// トリガーするスロットの決定
+        // 同じノートを鳴らしているボイス(再利用する設定の時)→休止中のスロット→横取りポリシーで選んだスロット の順
+        // ユニゾンのレーンはスロットの先頭のボイスがまとめて鳴らす
+        bool   steal = false;
+        int    slot  = SelectSlot( noteNo, &steal );
+        Voice* v     = voice_[slot_lane_[slot]];
+        on_voices_.Remove( v->GetNo() );
+        current_slot_ = slot;
+
+        // ノートNO等の設定とトリガー
+        if( steal ) {
+            // 鳴っている音はクリックが出ないようにフェードアウトしてから、新しいノートを鳴らす
+            v->Steal( noteNo, midictrl->GetVelocity(noteNo), steal_fade_frames_ );
+        }
+        else {
             v->SetNoteInfo(noteNo,midictrl->GetVelocity(noteNo));
-            v->SetUnisonInfo(pUnisonMasterVoice,unison_num_,u);
-            v->Trigger();
-
-            // オンボイスリストへ追加
-            on_voices_.push_back(v);
         }
+        TriggerVoice( v );
+
+        // オンボイスリストへ追加
+        on_voices_.PushBack( v->GetNo() );
     }
 }
 
@@ -281,12 +671,13 @@ void VoiceCtrl::TriggerMono()
 {
     MidiCtrl* midictrl = MidiCtrl::GetInstance();
 
+    // モノモードではスロット0(ボイス0)だけを使う
+    Voice* v = voice_[0];
+
     // なにもキーがおさえられていなければ、現在のオンボイスをリリースして終わり
     if(midictrl->GetOnKeyNum()==0) {
-        for(int i=0;i < unison_num_; i++) {
-            on_voices_.remove(voice_[i]);
-            if(voice_[i]->IsKeyOn()) voice_[i]->Release();
-        }
+        on_voices_.Remove( 0 );
+        if(v->IsKeyOn()) v->Release();
         mono_current_velocity_ = 0;
         return;
     }
@@ -303,61 +694,158 @@ void VoiceCtrl::TriggerMono()
         // 新規ではない→何かキーが離された結果、発音される事になったノート
         // このベロシティは離されたキーと同じとする。よって、m_monoCurrentVelocityは更新しない。
         noteNo = midictrl->GetOnKeyNN(0);
-        if(!voice_[0]->IsKeyOn() || voice_[0]->GetNoteNo() != noteNo) bProcess = true;
+        if(!v->IsKeyOn() || v->GetNoteNo() != noteNo) bProcess = true;
     }
 
     if(!bProcess) return;    // 発音不要
 
     // 発音処理
-    Voice* pUnisonMasterVoice = voice_[0];    // ユニゾンマスターは常にボイス番号ゼロ
     if(key_mode_ == kMono) {
         // モノモード時
         // 必ずトリガー
-        for(int i=0;i < unison_num_; i++) {
-            Voice* v = voice_[i];
-            // ノートNO等の設定とトリガー
-            v->SetNoteInfo(noteNo,mono_current_velocity_);
-            v->SetUnisonInfo(pUnisonMasterVoice,unison_num_,0);
-            v->Trigger();
-
-            // オンボイスリストへ追加 (すでに登録されている可能性があるので、一度削除してから追加)
-            on_voices_.remove(v);
-            on_voices_.push_back(v);
-        }
+        v->SetNoteInfo(noteNo,mono_current_velocity_);
+        TriggerVoice( v );
+
+        // オンボイスリストへ追加 (すでに登録されていれば最新へ移る)
+        on_voices_.PushBack( v->GetNo() );
     }
     else if( key_mode_ == kLegato ) {
         // レガートモノモード時
         // 現在キーオフだった場合のみトリガー
-        for(int i=0;i < unison_num_; i++) {
-            Voice* v = voice_[i];
-            // ノートNO等の設定とトリガー
-            v->SetNoteInfo(noteNo,mono_current_velocity_);
-            if(!v->IsKeyOn()){
-                // 現在キーオフ→トリガーし、オンボイスリストへ追加
-                v->SetUnisonInfo(pUnisonMasterVoice,unison_num_,0);
-                v->Trigger();
-                on_voices_.push_back(v);
-            }else{
-                // 現在オン→トリガーしない
-            }
+        v->SetNoteInfo(noteNo,mono_current_velocity_);
+        if(!v->IsKeyOn()){
+            // 現在キーオフ→トリガーし、オンボイスリストへ追加
+            TriggerVoice( v );
+            on_voices_.PushBack( v->GetNo() );
+        }else{
+            // 現在オン→トリガーしない
         }
     }
 }
 
 
 /**
- * @brief SignalProcess
+ * @brief RenderBlock
+ *
+ * @param[out] out      planar output (channels個)
+ * @param[in]  channels number of channels (1～VoiceBank::kMaxChannels。1なら定位は無視する)
+ * @param[in]  frames   number of frames
  */
-float VoiceCtrl::SignalProcess()
+void VoiceCtrl::RenderBlock( float* const* out, int channels, int frames )
 {
-    double   val = 0;
-    uint32_t w;
-    for(int ix = 0; ix<kVoiceNum; ix++) {
-        if( voice_[ix]->IsPlaying() == true ) {
-            Voice *v = voice_[ix];
-            val += v->Calc();
+    // 発音中のボイスだけを、VoiceBankのグループ単位でジョブにする
+    uint64_t active_mask = active_mask_;
+    int      active_num  = voicectrl_bit_count( active_mask );
+    active_num_.store( active_num, std::memory_order_relaxed );
+
+    if( active_mask == 0 ) {
+        for( int ch=0; ch<channels; ch++ ) {
+            memset( out[ch], 0, sizeof(float) * frames );
+        }
+        return;
+    }
+
+    int job_num = 0;
+    for( int group=0; group+job_span_<=VoiceBank::GroupNum(); group+=job_span_ ) {
+        if( (active_mask & JobLaneMask( group )) != 0 ) {
+            job_idle_[job_num]    = 0;
+            job_group_[job_num++] = group;
+        }
+    }
+    job_frames_ = frames;
+    job_mask_   = active_mask;
+
+    // コントローラーの値はブロック毎に各ボイスへ渡す
+    MidiCtrl* midictrl = MidiCtrl::GetInstance();
+    if( midictrl && mod_matrix_.GetSlotNum() > 0 ) {
+        float mod_wheel = midictrl->GetModWheel() * (1.f / 127.f);
+        for( uint64_t bits=active_mask & master_mask_; bits != 0; bits &= bits - 1 ) {
+            Voice* v = voice_[voicectrl_bit_index( bits )];
+            v->SetController( mod_wheel, midictrl->GetAftertouch( v->GetNoteNo() ) * (1.f / 127.f) );
         }
     }
 
-    return val;
+    // 発音数が少なければ分担しても割に合わないので、このスレッドだけで処理する
+    if( pool_ && job_num > 1 && active_num >= kParallelMinVoices ) {
+        pool_->Run( voicectrl_render_job, this, job_num );
+    }
+    else {
+        for( int job=0; job<job_num; job++ ) {
+            RenderJob( job );
+        }
+    }
+
+    // グループ毎の結果をMIXする（足す順番は固定なので、スレッド数によらず同じ結果になる）
+    bank_->Mix( out, channels, frames, active_mask );
+
+    // このブロックで休止したボイスは次のブロックから処理しない
+    for( int job=0; job<job_num; job++ ) {
+        active_mask_ &= ~job_idle_[job];
+    }
+}
+
+/**
+ * @brief 1ジョブ分(job_span_グループ)のボイスのパラメータをVoiceBankへ設定し、まとめて処理する
+ * @note  ワーカースレッドから呼ばれる。
+ *        ブロックをcontrol_frames_毎の区間に分け、区間毎にパラメータ(変調)を求め直す。
+ *        パラメータはスロットの先頭のボイスがユニゾンの全レーン分を設定する
+ *
+ * @param[in] job ジョブ番号
+ */
+void VoiceCtrl::RenderJob( int job )
+{
+    const int first   = job_group_[job];
+    uint64_t  masters = job_mask_ & master_mask_ & JobLaneMask( first );
+
+    for( int pos=0; pos<job_frames_; pos+=control_frames_ ) {
+        int frames = MIN( control_frames_, job_frames_ - pos );
+        for( uint64_t bits=masters; bits != 0; bits &= bits - 1 ) {
+            voice_[voicectrl_bit_index( bits )]->Prepare( bank_, pos, frames );
+        }
+        for( int group=first; group<first+job_span_; group++ ) {
+            bank_->RenderGroup( group, pos, frames, job_mask_ );
+        }
+    }
+
+    uint64_t idle = 0;
+    for( uint64_t bits=masters; bits != 0; bits &= bits - 1 ) {
+        int lane = voicectrl_bit_index( bits );
+        if( !voice_[lane]->IsPlaying() ) {
+            idle |= StackMask( lane );
+        }
+    }
+    job_idle_[job] = idle;
+}
+
+/**
+ * @brief Render job handler
+ */
+static void voicectrl_render_job( int job, void* userdata )
+{
+    VoiceCtrl* voicectrl = (VoiceCtrl*)userdata;
+    voicectrl->RenderJob( job );
+}
+
+/**
+ * @brief 一番下の立っているビットの位置
+ */
+static int voicectrl_bit_index( uint64_t bits )
+{
+    int index = 0;
+    for( ; (bits & 1) == 0; bits >>= 1 ) {
+        index++;
+    }
+    return index;
+}
+
+/**
+ * @brief 立っているビットの数
+ */
+static int voicectrl_bit_count( uint64_t bits )
+{
+    int num = 0;
+    for( ; bits != 0; bits &= bits - 1 ) {
+        num++;
+    }
+    return num;
 }
@@ -3,10 +3,16 @@
  */
 #pragma once
 
-#include <list>
+#include <atomic>
 
-#include "audio.h."
+#include "audio.h"
 #include "voice.h"
+#include "voice_bank.h"
+#include "voice_list.h"
+#include "render_pool.h"
+#include "patch.h"
+#include "latency_histogram.h"
+#include "rt_thread.h"
 
 /**
  * @class VoiceCtrl
@@ -17,29 +23,66 @@ private:
     void NoteOff( int notenum );
 
     // const
-    static const int kVoiceNum = 32;
+    static const int kVoiceNum = VoiceBank::kLaneNum;
+    static_assert( kVoiceNum <= VoiceList::kMaxVoices, "VoiceList is too small" );
 
     // variable
     int key_mode_;
-    int current_voice_no_;  // カレントボイス番号
-    int poly_num_;          // ポリモード時の最大ボイス数
-    int unison_num_;        // ユニゾンボイス数
+    int current_slot_;      // 最後に選んだスロット
+    int poly_num_;          // ポリモード時の最大ノート数
+    int unison_num_;        // ユニゾンボイス数（1ノートで鳴らすレーン数）
+
+    // スロット: 1ノート分のレーン（先頭のボイスが、続くunison_num_-1個のレーンもまとめて鳴らす）
+    //   1つのスロットは1つのジョブに収まるように並べる（ノート毎の処理を1つのスレッドで済ませる）
+    int      slot_num_;
+    int      slot_lane_[kVoiceNum];  // スロットの先頭のボイス番号
+    uint64_t master_mask_;           // スロットの先頭のボイス
+    int      job_span_;              // 1ジョブで処理するグループ数
 
     int mono_current_velocity_;  // モノモード時に使うワーク用ベロシテシティ値
 
     Voice* voice_[kVoiceNum];
-
-    std::list<Voice*> on_voices_; // キーオン中のボイスリスト
+    VoiceBank* bank_;  // 全ボイスの信号処理部
+
+    // 変調
+    ModMatrix mod_matrix_;      // 全ボイス共通
+    int       control_frames_;  // 変調を求める間隔（コントロールレート）[サンプル]
+
+    // マルチスレッドレンダリング
+    static const int kParallelMinVoices = 8;  // 発音数がこれ未満なら呼び出しスレッドだけで処理する
+    RenderPool* pool_;                        // nullptrならシングルスレッド
+    int         job_group_[kVoiceNum];        // ジョブ番号→VoiceBankの先頭のグループ番号
+    int         job_frames_;
+    uint64_t    job_mask_;
+    uint64_t    job_idle_[kVoiceNum];         // ジョブ毎の、そのブロックで休止したボイス
+
+    // 発音中のボイス（bit n がボイス番号n）。トリガーで立て、エンベロープが休止したら落とす
+    uint64_t         active_mask_;
+    std::atomic<int> active_num_;  // 直前のブロックの発音数（UIから読む）
+
+    VoiceList on_voices_;  // キーオン中のボイス（古い順）
+
+    // ボイスの横取り
+    static const int kStealFadeMs = 2;       // 横取りした音のフェードアウト時間
+    int      steal_mode_;                    // kStealOldest, kStealQuietest, kStealReleasedFirst
+    bool     same_note_reuse_;               // 同じノートを鳴らしているボイスを使い回す
+    int      steal_fade_frames_;
+    uint32_t voice_age_[kVoiceNum];          // トリガーした順番（大きいほど新しい）
+    uint32_t age_count_;
 
     // func
+    void TriggerVoice( Voice* v );
     void TriggerPoly();
     void TriggerMono();
 
-    Voice* GetNextOffVoice();
+    int      SelectSlot( int nn, bool* steal );
+    void     LayoutSlots();
+    uint64_t StackMask( int lane );
+    uint64_t JobLaneMask( int first_group );
 
 public:
     VoiceCtrl();
-    ~VoiceCtrl(){}
+    ~VoiceCtrl();
 
     enum {
         kPoly = 0,  // ポリ
@@ -47,8 +90,28 @@ public:
         kLegato     // レガート
     };
 
+    // 全ボイスが発音中の時に、どのボイスを横取りするか
+    enum {
+        kStealOldest = 0,     // 一番古くトリガーしたボイス
+        kStealQuietest,       // アンプエンベロープのレベルが一番小さいボイス
+        kStealReleasedFirst,  // リリース中のボイスを優先（その中で一番古いボイス）
+    };
+
     void  Trigger();
-    float SignalProcess();
+    void  RenderBlock( float* const* out, int channels, int frames );
+    void  RenderBlock( float* out, int frames ) { RenderBlock( &out, 1, frames ); }  // モノラル
+    void  RenderJob( int job );
+
+    void     SetPatch( const Patch& patch );
+
+    void     SetRenderThreadNum( int num );
+    int      GetRenderThreadNum();
+    uint32_t GetRenderWorkerTime( int worker );
+
+    int      GetActiveVoiceNum() { return active_num_.load( std::memory_order_relaxed ); }
+    bool     IsNoteActive( int nn );  // nnを鳴らしている（リリース中も含む）ボイスがあるか
+
+    size_t   Prefault();  // レンダリングで触るもの（ボイス、VoiceBank、RenderPool）を物理メモリに載せる
 };
 
 
@@ -64,20 +127,51 @@ private:
     Synth& operator=(const Synth&);
     static Synth* instance_;
 
-    void Initialize( float tuning );
+    void Initialize( float tuning, float fs );
 
     VoiceCtrl* voicectrl_;
     AudioCtrl* audioctrl_;
+    float      fs_;  // sample rate
+
+    uint32_t sigproc_time_;    // 直前のコールバックの処理時間[ns]
+    uint32_t sigproc_budget_;  // 直前のコールバックの予算(フレーム数/fs)[ns]
+
+    LatencyHistogram proc_hist_;  // コールバック毎の処理時間
+    RtThread::Status rt_status_;  // Startでのリアルタイム設定の結果
+
+    // 発音数毎のコールバック処理時間の合計と回数（負荷と発音数の関係を見る）
+    std::atomic<uint64_t> proc_ns_by_voices_[VoiceBank::kLaneNum + 1];
+    std::atomic<uint32_t> proc_num_by_voices_[VoiceBank::kLaneNum + 1];
+
+    // 出力の監視（UIの波形表示など）。RenderBlockがブロック毎に1チャンネル目を渡す
+    typedef void (*MonitorFunc)( const float* data, int num, void* userdata );
+    MonitorFunc monitor_func_;
+    void*       monitor_userdata_;
 
-    uint32_t sigproc_time_; // nanosecond
 
 public:
     static Synth* Create( float tuning );
+    static Synth* Create( float tuning, float fs );  // AudioCtrlを使わない（オフラインレンダリング用）
     static void   Destroy();
     static Synth* GetInstance();
 
     void Start();
 
-    float SignalCallback();
-    uint32_t GetProcTime() { return sigproc_time_; }
+    void RenderBlock( float* const* out, int frames, int channels );
+    uint32_t GetProcTime()   { return sigproc_time_; }
+    uint32_t GetProcBudget() { return sigproc_budget_; }
+    LatencyHistogram& GetProcHistogram() { return proc_hist_; }
+    const RtThread::Status& GetRtStatus() { return rt_status_; }
+    bool     DumpProcStats( const char* path );
+    int      GetActiveVoiceNum() { return voicectrl_->GetActiveVoiceNum(); }
+
+    void SetPatch( const Patch& patch ) { voicectrl_->SetPatch( patch ); }
+
+    void MonitorSet( MonitorFunc func, void* userdata );  // Startより前に設定すること
+    void MonitorUnset();
+
+    // 発音処理のスレッド数（Startより前に設定すること）
+    void     SetRenderThreadNum( int num ) { voicectrl_->SetRenderThreadNum( num ); }
+    int      GetRenderThreadNum()          { return voicectrl_->GetRenderThreadNum(); }
+    uint32_t GetRenderWorkerTime( int worker ) { return voicectrl_->GetRenderWorkerTime( worker ); }
 };
@@ -7,21 +7,148 @@
 #include "common.h"
 
 #include "waveform.h"
-#include "filter.h"
 #include "envelope.h"
 
 #include "voice.h"
 
 /**
- * @brief 信号処理部
+ * @brief constructor
+ */
+Voice::Voice() :
+    lfo1( Waveform::GetInstance()->GetSamplerate() ),
+    lfo2( Waveform::GetInstance()->GetSamplerate() )
+{
+    voice_no_ = 0;
+    nn_       = 0;
+    velocity_ = 0;
+    key_on_   = false;
+    steal_fade_     = 0;
+    steal_fade_len_ = 0;
+    steal_pending_  = false;
+
+    mod_matrix_ = nullptr;
+    mod_wheel_  = 0.f;
+    aftertouch_ = 0.f;
+    amp_mod_    = 1.f;
+    pan_        = 0.f;
+
+    rand_ = 0x9E3779B9u;
+    SetUnison( 1, 0.f, 0.f, true );
+}
+
+/**
+ * @brief 1区間(コントロールレートの1周期)分の信号処理パラメータをVoiceBankの自ボイスのレーンへ設定する
+ * @note  変調は区間の終わりでの値を求め、区間の中はVoiceBank(ピッチ、カットオフ)とVCA(音量)が直線で補間する
+ *
+ * @param[in,out] bank
+ * @param[in]     offset ブロック先頭からの位置
+ * @param[in]     frames 区間の長さ
+ */
+void Voice::Prepare( VoiceBank* bank, int offset, int frames )
+{
+    float dst[ModMatrix::kDstNum] = {};
+    if( mod_matrix_ && mod_matrix_->GetSlotNum() > 0 ) {
+        float src[ModMatrix::kSrcNum];
+        src[ModMatrix::kSrcLfo1]       = lfo1.Advance( frames );
+        src[ModMatrix::kSrcLfo2]       = lfo2.Advance( frames );
+        src[ModMatrix::kSrcEnv2]       = eg.Advance( frames );
+        src[ModMatrix::kSrcVelocity]   = velocity_ * (1.f / 127.f);
+        src[ModMatrix::kSrcAftertouch] = aftertouch_;
+        src[ModMatrix::kSrcModWheel]   = mod_wheel_;
+        mod_matrix_->Process( src, dst );
+    }
+
+    if( phase_reset_ ) {
+        ResetPhase( bank );
+    }
+    bool ramp = !vco.new_note_;  // ノートの始めは定位を補間しない
+
+    vco.Prepare( bank, voice_no_, frames, dst[ModMatrix::kDstPitch], unison_ratio_, unison_num_ );
+    vcf.Prepare( bank, voice_no_, frames, dst[ModMatrix::kDstCutoff], unison_num_ );
+
+    float     amp    = MAX( 0.f, 1.f + dst[ModMatrix::kDstAmp] ) * unison_gain_;
+    float*    gain   = bank->GainGet( voice_no_ ) + offset * VoiceBank::GainStride();
+    const int stride = VoiceBank::GainStride();
+    vca.Prepare( gain, stride, frames, amp_mod_, amp );
+    amp_mod_ = amp;
+
+    pan_ = MAX( -1.f, MIN( 1.f, dst[ModMatrix::kDstPan] ) );
+    for( int u=0; u<unison_num_; u++ ) {
+        bank->SetPan( voice_no_ + u, GetPan( u ), ramp );
+    }
+
+    if( steal_fade_ > 0 || steal_pending_ ) {
+        // 横取りされたボイス: 今の音をフェードアウトし、終わったら次の区間から新しいノートを鳴らす
+        float step = 1.f / steal_fade_len_;
+        for( int ix=0; ix<frames; ix++ ) {
+            steal_fade_ = (steal_fade_ > 0) ? steal_fade_ - 1 : 0;
+            gain[ix * stride] *= steal_fade_ * step;
+        }
+        if( steal_fade_ == 0 ) {
+            StartStolenNote( bank );
+        }
+    }
+
+    // ユニゾンの残りのレーンは同じゲイン列を使う
+    for( int u=1; u<unison_num_; u++ ) {
+        float* dst_gain = bank->GainGet( voice_no_ + u ) + offset * stride;
+        for( int ix=0; ix<frames; ix++ ) {
+            dst_gain[ix * stride] = gain[ix * stride];
+        }
+    }
+}
+
+/**
+ * @brief ユニゾンの各レーンの位相を決める（ノートの始めに1回）
+ *
+ * @param[in,out] bank
  */
-float Voice::Calc()
+void Voice::ResetPhase( VoiceBank* bank )
 {
-    float val;
-    val = vco.Calc();
-    val = vcf.Calc(val);
-    val = vca.Calc(val);
-    return val;
+    for( int u=0; u<unison_num_; u++ ) {
+        uint32_t phase = 0;
+        if( unison_random_phase_ ) {
+            rand_ ^= rand_ << 13;
+            rand_ ^= rand_ >> 17;
+            rand_ ^= rand_ << 5;
+            phase = rand_;
+        }
+        bank->SetPhase( voice_no_ + u, phase );
+    }
+    phase_reset_ = false;
+}
+
+/**
+ * @brief 横取りしたボイスのフェードアウトが終わったので、新しいノートを始める
+ *
+ * @param[in,out] bank
+ */
+void Voice::StartStolenNote( VoiceBank* bank )
+{
+    // フェードアウトした分のエンベロープとフィルタの状態を捨て、0から始める
+    vca.Reset();
+    vcf.Reset();
+    eg.Reset();
+    for( int u=0; u<unison_num_; u++ ) {
+        bank->ResetFilter( voice_no_ + u );
+    }
+
+    if( steal_pending_ ) {
+        steal_pending_ = false;
+        phase_reset_   = (unison_num_ > 1);
+        vco.SetNoteNo( nn_, key_on_ );
+        vcf.Trigger();
+        vca.Trigger();
+        eg.Trigger();
+        lfo1.Trigger();
+        lfo2.Trigger();
+        if( !key_on_ ) {
+            // フェードアウト中にキーが離された
+            vcf.Release();
+            vca.Release();
+            eg.Release();
+        }
+    }
 }
 
 // キーオン中かどうかを返す
@@ -32,20 +159,31 @@ bool Voice::IsKeyOn()
 
 bool Voice::IsPlaying()
 {
-    return vca.IsPlaying();
+    return vca.IsPlaying() || steal_pending_;
 }
 
 // トリガー通知
 void Voice::Trigger(void)
 {
-    vca.Trigger();
+    if( !steal_pending_ ) {
+        vcf.Trigger();
+        vca.Trigger();
+        eg.Trigger();
+        lfo1.Trigger();
+        lfo2.Trigger();
+        phase_reset_ = (unison_num_ > 1);
+    }
     key_on_ = true;
 }
 
 // キーオフ通知
 void Voice::Release(void)
 {
-    vca.Release();
+    if( !steal_pending_ ) {
+        vcf.Release();
+        vca.Release();
+        eg.Release();
+    }
     key_on_ = false;
 }
 
@@ -59,9 +197,123 @@ void Voice::SetNoteInfo( int nn, int velo )
 }
 
 
-void Voice::SetUnisonInfo(Voice* pMasterVoice, int unisonNum, int unisonNo)
+/**
+ * @brief 発音中のボイスを別のノートに使う
+ * @note  今の音をfade_framesかけてフェードアウトし、終わったブロックの次から新しいノートを鳴らす。
+ *        フェードアウト中もGetNoteNoは新しいノートNoを返す
+ *
+ * @param[in] nn          Note number
+ * @param[in] velo        velocity
+ * @param[in] fade_frames フェードアウトの長さ
+ */
+void Voice::Steal( int nn, int velo, int fade_frames )
 {
-    /* do nothing (now...) */
+    nn_       = nn;
+    velocity_ = velo;
+
+    if( !steal_pending_ ) {
+        steal_fade_len_ = MAX( fade_frames, 1 );
+        steal_fade_     = steal_fade_len_;
+        steal_pending_  = true;
+    }
+}
+
+
+/**
+ * @brief ユニゾンの設定
+ * @note  このボイスがvoice_no_から連続したnum個のレーンを鳴らす（VoiceCtrlがレーンを空けておく）。
+ *        デチューンと定位はレーン毎に-1～1の位置へ等間隔に並べる
+ *
+ * @param[in] num          重ねる数(1～kMaxUnison)
+ * @param[in] detune_cent  両端のレーンのデチューン（セント）
+ * @param[in] spread       両端のレーンの定位のずれ(0～1)
+ * @param[in] random_phase ノートの始めに各レーンの位相をばらす
+ */
+void Voice::SetUnison( int num, float detune_cent, float spread, bool random_phase )
+{
+    unison_num_          = MAX( 1, MIN( num, kMaxUnison ) );
+    unison_gain_         = 1.f / sqrtf( (float)unison_num_ );
+    unison_random_phase_ = random_phase;
+    phase_reset_         = false;
+
+    for( int u=0; u<kMaxUnison; u++ ) {
+        float pos = (unison_num_ > 1) ? 2.f * u / (unison_num_ - 1) - 1.f : 0.f;
+        unison_ratio_[u] = powf( 2.f, detune_cent * pos / 1200.f );
+        // 両端から数えて奇数番目の組は左右を入れ替え、デチューンの近いレーンを反対側に置く
+        int from_edge = MIN( u, unison_num_ - 1 - u );
+        unison_pan_[u]   = spread * ((from_edge & 1) ? -pos : pos);
+    }
+}
+
+/**
+ * @brief 変調後のパン
+ *
+ * @param[in] unison_no ユニゾンのレーン番号(0～GetUnisonNum()-1)
+ */
+float Voice::GetPan( int unison_no )
+{
+    return MAX( -1.f, MIN( 1.f, pan_ + unison_pan_[unison_no] ) );
+}
+
+// アンプエンベロープの設定
+void Voice::SetEnvelope( int attack_ms, int decay_ms, float sustain_lv, int release_ms )
+{
+    vca.SetEnvelope( attack_ms, decay_ms, sustain_lv, release_ms );
+}
+
+// エンベロープカーブの設定（アンプ、フィルタ、2つ目のエンベロープ共通）
+void Voice::SetEnvelopeCurve( Envelope::Curve curve )
+{
+    vca.SetCurve( curve );
+    vcf.SetCurve( curve );
+    eg.SetCurve( curve );
+}
+
+// フィルタの設定
+void Voice::SetFilter( float cutoff_nn, float resonance, float env_amount )
+{
+    vcf.SetParam( cutoff_nn, resonance, env_amount );
+}
+
+// フィルタエンベロープの設定
+void Voice::SetFilterEnvelope( int attack_ms, int decay_ms, float sustain_lv, int release_ms )
+{
+    vcf.SetEnvelope( attack_ms, decay_ms, sustain_lv, release_ms );
+}
+
+// 2つ目のエンベロープ（変調元）の設定
+void Voice::SetEnvelope2( int attack_ms, int decay_ms, float sustain_lv, int release_ms )
+{
+    eg.SetEnvelope( attack_ms, decay_ms, sustain_lv, release_ms );
+}
+
+/**
+ * @brief LFOの設定
+ *
+ * @param[in] no       LFO番号(0～kLfoNum-1)
+ * @param[in] rate_hz  周波数
+ * @param[in] shape    波形
+ * @param[in] key_sync キーオン毎に位相を先頭へ戻す
+ */
+void Voice::SetLfo( int no, float rate_hz, Lfo::Shape shape, bool key_sync )
+{
+    Lfo* lfo = (no == 0) ? &lfo1 : &lfo2;
+    lfo->SetRate( rate_hz );
+    lfo->SetShape( shape );
+    lfo->SetKeySync( key_sync );
+}
+
+/**
+ * @brief コントローラーの値（変調元）
+ * @note  ブロック毎にVoiceCtrlから設定される
+ *
+ * @param[in] mod_wheel  0～1
+ * @param[in] aftertouch 0～1
+ */
+void Voice::SetController( float mod_wheel, float aftertouch )
+{
+    mod_wheel_  = mod_wheel;
+    aftertouch_ = aftertouch;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -93,24 +345,57 @@ void Voice::VCO::SetNoteNo( int nn, bool is_key_on )
         current_porta_time_ = 1.f;
     }
 
-    nn_ = (float)nn;
+    nn_       = (float)nn;
+    new_note_ = true;
 }
 
 /**
- * @brief 波形生成
+ * @brief 波形生成パラメータの設定
+ * @note  ノートが変わった時以外は、角速度を区間の間に直線で移す
  *
- * @param[in] w 角速度
+ * @param[in,out] bank
+ * @param[in]     lane
+ * @param[in]     frames
+ * @param[in]     pitch_mod    ピッチの変調量（半音）
+ * @param[in]     unison_ratio ユニゾンのレーン毎の角速度の倍率
+ * @param[in]     unison_num   laneから連続して設定するレーン数
  */
-float Voice::VCO::Calc()
+void Voice::VCO::Prepare( VoiceBank* bank, int lane, int frames, float pitch_mod, const float* unison_ratio, int unison_num )
 {
     Waveform* wf = Waveform::GetInstance();
-    uint32_t w = wf->CalcWFromNoteNo( nn_, detune_cent_ );
 
-    //float val = wf->GetSine( p_ );
-    float val = wf->GetSaw( nn_, p_ );
+    // ポルタメント中のノートNoを進める
+    if( current_porta_time_ < 1.f ) {
+        current_porta_time_ = MIN( 1.f, current_porta_time_ + porta_time_delta_ * frames );
+        current_nn_ = porta_start_nn_ + (nn_ - porta_start_nn_) * current_porta_time_;
+    }
+    else {
+        current_nn_ = nn_;
+    }
+    float nn = current_nn_ + pitch_mod;
 
-    p_ += w;
-    return val;
+    // 角速度と波形テーブルはピッチが変わった時だけ求め直す
+    if( nn != w_nn_ || detune_cent_ != w_det_ ) {
+        // ポルタメント中や変調中は毎区間変わるのでテーブル版で求める
+        w_     = (current_porta_time_ < 1.f || pitch_mod != 0.f) ? wf->CalcWFromNoteNoFast( nn, detune_cent_ )
+                                                                 : wf->CalcWFromNoteNo( nn, detune_cent_ );
+        w_nn_  = nn;
+        w_det_ = detune_cent_;
+    }
+    if( nn != wt_nn_ ) {
+        wt_offset_ = wf->GetWTOffsetFromNN( wf->WF_SAW, nn );
+        wt_nn_     = nn;
+    }
+    if( unison_num == 1 ) {
+        bank->SetOsc( lane, wt_offset_, w_, !new_note_ );
+    }
+    else {
+        // デチューンは数セントなので、波形テーブルは全レーン共通でよい
+        for( int u=0; u<unison_num; u++ ) {
+            bank->SetOsc( lane + u, wt_offset_, (uint32_t)((float)w_ * unison_ratio[u]), !new_note_ );
+        }
+    }
+    new_note_ = false;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -118,23 +403,94 @@ float Voice::VCO::Calc()
 /**
  * @brief constructor
  */
-Voice::VCF::VCF()
+Voice::VCF::VCF() : env_( Waveform::GetInstance()->GetSamplerate() )
 {
-    Waveform* w = Waveform::GetInstance();
-    filter = new Filter( w->GetSamplerate() );
+    cutoff_nn_  = VoiceBank::kCutoffNoteNum;  // 全開
+    resonance_  = 0.707f;
+    env_amount_ = 0.f;
 
-    filter->LowPass( 1000.f, 0.7f );
+    env_.SetAttack( 10 );
+    env_.SetDecay( 300 );
+    env_.SetSustain( 0.f );
+    env_.SetRelease( 300 );
+}
+
+/**
+ * @brief フィルタエンベロープ開始
+ */
+void Voice::VCF::Trigger()
+{
+    env_.Trigger();
+}
+
+/**
+ * @brief フィルタエンベロープのリリース
+ */
+void Voice::VCF::Release()
+{
+    env_.Release();
 }
 
 /**
- * @brief 減算処理
+ * @brief フィルタの設定
  *
- * @param[in] val
+ * @param[in] cutoff_nn  カットオフ周波数（ノートNo単位）
+ * @param[in] resonance  Q
+ * @param[in] env_amount エンベロープでカットオフを動かす幅（半音、負なら下げる）
  */
-float Voice::VCF::Calc( float val )
+void Voice::VCF::SetParam( float cutoff_nn, float resonance, float env_amount )
 {
-    //return filter->Process(val);
-    return val;
+    cutoff_nn_  = cutoff_nn;
+    resonance_  = resonance;
+    env_amount_ = env_amount;
+}
+
+/**
+ * @brief フィルタエンベロープの設定
+ */
+void Voice::VCF::SetEnvelope( int attack_ms, int decay_ms, float sustain_lv, int release_ms )
+{
+    env_.SetAttack( attack_ms );
+    env_.SetDecay( decay_ms );
+    env_.SetSustain( sustain_lv );
+    env_.SetRelease( release_ms );
+}
+
+/**
+ * @brief フィルタエンベロープのカーブ
+ */
+void Voice::VCF::SetCurve( Envelope::Curve curve )
+{
+    env_.SetCurve( curve );
+}
+
+/**
+ * @brief フィルタエンベロープをすぐに止める
+ */
+void Voice::VCF::Reset()
+{
+    env_.Reset();
+}
+
+/**
+ * @brief 減算処理パラメータの設定
+ * @note  カットオフは区間毎(コントロールレート)に求め、区間内はVoiceBankが係数を補間する
+ *
+ * @param[in,out] bank
+ * @param[in]     lane
+ * @param[in]     frames
+ * @param[in]     cutoff_mod カットオフの変調量（半音）
+ * @param[in]     unison_num laneから連続して設定するレーン数（係数は1回だけ求めて写す）
+ */
+void Voice::VCF::Prepare( VoiceBank* bank, int lane, int frames, float cutoff_mod, int unison_num )
+{
+    // エンベロープを区間の終わりまで進める
+    float lv = env_.Advance( frames );
+
+    bank->SetFilter( lane, cutoff_nn_ + env_amount_ * lv + cutoff_mod, resonance_ );
+    for( int u=1; u<unison_num; u++ ) {
+        bank->CopyFilter( lane + u, lane );
+    }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -142,15 +498,12 @@ float Voice::VCF::Calc( float val )
 /**
  * @brief VCA constructor
  */
-Voice::VCA::VCA()
+Voice::VCA::VCA() : env_( Waveform::GetInstance()->GetSamplerate() )
 {
-    Waveform* w = Waveform::GetInstance();
-    env = new Envelope( w->GetSamplerate() );
-
-    env->SetAttack( 100 );
-    env->SetDecay( 200 );
-    env->SetSustain( 0.5f );
-    env->SetRelease( 1000 );
+    env_.SetAttack( 100 );
+    env_.SetDecay( 200 );
+    env_.SetSustain( 0.5f );
+    env_.SetRelease( 1000 );
 }
 
 /**
@@ -158,7 +511,7 @@ Voice::VCA::VCA()
  */
 void Voice::VCA::Trigger()
 {
-    env->Trigger();
+    env_.Trigger();
 }
 
 /**
@@ -166,18 +519,57 @@ void Voice::VCA::Trigger()
  */
 void Voice::VCA::Release()
 {
-    env->Release();
+    env_.Release();
 }
 
 
 /**
- * @brief 音量加工
+ * @brief エンベロープの設定
+ */
+void Voice::VCA::SetEnvelope( int attack_ms, int decay_ms, float sustain_lv, int release_ms )
+{
+    env_.SetAttack( attack_ms );
+    env_.SetDecay( decay_ms );
+    env_.SetSustain( sustain_lv );
+    env_.SetRelease( release_ms );
+}
+
+/**
+ * @brief エンベロープのカーブ
+ */
+void Voice::VCA::SetCurve( Envelope::Curve curve )
+{
+    env_.SetCurve( curve );
+}
+
+/**
+ * @brief エンベロープをすぐに止める
+ */
+void Voice::VCA::Reset()
+{
+    env_.Reset();
+}
+
+/**
+ * @brief 1区間分のゲインを求める
  *
- * @param[in] val
+ * @param[out] gain     gain (stride間隔で書き込む)
+ * @param[in]  stride
+ * @param[in]  frames
+ * @param[in]  amp_from 区間の始まりでの音量の倍率（直前の区間の終わりの値）
+ * @param[in]  amp_to   区間の終わりでの音量の倍率
  */
-float Voice::VCA::Calc( float val )
+void Voice::VCA::Prepare( float* gain, int stride, int frames, float amp_from, float amp_to )
 {
-    return env->Process( val ) * 0.5f;
+    float lv[VoiceBank::kMaxFrames];
+    env_.Process( lv, frames );
+
+    float amp  = amp_from * 0.5f;
+    float step = (amp_to - amp_from) * 0.5f / frames;
+    for( int ix=0; ix<frames; ix++ ) {
+        amp += step;
+        gain[ix * stride] = lv[ix] * amp;
+    }
 }
 
 /**
@@ -185,5 +577,79 @@ float Voice::VCA::Calc( float val )
  */
 bool Voice::VCA::IsPlaying()
 {
-    return env->IsPlaying();
+    return env_.IsPlaying();
+}
+
+/**
+ * @brief エンベロープの今のレベル
+ */
+float Voice::VCA::GetLevel()
+{
+    return env_.GetLevel();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief EG constructor
+ */
+Voice::EG::EG() : env_( Waveform::GetInstance()->GetSamplerate() )
+{
+    env_.SetAttack( 10 );
+    env_.SetDecay( 300 );
+    env_.SetSustain( 0.f );
+    env_.SetRelease( 300 );
+}
+
+/**
+ * @brief エンベロープ開始
+ */
+void Voice::EG::Trigger()
+{
+    env_.Trigger();
+}
+
+/**
+ * @brief エンベロープのリリース
+ */
+void Voice::EG::Release()
+{
+    env_.Release();
+}
+
+/**
+ * @brief エンベロープの設定
+ */
+void Voice::EG::SetEnvelope( int attack_ms, int decay_ms, float sustain_lv, int release_ms )
+{
+    env_.SetAttack( attack_ms );
+    env_.SetDecay( decay_ms );
+    env_.SetSustain( sustain_lv );
+    env_.SetRelease( release_ms );
+}
+
+/**
+ * @brief エンベロープのカーブ
+ */
+void Voice::EG::SetCurve( Envelope::Curve curve )
+{
+    env_.SetCurve( curve );
+}
+
+/**
+ * @brief エンベロープをすぐに止める
+ */
+void Voice::EG::Reset()
+{
+    env_.Reset();
+}
+
+/**
+ * @brief framesサンプル分進める
+ *
+ * @retval 進めた後のレベル(0～1)
+ */
+float Voice::EG::Advance( int frames )
+{
+    return env_.Advance( frames );
 }
@@ -5,8 +5,10 @@
 
 #include <list>
 
-#include "filter.h"
 #include "envelope.h"
+#include "lfo.h"
+#include "mod_matrix.h"
+#include "voice_bank.h"
 
 /**
  * @class Voice
@@ -16,85 +18,157 @@ private:
     class VCO {
     public:
         VCO() {
-            p_  = 0;
             nn_ = 0;
+            current_nn_         = 0;
+            porta_start_nn_     = 0;
+            current_porta_time_ = 1.f;
+            porta_time_delta_   = 0.f;
             detune_cent_ = 0;
+            wt_nn_       = -1.f;
+            wt_offset_   = 0;
+            w_nn_        = -1.f;
+            w_det_       = 0;
+            w_           = 0;
+            new_note_    = true;
         }
         ~VCO(){}
 
-        // variable
-        uint32_t p_;            // phase(16:16 fixed-point)
+        // variable (位相はVoiceBankが保持する)
         float    nn_;           // 発振指定されたノートNo
         float    current_nn_;   // 現在発振中のノートNo（ノートNoを小数にする事でポルタメント中のノートNoを表現する）
         float    porta_start_nn_;      // ポルタメント開始時のnoteNo
         float    current_porta_time_;      // ポルタメント経過時間（1で正規化、0～1でポルタメント中）
         float    porta_time_delta_;    // ポルタメント速度
         float    detune_cent_;      // ボイス間デチューン値（単位はセント）
+        float    wt_nn_;            // wt_offset_を求めた時のノートNo
+        int      wt_offset_;        // 使用中の波形テーブル（ピッチが変わった時だけ求め直す）
+        float    w_nn_;             // w_を求めた時のノートNo
+        float    w_det_;            // w_を求めた時のデチューン値
+        uint32_t w_;                // 角速度（ピッチが変わった時だけ求め直す）
+        bool     new_note_;         // ノートが変わった（次のPrepareでは角速度を補間せずに切り替える）
 
         void  SetNoteNo( int nn, bool is_key_on );
-        float Calc();
+        void  Prepare( VoiceBank* bank, int lane, int frames, float pitch_mod, const float* unison_ratio, int unison_num );
     };
 
     class VCF {
     private:
-        Filter* filter;
+        Envelope env_;          // フィルタエンベロープ
+        float    cutoff_nn_;    // カットオフ周波数（ノートNo単位）
+        float    resonance_;    // Q
+        float    env_amount_;   // エンベロープでカットオフを動かす幅（半音）
     public:
         VCF();
         ~VCF(){}
-        float Calc( float val );
+        void  Trigger();
+        void  Release();
+        void  SetParam( float cutoff_nn, float resonance, float env_amount );
+        void  SetEnvelope( int attack_ms, int decay_ms, float sustain_lv, int release_ms );
+        void  SetCurve( Envelope::Curve curve );
+        void  Reset();
+        void  Prepare( VoiceBank* bank, int lane, int frames, float cutoff_mod, int unison_num );
     };
 
     class VCA {
     private:
-        Envelope* env;
+        Envelope env_;
     public:
         VCA();
         ~VCA(){}
         void  Trigger();
         void  Release();
-        float Calc( float val );
+        void  SetEnvelope( int attack_ms, int decay_ms, float sustain_lv, int release_ms );
+        void  SetCurve( Envelope::Curve curve );
+        void  Reset();
+        void  Prepare( float* gain, int stride, int frames, float amp_from, float amp_to );
         bool  IsPlaying();
+        float GetLevel();
     };
 
+    // 変調用の2つ目のエンベロープ
     class EG {
     private:
-        float attack_, decay_, sustain_, release_;
+        Envelope env_;
     public:
-        EG(){}
+        EG();
         ~EG(){}
+        void  Trigger();
+        void  Release();
+        void  SetEnvelope( int attack_ms, int decay_ms, float sustain_lv, int release_ms );
+        void  SetCurve( Envelope::Curve curve );
+        void  Reset();
+        float Advance( int frames );
     };
 
 public:
-    Voice() {
-        voice_no_ = 0;
-        nn_       = 0;
-        velocity_ = 0;
-        key_on_   = false;
-    }
+    Voice();
     ~Voice(){}
 
+    static const int kLfoNum    = 2;
+    static const int kMaxUnison = 16;
+
     Voice::VCO vco;
     Voice::VCF vcf;
     Voice::VCA vca;
+    Voice::EG  eg;
+    Lfo        lfo1;
+    Lfo        lfo2;
 
     int  voice_no_;  // Voice No.
     int  nn_;        // Note No.
     int  velocity_;  // velocity when key on
     bool key_on_;    // if key on then true
 
+    // 横取り（発音中のボイスを別のノートに使う）時のフェードアウト
+    int  steal_fade_;      // フェードアウトの残りサンプル数
+    int  steal_fade_len_;  // フェードアウトの長さ
+    bool steal_pending_;   // フェードアウトが終わったらnn_/velocity_で発音する
+
+    void StartStolenNote( VoiceBank* bank );
+
+    // 変調（コントロールレートで求め、区間の中は直線で補間する）
+    const ModMatrix* mod_matrix_;  // nullptrなら変調しない
+    float mod_wheel_;              // 0～1
+    float aftertouch_;             // 0～1
+    float amp_mod_;                // 直前の区間の終わりでの音量の倍率
+    float pan_;                    // -1(左)～1(右)
+
+    // ユニゾン（voice_no_から連続したunison_num_個のレーンを、このボイスがまとめて鳴らす）
+    //   ノート毎の処理(波形テーブル選択、角速度、エンベロープ、変調)は1回だけ行い、各レーンへ配る
+    int      unison_num_;
+    float    unison_ratio_[kMaxUnison];  // レーン毎の角速度の倍率（デチューン）
+    float    unison_pan_[kMaxUnison];    // レーン毎の定位のずれ
+    float    unison_gain_;               // 重ねた分の音量の補正
+    bool     unison_random_phase_;       // ノートの始めに各レーンの位相をばらす（falseなら揃える）
+    bool     phase_reset_;               // 次のPrepareで各レーンの位相を決め直す
+    uint32_t rand_;                      // 位相用の乱数の状態
+
+    void ResetPhase( VoiceBank* bank );
 
     void Trigger(void);
     void Release();
 
     void SetNoteInfo(int nn,int velo);
-    void SetUnisonInfo(Voice* pMasterVoice, int unisonNum, int unisonNo);
+    void Steal( int nn, int velo, int fade_frames );
+    void SetUnison( int num, float detune_cent, float spread, bool random_phase );
+    void SetEnvelope( int attack_ms, int decay_ms, float sustain_lv, int release_ms );
+    void SetEnvelopeCurve( Envelope::Curve curve );
+    void SetFilter( float cutoff_nn, float resonance, float env_amount );
+    void SetFilterEnvelope( int attack_ms, int decay_ms, float sustain_lv, int release_ms );
+    void SetEnvelope2( int attack_ms, int decay_ms, float sustain_lv, int release_ms );
+    void SetLfo( int no, float rate_hz, Lfo::Shape shape, bool key_sync );
+    void SetModMatrix( const ModMatrix* matrix ) { mod_matrix_ = matrix; }
+    void SetController( float mod_wheel, float aftertouch );
 
     int  GetNoteNo(void) { return nn_; };    // 発振ノートNoを返す
+    float GetLevel() { return vca.GetLevel(); }  // アンプエンベロープの今のレベル
+    float GetPan( int unison_no = 0 );           // 変調後のパン（ユニゾンはレーン毎に広げる）
+    int   GetUnisonNum() { return unison_num_; }     // まとめて鳴らすレーン数
 
     int  GetNo(void) { return voice_no_; };  // ボイス番号を返す
-    void SetNo(int no) { voice_no_ = no; };  // ボイス番号を返す
+    void SetNo(int no) { voice_no_ = no; rand_ = 0x9E3779B9u * (no + 1); };  // ボイス番号を設定
 
-    float Calc();
+    void  Prepare( VoiceBank* bank, int offset, int frames );
     bool  IsPlaying();
     bool  IsKeyOn();
 };
@@ -0,0 +1,606 @@
+/**
+ * @file voice_bank.cpp
+ */
+#include <cstdint>
+#include <string.h>
+#include <math.h>
+
+#include "waveform.h"
+#include "voice_bank.h"
+#include "rt_thread.h"
+
+// コンパイル時に有効な命令セットで、一度に処理するボイス数(レーン幅)を決める
+#if defined(__AVX512F__)
+#include <immintrin.h>
+#define VB_LANE_WIDTH 16
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define VB_LANE_WIDTH 8
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VB_LANE_WIDTH 4
+#else
+#define VB_LANE_WIDTH 1
+#endif
+
+static_assert( VoiceBank::kLaneNum % VB_LANE_WIDTH == 0, "kLaneNum must be a multiple of the lane width" );
+static_assert( VoiceBank::kLaneNum <= 64, "active_mask is 64bit" );
+
+static const float kDenormalThreshold = 1.0e-20f;  // これより小さいフィルタ状態は0にする
+
+/**
+ * @brief constructor
+ *
+ * @param[in] wt_base 波形テーブルの先頭
+ * @param[in] fs      sample rate
+ */
+VoiceBank::VoiceBank( const float* wt_base, float fs )
+{
+    wt_base_ = wt_base;
+
+    // g = tan(π fc/fs)。ナイキスト周波数の手前で頭打ちにする
+    const int table_size = kCutoffNoteNum * kCutoffStepPerNote + 1;
+    for( int ix=0; ix<table_size; ix++ ) {
+        double nn = (double)ix / kCutoffStepPerNote;
+        double fc = 440.0 * pow( 2.0, (nn - 69.0) / 12.0 );
+        fc = (fc < fs * 0.49) ? fc : fs * 0.49;
+        svf_g_[ix] = (float)tan( 3.14159265358979 * fc / fs );
+    }
+
+    for( int ix=0; ix<=kPanTableSize; ix++ ) {
+        pan_sin_[ix] = (float)sin( 3.14159265358979 * 0.5 * ix / kPanTableSize );
+    }
+
+    for( int lane=0; lane<kLaneNum; lane++ ) {
+        phase_[lane]   = 0;
+        pan_[lane]     = 0.f;
+        pan_prev_[lane] = 0.f;
+        w_[lane]       = 0;
+        w_tgt_[lane]   = 0;
+        dw_[lane]      = 0;
+        tbl_ofs_[lane] = 0;
+        SetFilterBypass( lane );
+        ResetFilter( lane );
+    }
+    memset( gain_, 0, sizeof(gain_) );
+}
+
+/**
+ * @brief オシレータ設定
+ *
+ * @param[in] lane         ボイス番号
+ * @param[in] table_offset 波形テーブルのオフセット(Waveform::GetWTOffsetFromNN)
+ * @param[in] w            角速度(1周期＝WT_SIZEの16:16固定小数点表現)
+ * @param[in] ramp         trueなら次の区間の間に今の角速度から直線で移る（falseならすぐに変わる）
+ */
+void VoiceBank::SetOsc( int lane, int table_offset, uint32_t w, bool ramp )
+{
+    tbl_ofs_[lane] = table_offset;
+    w_tgt_[lane]   = w;
+    if( !ramp ) {
+        w_[lane] = w;
+    }
+}
+
+/**
+ * @brief 位相を設定する（ノートの始めに揃えたり、ばらしたりする）
+ *
+ * @param[in] lane  ボイス番号
+ * @param[in] phase 位相(16:16固定小数)
+ */
+void VoiceBank::SetPhase( int lane, uint32_t phase )
+{
+    phase_[lane] = phase;
+}
+
+/**
+ * @brief フィルタ(ローパス)設定
+ * @note  次のブロックの間に、今の係数からここで求めた係数へ滑らかに移る
+ *
+ * @param[in] lane      ボイス番号
+ * @param[in] cutoff_nn カットオフ周波数（ノートNo単位、0～kCutoffNoteNum）
+ * @param[in] q         レゾナンス(Q > 0)
+ */
+void VoiceBank::SetFilter( int lane, float cutoff_nn, float q )
+{
+    // テーブルを線形補間して引く（三角関数を使わない）
+    float pos = cutoff_nn * kCutoffStepPerNote;
+    pos = (pos < 0.f) ? 0.f : ((pos > kCutoffNoteNum * kCutoffStepPerNote) ? kCutoffNoteNum * kCutoffStepPerNote : pos);
+    int   idx  = (int)pos;
+    int   next = (idx < kCutoffNoteNum * kCutoffStepPerNote) ? idx + 1 : idx;
+    float g    = svf_g_[idx] + (svf_g_[next] - svf_g_[idx]) * (pos - idx);
+    float k    = 1.f / q;
+
+    float c1 = 1.f / (1.f + g * (g + k));
+    c1_tgt_[lane] = c1;
+    c2_tgt_[lane] = g * c1;
+    c3_tgt_[lane] = g * g * c1;
+    dry_[lane]    = 0.f;
+}
+
+/**
+ * @brief 別のボイスと同じフィルタ係数にする（係数を求め直さない）
+ * @note  src_laneのSetFilter/SetFilterBypassより後に呼ぶこと
+ *
+ * @param[in] lane     ボイス番号
+ * @param[in] src_lane 係数のコピー元
+ */
+void VoiceBank::CopyFilter( int lane, int src_lane )
+{
+    c1_tgt_[lane] = c1_tgt_[src_lane];
+    c2_tgt_[lane] = c2_tgt_[src_lane];
+    c3_tgt_[lane] = c3_tgt_[src_lane];
+    dry_[lane]    = dry_[src_lane];
+}
+
+/**
+ * @brief フィルタを通さない
+ */
+void VoiceBank::SetFilterBypass( int lane )
+{
+    c1_tgt_[lane] = 1.f;
+    c2_tgt_[lane] = 0.f;
+    c3_tgt_[lane] = 0.f;
+    dry_[lane]    = 1.f;
+}
+
+/**
+ * @brief フィルタ状態のクリア（係数も目標値へすぐに移る）
+ */
+void VoiceBank::ResetFilter( int lane )
+{
+    c1_[lane]  = c1_tgt_[lane];
+    c2_[lane]  = c2_tgt_[lane];
+    c3_[lane]  = c3_tgt_[lane];
+    ic1_[lane] = 0.f;
+    ic2_[lane] = 0.f;
+}
+
+/**
+ * @brief 定位の設定
+ * @note  Mixがブロックの間に今の定位からここで設定した定位へ滑らかに移る
+ *
+ * @param[in] lane ボイス番号
+ * @param[in] pan  -1(左)～1(右)
+ * @param[in] ramp falseならすぐに変わる
+ */
+void VoiceBank::SetPan( int lane, float pan, bool ramp )
+{
+    pan_[lane] = pan;
+    if( !ramp ) {
+        pan_prev_[lane] = pan;
+    }
+}
+
+/**
+ * @brief ゲイン列の先頭
+ *
+ * @param[in] lane ボイス番号
+ */
+float* VoiceBank::GainGet( int lane )
+{
+    return &gain_[(lane - lane % VB_LANE_WIDTH) * kMaxFrames + lane % VB_LANE_WIDTH];
+}
+
+/**
+ * @brief 全ボイスの状態と作業領域(gain_, mix_)を物理メモリに載せる（レンダリングを始める前に呼ぶ）
+ * @note  配列は全てこのオブジェクトの中にあるので、オブジェクト全体に書き込んでおけばよい
+ * @return プリフォルトしたバイト数
+ */
+size_t VoiceBank::Prefault()
+{
+    return RtThread::PrefaultWritable( this, sizeof(VoiceBank) );
+}
+
+/**
+ * @brief レーン幅（一度に処理するボイス数）
+ */
+int VoiceBank::LaneWidth()
+{
+    return VB_LANE_WIDTH;
+}
+
+/**
+ * @brief グループ数
+ */
+int VoiceBank::GroupNum()
+{
+    return kLaneNum / VB_LANE_WIDTH;
+}
+
+/**
+ * @brief active_maskのうち、グループに属するボイスのビットを取り出す
+ *
+ * @param[in] group       グループ番号
+ * @param[in] active_mask 発音中のボイス
+ * @retval bit n がグループ内n番目のボイスに対応
+ */
+uint32_t VoiceBank::GroupMask( int group, uint64_t active_mask )
+{
+    const uint32_t group_bits = (VB_LANE_WIDTH >= 32) ? 0xFFFFFFFF : ((1u << VB_LANE_WIDTH) - 1);
+    return (uint32_t)(active_mask >> (group * VB_LANE_WIDTH)) & group_bits;
+}
+
+/**
+ * @brief 発音中のボイスをまとめて処理し、MIX結果をoutへ書き込む
+ *
+ * @param[out] out         mono output
+ * @param[in]  frames      number of frames (<= kMaxFrames)
+ * @param[in]  active_mask 発音中のボイス(bit n がボイス番号nに対応)
+ */
+void VoiceBank::Render( float* out, int frames, uint64_t active_mask )
+{
+    for( int group=0; group<GroupNum(); group++ ) {
+        RenderGroup( group, 0, frames, active_mask );
+    }
+    Mix( &out, 1, frames, active_mask );
+}
+
+/**
+ * @brief 1グループ分のボイスを処理し、グループの途中MIX結果を求める
+ * @note  グループ毎に使う領域が分かれているので、別々のグループなら並行して呼んでよい
+ *
+ * @param[in] group       グループ番号
+ * @param[in] offset      ブロック先頭からの位置（ゲインとMIX結果のこの位置から処理する）
+ * @param[in] frames      number of frames (offset + frames <= kMaxFrames)
+ * @param[in] active_mask 発音中のボイス(bit n がボイス番号nに対応)
+ */
+void VoiceBank::RenderGroup( int group, int offset, int frames, uint64_t active_mask )
+{
+    uint32_t bits = GroupMask( group, active_mask );
+    if( bits == 0 ) {
+        return;  // 1ボイスも発音していないグループは処理しない
+    }
+
+    // グループ内の休止中ボイスは無音にする
+    const int lane = group * VB_LANE_WIDTH;
+    float* gain = &gain_[lane * kMaxFrames + offset * VB_LANE_WIDTH];
+    for( int ix=0; ix<VB_LANE_WIDTH; ix++ ) {
+        if( (bits & (1u << ix)) == 0 ) {
+            for( int t=0; t<frames; t++ ) {
+                gain[t*VB_LANE_WIDTH + ix] = 0.f;
+            }
+        }
+    }
+
+    // 角速度は区間の終わりで目標値に着くように増やす
+    const float inv = 1.f / frames;
+    for( int ix=lane; ix<lane+VB_LANE_WIDTH; ix++ ) {
+        dw_[ix] = (int32_t)((float)(int32_t)(w_tgt_[ix] - w_[ix]) * inv);
+    }
+
+    RenderLanes( lane, frames, gain, &mix_[lane * kMaxFrames + offset * VB_LANE_WIDTH] );
+
+    for( int ix=lane; ix<lane+VB_LANE_WIDTH; ix++ ) {
+        // 区間の終わりで係数は目標値に着いている（丸め誤差を残さない）
+        w_[ix]  = w_tgt_[ix];
+        c1_[ix] = c1_tgt_[ix];
+        c2_[ix] = c2_tgt_[ix];
+        c3_[ix] = c3_tgt_[ix];
+
+        // 無音が続いたときに非正規化数にならないようにする
+        if( fabsf( ic1_[ix] ) < kDenormalThreshold ) { ic1_[ix] = 0.f; }
+        if( fabsf( ic2_[ix] ) < kDenormalThreshold ) { ic2_[ix] = 0.f; }
+    }
+}
+
+/**
+ * @brief グループ毎の途中MIX結果をボイス毎の定位で各チャンネルへ振り分けて足し合わせ、outへ書き込む
+ * @note  足し込む順番はグループ番号順に固定（どのスレッドで処理したかによらず同じ結果になる）。
+ *        1チャンネルなら定位は無視してそのまま足す
+ *
+ * @param[out] out         チャンネル毎の出力(planar, channels個)
+ * @param[in]  channels    チャンネル数(1～kMaxChannels)
+ * @param[in]  frames      number of frames (<= kMaxFrames)
+ * @param[in]  active_mask RenderGroupに渡したものと同じ値
+ */
+void VoiceBank::Mix( float* const* out, int channels, int frames, uint64_t active_mask )
+{
+    for( int ch=0; ch<channels; ch++ ) {
+        memset( out[ch], 0, sizeof(float) * frames );
+    }
+
+    const float inv = 1.f / frames;
+    for( int group=0; group<GroupNum(); group++ ) {
+        if( GroupMask( group, active_mask ) == 0 ) {
+            continue;
+        }
+        const int    lane = group * VB_LANE_WIDTH;
+        const float* mix  = &mix_[lane * kMaxFrames];
+
+        if( channels == 1 ) {
+            for( int t=0; t<frames; t++ ) {
+                float val = out[0][t];
+                for( int ix=0; ix<VB_LANE_WIDTH; ix++ ) {
+                    val += mix[t*VB_LANE_WIDTH + ix];
+                }
+                out[0][t] = val;
+            }
+            continue;
+        }
+
+        // レーン毎のチャンネルゲインを、ブロックの始まりと終わりの定位から求めて直線で補間する
+        float gain[kMaxChannels][VB_LANE_WIDTH];
+        float step[kMaxChannels][VB_LANE_WIDTH];
+        for( int ix=0; ix<VB_LANE_WIDTH; ix++ ) {
+            float from[kMaxChannels];
+            float to[kMaxChannels];
+            PanGain( pan_prev_[lane + ix], channels, from );
+            PanGain( pan_[lane + ix], channels, to );
+            for( int ch=0; ch<channels; ch++ ) {
+                gain[ch][ix] = from[ch];
+                step[ch][ix] = (to[ch] - from[ch]) * inv;
+            }
+            pan_prev_[lane + ix] = pan_[lane + ix];
+        }
+
+        for( int ch=0; ch<channels; ch++ ) {
+            float* dst = out[ch];
+            float* g   = gain[ch];
+            float* dg  = step[ch];
+            for( int t=0; t<frames; t++ ) {
+                float val = dst[t];
+                for( int ix=0; ix<VB_LANE_WIDTH; ix++ ) {
+                    g[ix] += dg[ix];
+                    val   += mix[t*VB_LANE_WIDTH + ix] * g[ix];
+                }
+                dst[t] = val;
+            }
+        }
+    }
+}
+
+/**
+ * @brief 定位からチャンネル毎のゲインを求める（等パワー）
+ * @note  チャンネルを左から右へ並んでいるものとし、隣り合う2チャンネルの間でsin/cosで振り分ける。
+ *        2チャンネルなら中央で両方とも1/√2になる
+ *
+ * @param[in]  pan      -1(左端のチャンネル)～1(右端のチャンネル)
+ * @param[in]  channels チャンネル数(2～kMaxChannels)
+ * @param[out] gain     チャンネル毎のゲイン(channels個)
+ */
+void VoiceBank::PanGain( float pan, int channels, float* gain )
+{
+    float pos = (pan + 1.f) * 0.5f * (channels - 1);
+    pos = (pos < 0.f) ? 0.f : ((pos > channels - 1) ? (float)(channels - 1) : pos);
+    int   left = (int)pos;
+    left = (left < channels - 2) ? left : channels - 2;
+
+    // 2チャンネル間の位置(0～1)でテーブルを線形補間して引く
+    float x    = (pos - left) * kPanTableSize;
+    int   idx  = (int)x;
+    idx = (idx < kPanTableSize) ? idx : kPanTableSize - 1;
+    float frac = x - idx;
+    float sn   = pan_sin_[idx] + (pan_sin_[idx+1] - pan_sin_[idx]) * frac;
+    float cs   = pan_sin_[kPanTableSize-idx] + (pan_sin_[kPanTableSize-idx-1] - pan_sin_[kPanTableSize-idx]) * frac;
+
+    for( int ch=0; ch<channels; ch++ ) {
+        gain[ch] = 0.f;
+    }
+    gain[left]     = cs;
+    gain[left + 1] = sn;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// 1グループ(VB_LANE_WIDTHボイス)分の処理
+//   位相から波形テーブルを線形補間で読み出し -> SVF -> ゲイン を行い、mixへ書き込む
+//   SVFは v3 = x - ic2, v1 = c1*ic1 + c2*v3, v2 = ic2 + c2*ic1 + c3*v3, ic1 = 2*v1 - ic1, ic2 = 2*v2 - ic2
+//   出力は y = v2 + dry*(x - v2)
+
+#if VB_LANE_WIDTH == 16
+
+void VoiceBank::RenderLanes( int lane, int frames, const float* gain, float* mix )
+{
+    const __m512i idx_mask   = _mm512_set1_epi32( WT_SIZE-1 );
+    const __m512i frac_mask  = _mm512_set1_epi32( 0xFFFF );
+    const __m512i one        = _mm512_set1_epi32( 1 );
+    const __m512  frac_scale = _mm512_set1_ps( 1.f / 65536.f );
+
+    __m512i p   = _mm512_loadu_si512( &phase_[lane] );
+    __m512i w   = _mm512_loadu_si512( &w_[lane] );
+    __m512i dw  = _mm512_loadu_si512( &dw_[lane] );
+    __m512i ofs = _mm512_loadu_si512( &tbl_ofs_[lane] );
+    __m512  inv = _mm512_set1_ps( 1.f / frames );
+    __m512  c1  = _mm512_loadu_ps( &c1_[lane] );
+    __m512  c2  = _mm512_loadu_ps( &c2_[lane] );
+    __m512  c3  = _mm512_loadu_ps( &c3_[lane] );
+    __m512  d1  = _mm512_mul_ps( _mm512_sub_ps( _mm512_loadu_ps( &c1_tgt_[lane] ), c1 ), inv );
+    __m512  d2  = _mm512_mul_ps( _mm512_sub_ps( _mm512_loadu_ps( &c2_tgt_[lane] ), c2 ), inv );
+    __m512  d3  = _mm512_mul_ps( _mm512_sub_ps( _mm512_loadu_ps( &c3_tgt_[lane] ), c3 ), inv );
+    __m512  dry = _mm512_loadu_ps( &dry_[lane] );
+    __m512  ic1 = _mm512_loadu_ps( &ic1_[lane] );
+    __m512  ic2 = _mm512_loadu_ps( &ic2_[lane] );
+
+    for( int t=0; t<frames; t++ ) {
+        __m512i idx  = _mm512_srli_epi32( p, 16 );
+        __m512i i0   = _mm512_add_epi32( ofs, _mm512_and_si512( idx, idx_mask ) );
+        __m512i i1   = _mm512_add_epi32( ofs, _mm512_and_si512( _mm512_add_epi32( idx, one ), idx_mask ) );
+        __m512  s0   = _mm512_i32gather_ps( i0, wt_base_, 4 );
+        __m512  s1   = _mm512_i32gather_ps( i1, wt_base_, 4 );
+        __m512  frac = _mm512_mul_ps( _mm512_cvtepi32_ps( _mm512_and_si512( p, frac_mask ) ), frac_scale );
+        __m512  x    = _mm512_add_ps( s0, _mm512_mul_ps( _mm512_sub_ps( s1, s0 ), frac ) );
+
+        c1 = _mm512_add_ps( c1, d1 );
+        c2 = _mm512_add_ps( c2, d2 );
+        c3 = _mm512_add_ps( c3, d3 );
+        __m512  v3   = _mm512_sub_ps( x, ic2 );
+        __m512  v1   = _mm512_add_ps( _mm512_mul_ps( c1, ic1 ), _mm512_mul_ps( c2, v3 ) );
+        __m512  v2   = _mm512_add_ps( ic2, _mm512_add_ps( _mm512_mul_ps( c2, ic1 ), _mm512_mul_ps( c3, v3 ) ) );
+        ic1 = _mm512_sub_ps( _mm512_add_ps( v1, v1 ), ic1 );
+        ic2 = _mm512_sub_ps( _mm512_add_ps( v2, v2 ), ic2 );
+        __m512  y    = _mm512_add_ps( v2, _mm512_mul_ps( dry, _mm512_sub_ps( x, v2 ) ) );
+
+        __m512  g    = _mm512_loadu_ps( &gain[t*VB_LANE_WIDTH] );
+        _mm512_storeu_ps( &mix[t*VB_LANE_WIDTH], _mm512_mul_ps( y, g ) );
+
+        w = _mm512_add_epi32( w, dw );
+        p = _mm512_add_epi32( p, w );
+    }
+
+    _mm512_storeu_si512( &phase_[lane], p );
+    _mm512_storeu_ps( &ic1_[lane], ic1 );
+    _mm512_storeu_ps( &ic2_[lane], ic2 );
+}
+
+#elif VB_LANE_WIDTH == 8
+
+void VoiceBank::RenderLanes( int lane, int frames, const float* gain, float* mix )
+{
+    const __m256i idx_mask   = _mm256_set1_epi32( WT_SIZE-1 );
+    const __m256i frac_mask  = _mm256_set1_epi32( 0xFFFF );
+    const __m256i one        = _mm256_set1_epi32( 1 );
+    const __m256  frac_scale = _mm256_set1_ps( 1.f / 65536.f );
+
+    __m256i p   = _mm256_loadu_si256( (const __m256i*)&phase_[lane] );
+    __m256i w   = _mm256_loadu_si256( (const __m256i*)&w_[lane] );
+    __m256i dw  = _mm256_loadu_si256( (const __m256i*)&dw_[lane] );
+    __m256i ofs = _mm256_loadu_si256( (const __m256i*)&tbl_ofs_[lane] );
+    __m256  inv = _mm256_set1_ps( 1.f / frames );
+    __m256  c1  = _mm256_loadu_ps( &c1_[lane] );
+    __m256  c2  = _mm256_loadu_ps( &c2_[lane] );
+    __m256  c3  = _mm256_loadu_ps( &c3_[lane] );
+    __m256  d1  = _mm256_mul_ps( _mm256_sub_ps( _mm256_loadu_ps( &c1_tgt_[lane] ), c1 ), inv );
+    __m256  d2  = _mm256_mul_ps( _mm256_sub_ps( _mm256_loadu_ps( &c2_tgt_[lane] ), c2 ), inv );
+    __m256  d3  = _mm256_mul_ps( _mm256_sub_ps( _mm256_loadu_ps( &c3_tgt_[lane] ), c3 ), inv );
+    __m256  dry = _mm256_loadu_ps( &dry_[lane] );
+    __m256  ic1 = _mm256_loadu_ps( &ic1_[lane] );
+    __m256  ic2 = _mm256_loadu_ps( &ic2_[lane] );
+
+    for( int t=0; t<frames; t++ ) {
+        __m256i idx  = _mm256_srli_epi32( p, 16 );
+        __m256i i0   = _mm256_add_epi32( ofs, _mm256_and_si256( idx, idx_mask ) );
+        __m256i i1   = _mm256_add_epi32( ofs, _mm256_and_si256( _mm256_add_epi32( idx, one ), idx_mask ) );
+        __m256  s0   = _mm256_i32gather_ps( wt_base_, i0, 4 );
+        __m256  s1   = _mm256_i32gather_ps( wt_base_, i1, 4 );
+        __m256  frac = _mm256_mul_ps( _mm256_cvtepi32_ps( _mm256_and_si256( p, frac_mask ) ), frac_scale );
+        __m256  x    = _mm256_add_ps( s0, _mm256_mul_ps( _mm256_sub_ps( s1, s0 ), frac ) );
+
+        c1 = _mm256_add_ps( c1, d1 );
+        c2 = _mm256_add_ps( c2, d2 );
+        c3 = _mm256_add_ps( c3, d3 );
+        __m256  v3   = _mm256_sub_ps( x, ic2 );
+        __m256  v1   = _mm256_add_ps( _mm256_mul_ps( c1, ic1 ), _mm256_mul_ps( c2, v3 ) );
+        __m256  v2   = _mm256_add_ps( ic2, _mm256_add_ps( _mm256_mul_ps( c2, ic1 ), _mm256_mul_ps( c3, v3 ) ) );
+        ic1 = _mm256_sub_ps( _mm256_add_ps( v1, v1 ), ic1 );
+        ic2 = _mm256_sub_ps( _mm256_add_ps( v2, v2 ), ic2 );
+        __m256  y    = _mm256_add_ps( v2, _mm256_mul_ps( dry, _mm256_sub_ps( x, v2 ) ) );
+
+        __m256  g    = _mm256_loadu_ps( &gain[t*VB_LANE_WIDTH] );
+        _mm256_storeu_ps( &mix[t*VB_LANE_WIDTH], _mm256_mul_ps( y, g ) );
+
+        w = _mm256_add_epi32( w, dw );
+        p = _mm256_add_epi32( p, w );
+    }
+
+    _mm256_storeu_si256( (__m256i*)&phase_[lane], p );
+    _mm256_storeu_ps( &ic1_[lane], ic1 );
+    _mm256_storeu_ps( &ic2_[lane], ic2 );
+}
+
+#elif VB_LANE_WIDTH == 4
+
+void VoiceBank::RenderLanes( int lane, int frames, const float* gain, float* mix )
+{
+    const __m128i idx_mask   = _mm_set1_epi32( WT_SIZE-1 );
+    const __m128i frac_mask  = _mm_set1_epi32( 0xFFFF );
+    const __m128i one        = _mm_set1_epi32( 1 );
+    const __m128  frac_scale = _mm_set1_ps( 1.f / 65536.f );
+
+    __m128i p   = _mm_loadu_si128( (const __m128i*)&phase_[lane] );
+    __m128i w   = _mm_loadu_si128( (const __m128i*)&w_[lane] );
+    __m128i dw  = _mm_loadu_si128( (const __m128i*)&dw_[lane] );
+    __m128i ofs = _mm_loadu_si128( (const __m128i*)&tbl_ofs_[lane] );
+    __m128  inv = _mm_set1_ps( 1.f / frames );
+    __m128  c1  = _mm_loadu_ps( &c1_[lane] );
+    __m128  c2  = _mm_loadu_ps( &c2_[lane] );
+    __m128  c3  = _mm_loadu_ps( &c3_[lane] );
+    __m128  d1  = _mm_mul_ps( _mm_sub_ps( _mm_loadu_ps( &c1_tgt_[lane] ), c1 ), inv );
+    __m128  d2  = _mm_mul_ps( _mm_sub_ps( _mm_loadu_ps( &c2_tgt_[lane] ), c2 ), inv );
+    __m128  d3  = _mm_mul_ps( _mm_sub_ps( _mm_loadu_ps( &c3_tgt_[lane] ), c3 ), inv );
+    __m128  dry = _mm_loadu_ps( &dry_[lane] );
+    __m128  ic1 = _mm_loadu_ps( &ic1_[lane] );
+    __m128  ic2 = _mm_loadu_ps( &ic2_[lane] );
+
+    alignas(16) int32_t i0[4];
+    alignas(16) int32_t i1[4];
+
+    for( int t=0; t<frames; t++ ) {
+        // SSEにはgatherが無いので、インデックスだけベクトルで求めて個別に読む
+        __m128i idx  = _mm_srli_epi32( p, 16 );
+        _mm_store_si128( (__m128i*)i0, _mm_add_epi32( ofs, _mm_and_si128( idx, idx_mask ) ) );
+        _mm_store_si128( (__m128i*)i1, _mm_add_epi32( ofs, _mm_and_si128( _mm_add_epi32( idx, one ), idx_mask ) ) );
+        __m128  s0   = _mm_setr_ps( wt_base_[i0[0]], wt_base_[i0[1]], wt_base_[i0[2]], wt_base_[i0[3]] );
+        __m128  s1   = _mm_setr_ps( wt_base_[i1[0]], wt_base_[i1[1]], wt_base_[i1[2]], wt_base_[i1[3]] );
+        __m128  frac = _mm_mul_ps( _mm_cvtepi32_ps( _mm_and_si128( p, frac_mask ) ), frac_scale );
+        __m128  x    = _mm_add_ps( s0, _mm_mul_ps( _mm_sub_ps( s1, s0 ), frac ) );
+
+        c1 = _mm_add_ps( c1, d1 );
+        c2 = _mm_add_ps( c2, d2 );
+        c3 = _mm_add_ps( c3, d3 );
+        __m128  v3   = _mm_sub_ps( x, ic2 );
+        __m128  v1   = _mm_add_ps( _mm_mul_ps( c1, ic1 ), _mm_mul_ps( c2, v3 ) );
+        __m128  v2   = _mm_add_ps( ic2, _mm_add_ps( _mm_mul_ps( c2, ic1 ), _mm_mul_ps( c3, v3 ) ) );
+        ic1 = _mm_sub_ps( _mm_add_ps( v1, v1 ), ic1 );
+        ic2 = _mm_sub_ps( _mm_add_ps( v2, v2 ), ic2 );
+        __m128  y    = _mm_add_ps( v2, _mm_mul_ps( dry, _mm_sub_ps( x, v2 ) ) );
+
+        __m128  g    = _mm_loadu_ps( &gain[t*VB_LANE_WIDTH] );
+        _mm_storeu_ps( &mix[t*VB_LANE_WIDTH], _mm_mul_ps( y, g ) );
+
+        w = _mm_add_epi32( w, dw );
+        p = _mm_add_epi32( p, w );
+    }
+
+    _mm_storeu_si128( (__m128i*)&phase_[lane], p );
+    _mm_storeu_ps( &ic1_[lane], ic1 );
+    _mm_storeu_ps( &ic2_[lane], ic2 );
+}
+
+#else
+
+void VoiceBank::RenderLanes( int lane, int frames, const float* gain, float* mix )
+{
+    uint32_t     p    = phase_[lane];
+    uint32_t     w    = w_[lane];
+    uint32_t     dw   = (uint32_t)dw_[lane];
+    const float* tbl  = wt_base_ + tbl_ofs_[lane];
+    float        inv  = 1.f / frames;
+    float        c1   = c1_[lane];
+    float        c2   = c2_[lane];
+    float        c3   = c3_[lane];
+    float        d1   = (c1_tgt_[lane] - c1) * inv;
+    float        d2   = (c2_tgt_[lane] - c2) * inv;
+    float        d3   = (c3_tgt_[lane] - c3) * inv;
+    float        dry  = dry_[lane];
+    float        ic1  = ic1_[lane];
+    float        ic2  = ic2_[lane];
+
+    for( int t=0; t<frames; t++ ) {
+        uint32_t idx  = p >> 16;
+        float    s0   = tbl[idx & (WT_SIZE-1)];
+        float    s1   = tbl[(idx+1) & (WT_SIZE-1)];
+        float    frac = (float)(p & 0xFFFF) * (1.f / 65536.f);
+        float    x    = s0 + (s1 - s0) * frac;
+
+        c1 += d1;
+        c2 += d2;
+        c3 += d3;
+        float    v3   = x - ic2;
+        float    v1   = c1 * ic1 + c2 * v3;
+        float    v2   = ic2 + c2 * ic1 + c3 * v3;
+        ic1 = 2.f * v1 - ic1;
+        ic2 = 2.f * v2 - ic2;
+        float    y    = v2 + dry * (x - v2);
+
+        mix[t] = y * gain[t];
+
+        w += dw;
+        p += w;
+    }
+
+    phase_[lane] = p;
+    ic1_[lane]   = ic1;
+    ic2_[lane]   = ic2;
+}
+
+#endif
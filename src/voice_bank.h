@@ -0,0 +1,96 @@
+/**
+ * @file voice_bank.h
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "audio.h"
+
+/**
+ * @class VoiceBank
+ * @brief 全ボイスの信号処理用の状態(位相、角速度、フィルタ係数/状態、ゲイン)をボイス毎の連続した配列で保持し、
+ *        複数ボイスをまとめてSIMD(SSE:4, AVX2:8, AVX-512:16ボイス)で処理する
+ */
+class VoiceBank {
+public:
+    static const int kLaneNum    = 64;  // 保持できるボイス数（SIMD幅の倍数であること）
+    static const int kMaxFrames  = AudioCtrl::kMaxBlockFrames;
+    static const int kMaxChannels = 8;   // Mixで書き出せる最大チャンネル数
+
+    // カットオフ係数テーブルの範囲（ノートNo 0～kCutoffNoteNum、1/kCutoffStepPerNote半音刻み）
+    static const int kCutoffNoteNum     = 136;
+    static const int kCutoffStepPerNote = 8;
+
+    VoiceBank( const float* wt_base, float fs );
+    ~VoiceBank(){}
+
+    void SetOsc( int lane, int table_offset, uint32_t w, bool ramp = false );
+    void SetPhase( int lane, uint32_t phase );
+    void SetFilter( int lane, float cutoff_nn, float q );
+    void CopyFilter( int lane, int src_lane );
+    void SetFilterBypass( int lane );
+    void ResetFilter( int lane );
+    void SetPan( int lane, float pan, bool ramp = false );
+
+    // ゲイン列（GainStride()間隔でframes個並ぶ）の先頭を返す
+    float* GainGet( int lane );
+    static int GainStride() { return LaneWidth(); }
+
+    void Render( float* out, int frames, uint64_t active_mask );  // モノラル（パンは無視する）
+
+    // グループ単位の処理（グループ毎に別スレッドから呼んでよい）
+    // offsetからframes分ずつ区切って呼べば、区切り毎にパラメータを変えられる（コントロールレート）
+    void RenderGroup( int group, int offset, int frames, uint64_t active_mask );
+    void Mix( float* const* out, int channels, int frames, uint64_t active_mask );
+
+    size_t Prefault();  // 状態とゲイン/MIXの作業領域を物理メモリに載せる。戻り値はバイト数
+
+    static int LaneWidth();
+    static int GroupNum();
+    static uint32_t GroupMask( int group, uint64_t active_mask );
+
+private:
+    const float* wt_base_;  // 波形テーブルの先頭
+
+    // oscillator
+    alignas(64) uint32_t phase_[kLaneNum];    // 位相(16:16固定小数)
+    alignas(64) uint32_t w_[kLaneNum];        // 角速度（現在値）
+    alignas(64) uint32_t w_tgt_[kLaneNum];    // 角速度（区間の終わりでの目標値）
+    alignas(64) int32_t  dw_[kLaneNum];       // 1サンプル毎の角速度の増分
+    alignas(64) int32_t  tbl_ofs_[kLaneNum];  // wt_base_からの波形テーブルのオフセット
+
+    // state variable filter(TPTのローパス)
+    //   係数はブロック毎に目標値を設定し、ブロックの間は直前の値から1サンプル毎に直線で近づける
+    alignas(64) float c1_[kLaneNum];      // 係数（現在値）
+    alignas(64) float c2_[kLaneNum];
+    alignas(64) float c3_[kLaneNum];
+    alignas(64) float c1_tgt_[kLaneNum];  // 係数（ブロック終わりでの目標値）
+    alignas(64) float c2_tgt_[kLaneNum];
+    alignas(64) float c3_tgt_[kLaneNum];
+    alignas(64) float dry_[kLaneNum];     // 1ならバイパス、0ならフィルタ出力
+    alignas(64) float ic1_[kLaneNum];     // 積分器の状態
+    alignas(64) float ic2_[kLaneNum];
+
+    // カットオフ(ノートNo)からtan(π fc/fs)を引くテーブル
+    float svf_g_[kCutoffNoteNum * kCutoffStepPerNote + 1];
+
+    // 定位（Mixでブロックの間に直前の値から直線で移す）
+    alignas(64) float pan_[kLaneNum];       // -1(左)～1(右)。ブロックの終わりでの値
+    alignas(64) float pan_prev_[kLaneNum];  // ブロックの始まりでの値
+
+    // 等パワーのパン用の sin(x π/2) (x=0～1) のテーブル
+    static const int kPanTableSize = 256;
+    float pan_sin_[kPanTableSize + 1];
+
+    void PanGain( float pan, int channels, float* gain );
+
+    // 1ブロック分のゲイン（グループ毎に[frame][lane幅]の順）
+    alignas(64) float gain_[kMaxFrames * kLaneNum];
+
+    // グループ毎の途中MIX結果（グループ毎に[frame][lane幅]の順）
+    alignas(64) float mix_[kMaxFrames * kLaneNum];
+
+    void RenderLanes( int lane, int frames, const float* gain, float* mix );
+};
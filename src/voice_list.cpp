@@ -0,0 +1,88 @@
+/**
+ * @file voice_list.cpp
+ */
+#include "voice_list.h"
+
+const int VoiceList::kMaxVoices;
+const int VoiceList::kNone;
+
+/**
+ * @brief constructor
+ */
+VoiceList::VoiceList()
+{
+    Clear();
+}
+
+/**
+ * @brief 最新として追加する
+ *
+ * @param[in] no ボイス番号(0～kMaxVoices-1)
+ */
+void VoiceList::PushBack( int no )
+{
+    Remove( no );
+
+    prev_[no] = (int8_t)tail_;
+    next_[no] = kNone;
+    if( tail_ != kNone ) {
+        next_[tail_] = (int8_t)no;
+    }
+    else {
+        head_ = no;
+    }
+    tail_    = no;
+    member_ |= (1ull << no);
+    num_++;
+}
+
+/**
+ * @brief リストから外す
+ *
+ * @param[in] no ボイス番号
+ */
+void VoiceList::Remove( int no )
+{
+    if( !Contains( no ) ) {
+        return;
+    }
+
+    int prev = prev_[no];
+    int next = next_[no];
+    if( prev != kNone ) { next_[prev] = (int8_t)next; }
+    else                { head_ = next; }
+    if( next != kNone ) { prev_[next] = (int8_t)prev; }
+    else                { tail_ = prev; }
+
+    member_ &= ~(1ull << no);
+    num_--;
+}
+
+/**
+ * @brief 最古のボイスを取り出す
+ *
+ * @retval ボイス番号。空ならkNone
+ */
+int VoiceList::PopFront()
+{
+    int no = head_;
+    if( no != kNone ) {
+        Remove( no );
+    }
+    return no;
+}
+
+/**
+ * @brief 空にする
+ */
+void VoiceList::Clear()
+{
+    for( int ix=0; ix<kMaxVoices; ix++ ) {
+        prev_[ix] = kNone;
+        next_[ix] = kNone;
+    }
+    head_   = kNone;
+    tail_   = kNone;
+    num_    = 0;
+    member_ = 0;
+}
@@ -0,0 +1,41 @@
+/**
+ * @file voice_list.h
+ */
+#pragma once
+
+#include <cstdint>
+
+/**
+ * @class VoiceList
+ * @brief ボイス番号の古い順リスト（固定長、メモリ確保をしない）
+ * @note  ボイス番号毎に前後の番号を持つ双方向リスト。追加、削除、最古の取り出しはO(1)
+ */
+class VoiceList {
+public:
+    static const int kMaxVoices = 64;
+    static const int kNone      = -1;
+
+    VoiceList();
+    ~VoiceList(){}
+
+    void PushBack( int no );  // 最新として追加（既にあれば最新へ移す）
+    void Remove( int no );    // 無ければ何もしない
+    int  PopFront();          // 最古を取り出す（空ならkNone）
+    void Clear();
+
+    bool Contains( int no ) { return (member_ & (1ull << no)) != 0; }
+    bool IsEmpty()          { return head_ == kNone; }
+    int  GetNum()           { return num_; }
+
+    // 古い順にたどる（たどっている途中でRemoveする時は、先にNextを求めておくこと）
+    int  First()            { return head_; }
+    int  Next( int no )     { return next_[no]; }
+
+private:
+    int8_t   prev_[kMaxVoices];
+    int8_t   next_[kMaxVoices];
+    int      head_;    // 最古
+    int      tail_;    // 最新
+    int      num_;
+    uint64_t member_;  // リストにあるボイス（bit n がボイス番号n）
+};
@@ -0,0 +1,170 @@
+/**
+ * @file wav_writer.cpp
+ */
+#include <string.h>
+#include <math.h>
+
+#include "common.h"
+#include "wav_writer.h"
+
+static void wav_put_le( uint8_t* p, uint32_t val, int size );
+
+/**
+ * @brief constructor
+ */
+WavWriter::WavWriter()
+{
+    fp_        = nullptr;
+    channels_  = 0;
+    format_    = kFloat32;
+    bytes_     = 4;
+    frame_num_ = 0;
+}
+
+/**
+ * @brief destructor
+ */
+WavWriter::~WavWriter()
+{
+    Close();
+}
+
+/**
+ * @brief 書き出しを始める
+ *
+ * @param[in] path
+ * @param[in] fs       sample rate
+ * @param[in] channels
+ * @param[in] format   kFloat32, kPcm16, kPcm24
+ * @retval true  成功
+ * @retval false 失敗
+ */
+bool WavWriter::Open( const char* path, int fs, int channels, int format )
+{
+    Close();
+
+    fp_ = fopen( path, "wb" );
+    if( !fp_ ) {
+        fprintf(stderr, "unable to open %s\n", path);
+        return false;
+    }
+
+    channels_  = channels;
+    format_    = format;
+    bytes_     = (format == kPcm16) ? 2 : ((format == kPcm24) ? 3 : 4);
+    frame_num_ = 0;
+
+    // サイズは仮の値で書いておく
+    uint8_t header[44];
+    uint32_t block_align = channels_ * bytes_;
+    memcpy( &header[0], "RIFF", 4 );
+    wav_put_le( &header[4], 0, 4 );
+    memcpy( &header[8], "WAVE", 4 );
+    memcpy( &header[12], "fmt ", 4 );
+    wav_put_le( &header[16], 16, 4 );
+    wav_put_le( &header[20], (format_ == kFloat32) ? 3 : 1, 2 );  // 3: IEEE float, 1: PCM
+    wav_put_le( &header[22], channels_, 2 );
+    wav_put_le( &header[24], fs, 4 );
+    wav_put_le( &header[28], fs * block_align, 4 );
+    wav_put_le( &header[32], block_align, 2 );
+    wav_put_le( &header[34], bytes_ * 8, 2 );
+    memcpy( &header[36], "data", 4 );
+    wav_put_le( &header[40], 0, 4 );
+
+    if( fwrite( header, 1, sizeof(header), fp_ ) != sizeof(header) ) {
+        fprintf(stderr, "unable to write %s\n", path);
+        fclose( fp_ );
+        fp_ = nullptr;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief サンプルを書き込む（整数フォーマットでは±1.0を超える値は飽和させる）
+ *
+ * @param[in] buf    インターリーブ形式
+ * @param[in] frames
+ * @retval true  成功
+ * @retval false 失敗
+ */
+bool WavWriter::Write( const float* buf, int frames )
+{
+    if( !fp_ ) {
+        return false;
+    }
+
+    int total = frames * channels_;
+    while( total > 0 ) {
+        int num = MIN( total, kBufSize );
+        for( int ix=0; ix<num; ix++ ) {
+            float val = buf[ix];
+            uint8_t* p = &buf_[ix * bytes_];
+            if( format_ == kFloat32 ) {
+                memcpy( p, &val, 4 );  // little endianの環境を前提とする
+            }
+            else {
+                // 最も近い整数へ丸める（SampleConverterと同じ）
+                val = MAX( -1.f, MIN( val, 1.f ) );
+                if( format_ == kPcm16 ) { wav_put_le( p, (uint32_t)(int32_t)lrintf( val * 32767.f ), 2 ); }
+                else                    { wav_put_le( p, (uint32_t)(int32_t)lrintf( val * 8388607.f ), 3 ); }
+            }
+        }
+        if( fwrite( buf_, bytes_, num, fp_ ) != (size_t)num ) {
+            fprintf(stderr, "unable to write wav data\n");
+            return false;
+        }
+        buf   += num;
+        total -= num;
+    }
+
+    frame_num_ += frames;
+    return true;
+}
+
+/**
+ * @brief ヘッダのサイズを確定させて閉じる
+ *
+ * @retval true  成功
+ * @retval false 失敗
+ */
+bool WavWriter::Close()
+{
+    if( !fp_ ) {
+        return true;
+    }
+
+    bool ret = WriteHeader();
+    fclose( fp_ );
+    fp_ = nullptr;
+    return ret;
+}
+
+/**
+ * @brief RIFF/dataチャンクのサイズを書き込む
+ */
+bool WavWriter::WriteHeader()
+{
+    uint32_t data_size = (uint32_t)(frame_num_ * channels_ * bytes_);
+    uint8_t  size[4];
+
+    wav_put_le( size, 36 + data_size, 4 );
+    if( fseek( fp_, 4, SEEK_SET ) != 0 || fwrite( size, 1, 4, fp_ ) != 4 ) {
+        return false;
+    }
+    wav_put_le( size, data_size, 4 );
+    if( fseek( fp_, 40, SEEK_SET ) != 0 || fwrite( size, 1, 4, fp_ ) != 4 ) {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief リトルエンディアンで書く
+ */
+static void wav_put_le( uint8_t* p, uint32_t val, int size )
+{
+    for( int ix=0; ix<size; ix++ ) {
+        p[ix] = (val >> (ix * 8)) & 0xFF;
+    }
+}
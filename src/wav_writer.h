@@ -0,0 +1,44 @@
+/**
+ * @file wav_writer.h
+ */
+#pragma once
+
+#include <cstdio>
+#include <cstdint>
+
+/**
+ * @class WavWriter
+ * @brief WAVファイルへの逐次書き出し（ヘッダのサイズはCloseで確定させる）
+ */
+class WavWriter {
+public:
+    enum {
+        kFloat32 = 0,  // 32bit float
+        kPcm16,        // 16bit integer
+        kPcm24         // 24bit integer
+    };
+
+    WavWriter();
+    ~WavWriter();
+
+    bool Open( const char* path, int fs, int channels, int format );
+    bool Write( const float* buf, int frames );  // framesフレーム分（インターリーブ）
+    bool Close();
+
+    uint64_t GetFrameNum() { return frame_num_; }
+
+private:
+    WavWriter(const WavWriter&);
+    WavWriter& operator=(const WavWriter&);
+
+    FILE*    fp_;
+    int      channels_;
+    int      format_;
+    int      bytes_;      // 1サンプルのバイト数
+    uint64_t frame_num_;  // 書き込んだフレーム数
+
+    static const int kBufSize = 4096;  // 1回の変換で扱うサンプル数
+    uint8_t buf_[kBufSize * 4];        // 1サンプル最大4バイト(kFloat32)
+
+    bool WriteHeader();
+};
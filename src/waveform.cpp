@@ -5,18 +5,56 @@
  * @note  this class is singleton
  */
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include <cstdint>
 #include <math.h>
+#include <thread>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 #include "common.h"
+#include "fastmath.h"
+#include "render_pool.h"
 #include "waveform.h"
 
-#define _SIN(a) (wt_sine_[(a) % WT_SIZE])   // sin()関数の代わりにテーブルを使い、テーブル生成を高速化
+Waveform*   Waveform::instance_  = nullptr;
+const char* Waveform::cache_dir_ = nullptr;
+
+// キャッシュファイルの形式（テーブルの中身や並びを変えたらkCacheVersionを上げる）
+static const char     kCacheMagic[4]   = { 'S', '9', 'R', 'W' };
+static const uint32_t kCacheVersion    = 1;
+static const uint32_t kCacheDataOffset = 4096;  // テーブルはページ境界から置く
+
+struct WaveformCacheHeader {
+    char     magic[4];
+    uint32_t version;
+    uint32_t wt_size;
+    uint32_t table_num;
+    float    fs;
+    uint32_t data_offset;
+    uint64_t data_bytes;
+};
 
-Waveform* Waveform::instance_ = nullptr;
+/**
+ * @brief 並列にテーブルを生成する時のジョブの引数
+ */
+struct WaveformGenContext {
+    Waveform*     wf;
+    float*        buf;
+    const double* twiddle;  // e^(j2πk/WT_SIZE) (k=0～WT_SIZE/2-1) の実部と虚部
+};
 
 static float fastsin( unsigned int phase );
+static void  waveform_ifft( double* re, double* im, const double* twiddle );
+static bool  waveform_mkdirs( const char* dir );
 
 Waveform* Waveform::Create( float tuning, float fs )
 {
@@ -34,6 +72,19 @@ void Waveform::Destroy()
     instance_ = nullptr;
 }
 
+/**
+ * @brief destructor
+ */
+Waveform::~Waveform()
+{
+#ifndef _WIN32
+    if( wt_map_ ) {
+        munmap( wt_map_, wt_map_bytes_ );
+    }
+#endif
+    delete[] wt_heap_;
+}
+
 Waveform* Waveform::GetInstance()
 {
     return instance_;
@@ -41,6 +92,7 @@ Waveform* Waveform::GetInstance()
 
 /**
  * @brief initialize class
+ * @note  キャッシュがあればmapして使い、無ければ生成して保存する
  * @param freq
  * @param fs
  */
@@ -49,24 +101,20 @@ void Waveform::Initialize( float tuning, float fs )
     tuning_ = tuning;
     fs_     = fs;
 
-    // サイン波テーブル生成
-    for( int ix=0; ix<WT_SIZE; ix++ ) {
-#if 0
-        wt_sine_[ix] = fastsin( (UINT32_MAX / WT_SIZE) * ix );
-#else
-        wt_sine_[ix] = sin( 2.f * PI * ix / WT_SIZE );
-#endif
-    }
+    wt_heap_      = nullptr;
+    wt_map_       = nullptr;
+    wt_map_bytes_ = 0;
+
     // 波形テーブル情報表（30Hz～22.05KHzを複数の帯域に分割しそれぞれの帯域の情報を記した表）を計算する。
-    // ※この計算方法では、入力パラメタとして90分割を与えた場合、68分割に最適化される
+    // ※この計算方法では、入力パラメタとして90分割を与えた場合、68分割に最適化される(fs=48kHz)
     wt_info_num_      = 0;
     int   oldHarmoNum = -1;
     int   jx           = 0;
     float minFreq     = 30.f;
 
-    for(int ix=0; ix<90; ix++) {
+    for(int ix=0; ix<kBandDiv; ix++) {
         // テーブル情報を計算
-        wt_info_[jx].freq     = minFreq * pow(fs/2/minFreq,(float)ix/90);
+        wt_info_[jx].freq     = minFreq * pow(fs/2/minFreq,(float)ix/kBandDiv);
         wt_info_[jx].harmoNum = (int)(fs/2/wt_info_[jx].freq);
         wt_info_[jx].offset   = jx * WT_SIZE;
 
@@ -79,15 +127,99 @@ void Waveform::Initialize( float tuning, float fs )
         wt_info_[jx].noteNo = 69.f + 12.f * log(wt_info_[jx].freq / 440.f) / log(2.f);
         jx++;
     }
-    wt_info_num_ = jx;
+    wt_info_num_  = jx;
+    wt_table_num_ = 1 + wt_info_num_ * 3;
+
+    // ノートNoからテーブル情報表の行を引くための索引を作る
+    for( int ix=0, row=0; ix<kNNIndexMax*kNNIndexRes; ix++ ) {
+        float nn_lower = (float)ix / kNNIndexRes;
+        while( row < wt_info_num_ && wt_info_[row].noteNo < nn_lower ) {
+            row++;
+        }
+        wt_index_[ix] = row;
+    }
 
-    // 周波数帯域毎に、三角波、ノコギリ波、矩形波テーブルを生成
-    for(int ix=0; ix<wt_info_num_; ix++){
-        GenTblTriangle(&wt_triangle_[WT_SIZE * ix], wt_info_[ix].harmoNum);
-        GenTblSaw(&wt_saw_[WT_SIZE * ix], wt_info_[ix].harmoNum);
-        GenTblSquare(&wt_square_[WT_SIZE * ix], wt_info_[ix].harmoNum);
+    if( LoadCache() ) {
+        return;
     }
 
+    wt_heap_ = new float[WT_SIZE * wt_table_num_];
+    GenTables( wt_heap_ );
+    SetTables( wt_heap_ );
+    SaveCache( wt_heap_ );
+}
+
+/**
+ * @brief 全波形テーブルの中での各テーブルの位置を決める
+ */
+void Waveform::SetTables( const float* buf )
+{
+    wt_buf_      = buf;
+    wt_sine_     = &buf[0];
+    wt_triangle_ = &buf[WT_SIZE];
+    wt_saw_      = &buf[WT_SIZE*(1+wt_info_num_)];
+    wt_square_   = &buf[WT_SIZE*(1+wt_info_num_*2)];
+}
+
+/**
+ * @brief 全波形テーブルを生成する
+ * @note  帯域・波形毎のテーブルは、スレッドに分けて逆FFTで作る
+ *
+ * @param[out] buf 書き込み先(WT_SIZE * wt_table_num_)
+ */
+void Waveform::GenTables( float* buf )
+{
+    // サイン波テーブル生成
+    for( int ix=0; ix<WT_SIZE; ix++ ) {
+#if 0
+        buf[ix] = fastsin( (UINT32_MAX / WT_SIZE) * ix );
+#else
+        buf[ix] = sin( 2.f * PI * ix / WT_SIZE );
+#endif
+    }
+
+    // 逆FFTの回転因子
+    double twiddle[WT_SIZE];
+    for( int ix=0; ix<WT_SIZE/2; ix++ ) {
+        twiddle[ix*2]     = cos( 2.0 * M_PI * ix / WT_SIZE );
+        twiddle[ix*2 + 1] = sin( 2.0 * M_PI * ix / WT_SIZE );
+    }
+
+    // 周波数帯域毎に、三角波、ノコギリ波、矩形波テーブルを生成
+    WaveformGenContext ctx = { this, buf, twiddle };
+    RenderPool pool( (int)MAX( 1u, std::thread::hardware_concurrency() ) );
+    pool.Run( GenTableJob, &ctx, wt_info_num_ * 3 );
+}
+
+/**
+ * @brief テーブル1つ分のジョブ（job = 波形 * 帯域数 + 帯域）
+ */
+void Waveform::GenTableJob( int job, void* userdata )
+{
+    WaveformGenContext* ctx = (WaveformGenContext*)userdata;
+    Waveform* wf   = ctx->wf;
+    int       band = job % wf->wt_info_num_;
+    int       type = job / wf->wt_info_num_;
+    int       kind = (type == 0) ? wf->WF_TRI : ((type == 1) ? wf->WF_SAW : wf->WF_SQUARE);
+
+    float* p_buf = &ctx->buf[WT_SIZE * (1 + job)];
+    wf->GenTable( p_buf, kind, wf->wt_info_[band].harmoNum, ctx->twiddle );
+}
+
+/**
+ * @brief NoteNumberに対応するテーブル情報表の行（nn <= noteNo となる最初の行）を求める
+ * @param nn  Note number
+ * @retval wt_info_num_ なら、どの帯域よりも高い
+ */
+int Waveform::GetWTInfoFromNN( float nn )
+{
+    // 索引で候補の行を求め、区間内の境界の分だけ進める（1区間に境界は高々1つなので、ほぼ1回で終わる）
+    int ix  = (nn > 0.f) ? (int)(nn * kNNIndexRes) : 0;
+    int row = wt_index_[MIN( ix, kNNIndexMax*kNNIndexRes - 1 )];
+    while( row < wt_info_num_ && nn > wt_info_[row].noteNo ) {
+        row++;
+    }
+    return row;
 }
 
 /**
@@ -95,17 +227,16 @@ void Waveform::Initialize( float tuning, float fs )
  * @param wf  波形の種類
  * @param nn  Note number
  */
-float* Waveform::GetWTFromNN( int wf, float nn )
+const float* Waveform::GetWTFromNN( int wf, float nn )
 {
     if(wf==WF_SINE){
         return &wt_sine_[0];
     }
     else{
-        float* p_tbl = (wf==WF_TRI) ? &wt_triangle_[0] : ((wf==WF_SAW) ? &wt_saw_[0] : &wt_square_[0]);
-        for( int ix=0; ix < wt_info_num_; ix++ ) {
-            if( nn <= wt_info_[ix].noteNo ) {
-                return p_tbl + (WT_SIZE * ix);
-            }
+        const float* p_tbl = (wf==WF_TRI) ? &wt_triangle_[0] : ((wf==WF_SAW) ? &wt_saw_[0] : &wt_square_[0]);
+        int row = GetWTInfoFromNN( nn );
+        if( row < wt_info_num_ ) {
+            return p_tbl + (WT_SIZE * row);
         }
     }
     return &wt_sine_[0];
@@ -116,13 +247,13 @@ float* Waveform::GetWTFromNN( int wf, float nn )
  * @param wf   波形の種類
  * @param freq 周波数
  */
-float* Waveform::GetWTFromFreq( int wf, float freq )
+const float* Waveform::GetWTFromFreq( int wf, float freq )
 {
     if( wf==WF_SINE ) {
         return &wt_sine_[0];
     }
     else {
-        float* p_tbl = (wf==WF_TRI) ? &wt_triangle_[0] : ((wf==WF_SAW) ? &wt_saw_[0] : &wt_square_[0]);
+        const float* p_tbl = (wf==WF_TRI) ? &wt_triangle_[0] : ((wf==WF_SAW) ? &wt_saw_[0] : &wt_square_[0]);
         for( int ix=0; ix < wt_info_num_; ix++ ) {
             if( freq <= wt_info_[ix].freq ) {
                 return p_tbl + (WT_SIZE * ix);
@@ -148,6 +279,17 @@ uint32_t Waveform::CalcWFromNoteNo( float nn, float det )
     return (uint32_t)( WT_SIZE * (1<<16) * f/fs_ );
 }
 
+/**
+ * @brief CalcWFromNoteNoのテーブル版（誤差は0.002セント未満）
+ * @param nn   NoteNumber
+ * @param det  detune val
+ */
+uint32_t Waveform::CalcWFromNoteNoFast( float nn, float det )
+{
+    float f = tuning_ * fast_exp2( ( nn+det/100.f-69.f) / 12.f );
+    return (uint32_t)( WT_SIZE * (1<<16) * f/fs_ );
+}
+
 /**
  * @brief 周波数から、角速度(1周期＝WT_SIZEの16:16固定小数点表現)を求める
  * @param freq 周波数
@@ -163,7 +305,7 @@ uint32_t Waveform::CalcWFromFreq( float freq )
  * @param p_tbl
  * @param phase
  */
-static float get_wave( float* p_tbl, int fixed_phase )
+static float get_wave( const float* p_tbl, int fixed_phase )
 {
     // 16:16の固定小数からインデックス(=整数部)を取り出すマクロ
     // x:固定小数点による位相、y:インデックスオフセット
@@ -192,7 +334,7 @@ const float Waveform::GetSine( int fixed_phase )
  */
 const float Waveform::GetTriangle( float nn, int fixed_phase )
 {
-    float* p_tbl = GetWTFromNN( WF_TRI, nn );
+    const float* p_tbl = GetWTFromNN( WF_TRI, nn );
     return get_wave( p_tbl, fixed_phase );
 }
 
@@ -203,7 +345,7 @@ const float Waveform::GetTriangle( float nn, int fixed_phase )
  */
 const float Waveform::GetSaw( float nn, int fixed_phase )
 {
-    float* p_tbl = GetWTFromNN( WF_SAW, nn );
+    const float* p_tbl = GetWTFromNN( WF_SAW, nn );
     return get_wave( p_tbl, fixed_phase );
 }
 
@@ -214,52 +356,270 @@ const float Waveform::GetSaw( float nn, int fixed_phase )
  */
 const float Waveform::GetSquare( float nn, int fixed_phase )
 {
-    float* p_tbl = GetWTFromNN( WF_SQUARE, nn );
+    const float* p_tbl = GetWTFromNN( WF_SQUARE, nn );
     return get_wave( p_tbl, fixed_phase );
 }
 
 /**
- * @brief 三角波テーブル生成
+ * @brief 帯域制限した三角波/ノコギリ波/矩形波のテーブルを、倍音のスペクトルから逆FFTで生成する
+ * @note  p_buf[i] = Σ a_k sin(2πki/WT_SIZE)。WT_SIZE/2以上の倍音はテーブル上で折り返した位置に足す
+ *        三角波 : a_k = ±8/(π²k²) (奇数次、k=1,5,9,...は+、k=3,7,11,...は-)
+ *        鋸波   : a_k = 2/(πk)
+ *        矩形波 : a_k = 2/(πk)     (奇数次、振幅は±0.5)
+ *
+ * @param[out] p_buf     書き込み先(WT_SIZE)
+ * @param[in]  wf        WF_TRI, WF_SAW, WF_SQUARE
+ * @param[in]  harmo_num 倍音数
+ * @param[in]  twiddle   回転因子
  */
-void Waveform::GenTblTriangle(float* p_buf, int harmo_num)
+void Waveform::GenTable( float* p_buf, int wf, int harmo_num, const double* twiddle )
 {
-    for(int ix=0;ix<WT_SIZE;ix++){
-        p_buf[ix]=0;
-        for(int jx=1;jx <= harmo_num;jx += 2) {                    // harmoNum倍音まで生成（奇数倍音のみなので2ずつ増加）
-            if(jx%4 == 1) p_buf[ix] += 1.f/(jx*jx) * _SIN(jx*ix);  // jx=1,5,9,13,...
-            else          p_buf[ix] -= 1.f/(jx*jx) * _SIN(jx*ix);  // jx=3,7,11,15,...
+    double re[WT_SIZE];
+    double im[WT_SIZE];
+    memset( re, 0, sizeof(re) );
+    memset( im, 0, sizeof(im) );
+
+    // sinの係数b_mは、X[m] = b_m としたIm(Σ X[m] e^(j2πmi/N))で得られる
+    for( int jx=1; jx<=harmo_num; jx++ ) {
+        double amp;
+        if( wf == WF_SAW ) {
+            amp = 2.0 / (M_PI * jx);
+        }
+        else if( (jx & 1) == 0 ) {
+            continue;
+        }
+        else if( wf == WF_TRI ) {
+            amp = ((jx % 4 == 1) ? 8.0 : -8.0) / (M_PI * M_PI * jx * jx);
+        }
+        else {
+            amp = 2.0 / (M_PI * jx);
+        }
+
+        int bin = jx % WT_SIZE;
+        if( bin == 0 || bin == WT_SIZE/2 ) {
+            continue;  // テーブル上では常に0
+        }
+        if( bin < WT_SIZE/2 ) {
+            re[bin] += amp;
+        }
+        else {
+            re[WT_SIZE - bin] -= amp;
         }
-        p_buf[ix] *= 8.f/(PI*PI);
+    }
+
+    waveform_ifft( re, im, twiddle );
+    for( int ix=0; ix<WT_SIZE; ix++ ) {
+        p_buf[ix] = (float)im[ix];
     }
 }
 
 /**
- * @brief ノコギリ波テーブル生成
+ * @brief 正規化しない逆FFT（基数2、インプレース）
+ *
+ * @param[in,out] re      実部(WT_SIZE)
+ * @param[in,out] im      虚部(WT_SIZE)
+ * @param[in]     twiddle 回転因子
  */
-void Waveform::GenTblSaw(float* p_buf, int harmo_num)
+static void waveform_ifft( double* re, double* im, const double* twiddle )
 {
-    for(int ix=0; ix<WT_SIZE; ix++) {
-        p_buf[ix]=0;
-        for(int jx=1; jx <= harmo_num; jx++) {
-            p_buf[ix] += 1.0f/jx * _SIN(jx*ix);
+    // ビット反転の並べ替え
+    for( int ix=1, jx=0; ix<WT_SIZE; ix++ ) {
+        int bit = WT_SIZE >> 1;
+        for( ; jx & bit; bit >>= 1 ) {
+            jx ^= bit;
+        }
+        jx ^= bit;
+        if( ix < jx ) {
+            double t;
+            t = re[ix]; re[ix] = re[jx]; re[jx] = t;
+            t = im[ix]; im[ix] = im[jx]; im[jx] = t;
         }
-        p_buf[ix] *= 2.0f / PI;
     }
+
+    for( int len=2; len<=WT_SIZE; len<<=1 ) {
+        int step = WT_SIZE / len;
+        for( int base=0; base<WT_SIZE; base+=len ) {
+            for( int kx=0; kx<len/2; kx++ ) {
+                double wr = twiddle[kx * step * 2];
+                double wi = twiddle[kx * step * 2 + 1];
+                int    a  = base + kx;
+                int    b  = a + len/2;
+                double tr = re[b] * wr - im[b] * wi;
+                double ti = re[b] * wi + im[b] * wr;
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// 波形テーブルのキャッシュ
+
+/**
+ * @brief CacheDirSet
+ */
+void Waveform::CacheDirSet( const char* dir )
+{
+    cache_dir_ = dir;
+}
+
+/**
+ * @brief DefaultCacheDir
+ */
+const char* Waveform::DefaultCacheDir()
+{
+    static char dir[1024];
+    const char* xdg  = getenv( "XDG_CACHE_HOME" );
+    const char* home = getenv( "HOME" );
+    if( xdg && xdg[0] ) {
+        snprintf( dir, sizeof(dir), "%s/s9r", xdg );
+    }
+    else if( home && home[0] ) {
+        snprintf( dir, sizeof(dir), "%s/.cache/s9r", home );
+    }
+    else {
+        return nullptr;
+    }
+    return dir;
+}
+
+/**
+ * @brief キャッシュファイルのパス（サンプリング周波数とキャッシュの形式毎に分ける）
+ * @note  テーブルはチューニングに依らないので、チューニングはパスに含めない
+ */
+void Waveform::CachePath( char* path, size_t size )
+{
+    snprintf( path, size, "%s/wavetable-v%u-%g.bin", cache_dir_, kCacheVersion, fs_ );
+}
+
+/**
+ * @brief キャッシュファイルをmapしてテーブルとして使う
+ *
+ * @retval true  使えた
+ * @retval false キャッシュが無い、または形式が合わない
+ */
+bool Waveform::LoadCache()
+{
+#ifndef _WIN32
+    if( !cache_dir_ ) {
+        return false;
+    }
+
+    char path[1024];
+    CachePath( path, sizeof(path) );
+    int fd = open( path, O_RDONLY );
+    if( fd < 0 ) {
+        return false;
+    }
+
+    const uint64_t data_bytes = GetWTBytes();
+    struct stat st;
+    void* map = MAP_FAILED;
+    if( fstat( fd, &st ) == 0 && (uint64_t)st.st_size == kCacheDataOffset + data_bytes ) {
+        map = mmap( nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    }
+    close( fd );
+    if( map == MAP_FAILED ) {
+        fprintf(stderr, "Waveform: ignoring cache %s (size mismatch)\n", path);
+        return false;
+    }
+
+    const WaveformCacheHeader* header = (const WaveformCacheHeader*)map;
+    if( memcmp( header->magic, kCacheMagic, sizeof(kCacheMagic) ) != 0 || header->version != kCacheVersion ||
+        header->wt_size != WT_SIZE || header->table_num != (uint32_t)wt_table_num_ || header->fs != fs_ ||
+        header->data_offset != kCacheDataOffset || header->data_bytes != data_bytes ) {
+        fprintf(stderr, "Waveform: ignoring cache %s (header mismatch)\n", path);
+        munmap( map, st.st_size );
+        return false;
+    }
+
+    wt_map_       = map;
+    wt_map_bytes_ = st.st_size;
+    SetTables( (const float*)((const char*)map + kCacheDataOffset) );
+    return true;
+#else
+    return false;
+#endif
 }
 
 /**
- * @brief 矩形波テーブル生成
+ * @brief 生成したテーブルをキャッシュファイルへ保存する
+ * @note  別名で書いてから置き換えるので、書いている途中のファイルを読むことは無い
+ *
+ * @param[in] buf 全波形テーブル
+ * @retval true  成功
+ * @retval false 失敗（キャッシュしないだけで、動作には影響しない）
  */
-void Waveform::GenTblSquare(float* p_buf, int harmo_num)
+bool Waveform::SaveCache( const float* buf )
 {
-    for(int ix=0;ix<WT_SIZE;ix++) {
-        p_buf[ix]=0;
-        for(int jx=1; jx <= harmo_num; jx++) {
-            p_buf[ix] += 1.0f/jx * _SIN(jx*ix);
-            p_buf[ix] -= 1.0f/jx * _SIN(jx * (ix+WT_SIZE/2));
+#ifndef _WIN32
+    if( !cache_dir_ || !waveform_mkdirs( cache_dir_ ) ) {
+        return false;
+    }
+
+    char path[1024], tmp[1100];
+    CachePath( path, sizeof(path) );
+    snprintf( tmp, sizeof(tmp), "%s.%d.tmp", path, (int)getpid() );
+
+    FILE* fp = fopen( tmp, "wb" );
+    if( !fp ) {
+        fprintf(stderr, "Waveform: can't write cache %s\n", tmp);
+        return false;
+    }
+
+    char page[kCacheDataOffset];
+    memset( page, 0, sizeof(page) );
+    WaveformCacheHeader* header = (WaveformCacheHeader*)page;
+    memcpy( header->magic, kCacheMagic, sizeof(kCacheMagic) );
+    header->version     = kCacheVersion;
+    header->wt_size     = WT_SIZE;
+    header->table_num   = wt_table_num_;
+    header->fs          = fs_;
+    header->data_offset = kCacheDataOffset;
+    header->data_bytes  = GetWTBytes();
+
+    bool ok = fwrite( page, sizeof(page), 1, fp ) == 1 &&
+              fwrite( buf, GetWTBytes(), 1, fp ) == 1;
+    ok = (fclose( fp ) == 0) && ok;
+    if( !ok || rename( tmp, path ) != 0 ) {
+        fprintf(stderr, "Waveform: can't write cache %s\n", path);
+        unlink( tmp );
+        return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief ディレクトリを親から順に作る（既にあればそのまま）
+ */
+static bool waveform_mkdirs( const char* dir )
+{
+#ifndef _WIN32
+    char path[1024];
+    snprintf( path, sizeof(path), "%s", dir );
+    for( char* p = path + 1; ; p++ ) {
+        if( *p == '/' || *p == '\0' ) {
+            char c = *p;
+            *p = '\0';
+            if( mkdir( path, 0755 ) != 0 && errno != EEXIST ) {
+                return false;
+            }
+            *p = c;
+            if( c == '\0' ) {
+                break;
+            }
         }
-        p_buf[ix] *= 1.f/PI;
     }
+    return true;
+#else
+    return false;
+#endif
 }
 
 
@@ -3,6 +3,9 @@
  */
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+
 #define WT_SIZE (1024) // 波形テーブルサイズ(単位はサンプル)
 
 /**
@@ -21,6 +24,7 @@ public:
     static Waveform* GetInstance();
 
     uint32_t CalcWFromNoteNo( float nn, float det );
+    uint32_t CalcWFromNoteNoFast( float nn, float det );  // ピッチが連続して変わる時用（テーブル版exp2を使う）
     uint32_t CalcWFromFreq( float freq );
 
     // 位相は16:16の固定小数で扱う
@@ -31,9 +35,20 @@ public:
 
     float GetSamplerate() { return fs_; }
 
+    // 全波形テーブルの先頭と、そこからのオフセットで最適なテーブルを表す（SIMDでまとめて参照する用）
+    const float* GetWTBase() { return wt_buf_; }
+    int          GetWTOffsetFromNN( int wf, float nn ) { return (int)(GetWTFromNN( wf, nn ) - wt_buf_); }
+    size_t       GetWTBytes() { return sizeof(float) * WT_SIZE * wt_table_num_; }  // 全波形テーブルのバイト数
+
+    // 波形テーブルのキャッシュ
+    //   生成したテーブルをdirへ保存し、次からはそれをmapして使う（nullptrならキャッシュしない）。Create前に呼ぶ
+    static void        CacheDirSet( const char* dir );
+    static const char* DefaultCacheDir();  // $XDG_CACHE_HOME/s9r または $HOME/.cache/s9r（無ければnullptr）
+    bool               IsFromCache() { return wt_map_ != nullptr; }
+
 private:
     Waveform(){}
-    ~Waveform(){}
+    ~Waveform();
 
     Waveform(const Waveform&);
     Waveform& operator=(const Waveform&);
@@ -43,10 +58,17 @@ private:
     float tuning_, fs_;
 
     // wavetable
-    float wt_sine_[WT_SIZE];         // サイン波テーブル
-    float wt_triangle_[WT_SIZE*68];  // 三角波テーブル（周波数帯域毎に分割）
-    float wt_saw_[WT_SIZE*68];       // ノコギリ
-    float wt_square_[WT_SIZE*68];    // 矩形
+    static const int kBandDiv = 90;  // テーブル情報表を作る時の周波数の分割数（＝帯域数の上限）
+
+    const float* wt_buf_;        // 全波形テーブル（以下のテーブルは全てこの中に連続して置く）
+    const float* wt_sine_;       // サイン波テーブル
+    const float* wt_triangle_;   // 三角波テーブル（周波数帯域毎に分割）
+    const float* wt_saw_;        // ノコギリ
+    const float* wt_square_;     // 矩形
+    int          wt_table_num_;  // テーブル数(1+帯域数*3)
+    float*       wt_heap_;       // 生成したテーブル（キャッシュをmapした時はnullptr）
+    void*        wt_map_;        // mapしたキャッシュファイル
+    size_t       wt_map_bytes_;
 
     // wavetable infomation
     typedef struct tagTableInfo {
@@ -55,16 +77,29 @@ private:
         int   harmoNum;  // 倍音数
         int   offset;    // 対応する波形テーブルの先頭へのオフセット
     } TABLEINFO;
-    TABLEINFO wt_info_[68+1];   // テーブル情報表
+    TABLEINFO wt_info_[kBandDiv+1];  // テーブル情報表
     int wt_info_num_;           // テーブル情報表の行数
 
+    // ノートNo→テーブル情報表の行の索引（1ノートをkNNIndexRes分割。その区間で候補となる最小の行を持つ）
+    static const int kNNIndexRes = 16;
+    static const int kNNIndexMax = 160;  // 最後の帯域(ナイキスト周波数)より上であること
+    uint8_t wt_index_[kNNIndexMax * kNNIndexRes];
+
+
+    static const char* cache_dir_;
 
     void Initialize( float freq, float fs );
+    void SetTables( const float* buf );
+
+    void GenTables( float* buf );
+    void GenTable( float* p_buf, int wf, int harmo_num, const double* twiddle );
+    static void GenTableJob( int job, void* userdata );
 
-    void GenTblTriangle(float* p_buf, int harmo_num);
-    void GenTblSaw(float* p_buf, int harmo_num);
-    void GenTblSquare(float* p_buf, int harmo_num);
+    bool LoadCache();
+    bool SaveCache( const float* buf );
+    void CachePath( char* path, size_t size );
 
-    float* GetWTFromNN( int wf, float nn );
-    float* GetWTFromFreq( int wf, float freq );
+    int          GetWTInfoFromNN( float nn );
+    const float* GetWTFromNN( int wf, float nn );
+    const float* GetWTFromFreq( int wf, float freq );
 };
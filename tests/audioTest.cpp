@@ -1,5 +1,8 @@
 #include <gtest/gtest.h>
 
+#include <atomic>
+#include <chrono>
+#include <thread>
 #include "audio.h"
 
 namespace {
@@ -39,4 +42,94 @@ namespace {
         audio_ = AudioCtrl::GetInstance();
         EXPECT_LT( 0, audio_->SampleRateGet() );
     }
+
+    TEST_F(AudioTest, RtStatusGet)
+    {
+        // 最初のコールバックでオーディオスレッドが設定する
+        RtThread::Status status;
+        audio_ = AudioCtrl::GetInstance();
+        audio_->Start();
+        EXPECT_TRUE( audio_->RtStatusGet( &status, 2000 ) );
+        EXPECT_FALSE( status.sched_request );
+        EXPECT_EQ( RtThread::kStackPrefaultBytes, status.prefault_bytes );
+#if defined(__SSE__) || defined(__aarch64__)
+        EXPECT_TRUE( status.ftz );
+#endif
+    }
+
+    TEST_F(AudioTest, Underflow)
+    {
+        // 間に合わないコールバックでアンダーフローさせる
+        AudioCtrl::Destroy();
+        AudioCtrl::LatencySet( 0.02, false );
+        audio_ = AudioCtrl::Create();
+        AudioCtrl::LatencySet( 0.0, false );
+        ASSERT_NE( nullptr, audio_ );
+        EXPECT_NEAR( 0.02, audio_->LatencyGet(), 0.005 );  // バックエンドが丸める
+
+        audio_->RenderCallbackSet( []( float* const* out, int frames, int channels, void* userdata ) {
+            std::this_thread::sleep_for( std::chrono::milliseconds( 30 ) );
+        }, nullptr );
+        audio_->Start();
+        for( int ms=0; ms<2000 && audio_->UnderflowCountGet() < 2; ms++ ) {
+            std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+        }
+        audio_->RenderCallbackUnset();
+
+        AudioCtrl::UnderflowEvent event;
+        ASSERT_TRUE( audio_->UnderflowEventGet( &event ) );
+        EXPECT_EQ( 1u, event.count );
+        EXPECT_FLOAT_EQ( (float)audio_->LatencyGet(), event.latency );
+        ASSERT_TRUE( audio_->UnderflowEventGet( &event ) );
+        EXPECT_EQ( 2u, event.count );
+        EXPECT_LT( 30000000u, event.recent_ns[0] );  // 直前のコールバックは遅かった
+    }
+
+    TEST_F(AudioTest, RenderAhead)
+    {
+        AudioCtrl::Destroy();
+        AudioCtrl::LatencySet( 0.05, false );
+        AudioCtrl::RenderAheadSet( 1000 );
+        audio_ = AudioCtrl::Create();
+        AudioCtrl::LatencySet( 0.0, false );
+        AudioCtrl::RenderAheadSet( 0 );
+        ASSERT_NE( nullptr, audio_ );
+        EXPECT_TRUE( audio_->IsRenderAhead() );
+
+        // レンダリングしたフレーム数を数える
+        static std::atomic<int> rendered;
+        rendered = 0;
+        audio_->RenderCallbackSet( []( float* const* out, int frames, int channels, void* userdata ) {
+            for( int ch=0; ch<channels; ch++ ) {
+                for( int ix=0; ix<frames; ix++ ) {
+                    out[ch][ix] = 0.5f;
+                }
+            }
+            rendered += frames;
+        }, nullptr );
+        audio_->Start();
+
+        // 深さはブロック単位に切り上げ、始める前に溜めておく
+        AudioCtrl::RenderAheadStats stats;
+        ASSERT_TRUE( audio_->RenderAheadStatsGet( &stats, true ) );
+        EXPECT_EQ( 1024, stats.depth_frames );
+        EXPECT_EQ( 0, rendered % AudioCtrl::kMaxBlockFrames );
+
+        std::this_thread::sleep_for( std::chrono::milliseconds( 200 ) );
+        audio_->RenderCallbackUnset();
+
+        ASSERT_TRUE( audio_->RenderAheadStatsGet( &stats, false ) );
+        EXPECT_LE( stats.fill_frames, stats.depth_frames );
+        EXPECT_LE( stats.min_fill_frames, stats.depth_frames );
+        EXPECT_LE( 0, stats.min_fill_frames );
+        EXPECT_LT( 1024, rendered.load() );  // デバイスが読んだ分を補充している
+    }
+
+    TEST_F(AudioTest, RenderAheadOff)
+    {
+        AudioCtrl::RenderAheadStats stats;
+        audio_ = AudioCtrl::GetInstance();
+        EXPECT_FALSE( audio_->IsRenderAhead() );
+        EXPECT_FALSE( audio_->RenderAheadStatsGet( &stats, false ) );
+    }
 }
@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+
+#include <math.h>
+#include "envelope.h"
+
+namespace{
+    class EnvelopeTest : public ::testing::Test
+    {
+    protected:
+        virtual void SetUp()
+        {
+        }
+
+        virtual void TearDown()
+        {
+        }
+    };
+
+    // fs=1000なので1ms=1サンプル
+    static void envelope_setup( Envelope* env, Envelope::Curve curve )
+    {
+        env->SetAttack( 10 );
+        env->SetDecay( 20 );
+        env->SetSustain( 0.5f );
+        env->SetRelease( 40 );
+        env->SetCurve( curve );
+    }
+
+    // 各段階の終わりでちょうど目標値になり、リリースの終わりで休止する
+    TEST_F(EnvelopeTest, Segment)
+    {
+        const Envelope::Curve curves[] = { Envelope::kLinear, Envelope::kExponential };
+        for( Envelope::Curve curve : curves ) {
+            Envelope env( 1000.f );
+            envelope_setup( &env, curve );
+            EXPECT_FALSE( env.IsPlaying() );
+            EXPECT_EQ( 0.f, env.Process( 1.f ) );
+
+            float out[100];
+            env.Trigger();
+            EXPECT_EQ( 100, env.Process( out, 100 ) );
+            EXPECT_EQ( 1.0f, out[9] );   // attack
+            EXPECT_EQ( 0.5f, out[29] );  // decay
+            EXPECT_EQ( 0.5f, out[99] );  // sustain
+            for( int ix=1; ix<30; ix++ ) {
+                if( ix < 10 ) { EXPECT_LT( out[ix-1], out[ix] ); }
+                else          { EXPECT_GT( out[ix-1], out[ix] ); }
+            }
+
+            env.Release();
+            EXPECT_EQ( 40, env.Process( out, 100 ) );  // 41サンプル目で休止
+            EXPECT_LT( 0.f, out[38] );
+            EXPECT_EQ( 0.f, out[39] );
+            EXPECT_EQ( 0.f, out[99] );
+            EXPECT_FALSE( env.IsPlaying() );
+        }
+    }
+
+    // アタック中にリリースすると、その時のレベルから下がる
+    TEST_F(EnvelopeTest, ReleaseFromCurrentLevel)
+    {
+        Envelope env( 1000.f );
+        envelope_setup( &env, Envelope::kLinear );
+
+        env.Trigger();
+        float lv = env.Advance( 5 );
+        EXPECT_FLOAT_EQ( 0.5f, lv );
+
+        env.Release();
+        EXPECT_FLOAT_EQ( 0.5f - 0.5f / 40.f, env.Process( 1.f ) );
+    }
+
+    // ブロック処理と1サンプル毎の処理の結果が一致する
+    TEST_F(EnvelopeTest, Block)
+    {
+        Envelope single( 48000.f );
+        Envelope block( 48000.f );
+        single.SetAttack( 3 );  single.SetDecay( 7 );  single.SetSustain( 0.3f );  single.SetRelease( 5 );
+        block.SetAttack( 3 );   block.SetDecay( 7 );   block.SetSustain( 0.3f );   block.SetRelease( 5 );
+        single.SetCurve( Envelope::kExponential );
+        block.SetCurve( Envelope::kExponential );
+
+        single.Trigger();
+        block.Trigger();
+        float out[256];
+        for( int blk=0; blk<4; blk++ ) {
+            if( blk == 2 ) {
+                single.Release();
+                block.Release();
+            }
+            block.Process( out, 200 );
+            for( int ix=0; ix<200; ix++ ) {
+                ASSERT_EQ( single.Process( 1.f ), out[ix] );
+            }
+        }
+    }
+}
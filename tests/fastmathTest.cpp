@@ -0,0 +1,48 @@
+#include <gtest/gtest.h>
+
+#include <math.h>
+#include "fastmath.h"
+
+namespace{
+    class FastmathTest : public ::testing::Test
+    {
+    protected:
+        virtual void SetUp()
+        {
+        }
+
+        virtual void TearDown()
+        {
+        }
+    };
+
+    // ピッチ計算に使う範囲で、powとの差が0.002セント未満
+    TEST_F(FastmathTest, Exp2)
+    {
+        double max_cent = 0.0;
+        for( float x=-11.f; x<=11.f; x+=0.0001f ) {
+            double expect = pow( 2.0, (double)x );
+            double actual = fast_exp2( x );
+            double cent   = fabs( 1200.0 * log2( actual / expect ) );
+            max_cent = (cent > max_cent) ? cent : max_cent;
+        }
+        EXPECT_LT( max_cent, 0.002 );
+    }
+
+    // 整数は厳密
+    TEST_F(FastmathTest, Exp2Integer)
+    {
+        for( int x=-20; x<=20; x++ ) {
+            EXPECT_EQ( (float)pow( 2.0, x ), fast_exp2( (float)x ) );
+        }
+    }
+
+    // 0に近い負の数（小数部が丸めで1.0になる）でもテーブルの範囲内で求まる
+    TEST_F(FastmathTest, Exp2SmallNegative)
+    {
+        const float xs[] = { -1e-8f, -1e-10f, -1e-30f, -3.0f - 1e-7f };
+        for( float x : xs ) {
+            EXPECT_NEAR( pow( 2.0, (double)x ), fast_exp2( x ), pow( 2.0, (double)x ) * 1e-6 ) << x;
+        }
+    }
+}
@@ -1,5 +1,6 @@
 #include <gtest/gtest.h>
 
+#include <thread>
 #include "fifo.h"
 
 namespace {
@@ -24,13 +25,13 @@ namespace {
         int put_data = 0;
         int get_data = 0;
 
-        FIFO* fifo = new FIFO( cycle_num, sizeof(int) );
+        FIFO<int, cycle_num>* fifo = new FIFO<int, cycle_num>();
         EXPECT_NE( nullptr, fifo );
 
         for(int ix=0; ix<(cycle_num*2); ix++) {
             put_data = ix;
             get_data = 0;
-            fifo->Put( &put_data );
+            fifo->Put( put_data );
             fifo->Get( &get_data );
             EXPECT_EQ( put_data, get_data );
         }
@@ -49,13 +50,13 @@ namespace {
         int put_data = 0;
         int get_data = 0;
 
-        FIFO* fifo = new FIFO( cycle_num, sizeof(int) );
+        FIFO<int, cycle_num>* fifo = new FIFO<int, cycle_num>();
         EXPECT_NE( nullptr, fifo );
 
         // 1周(全部取れる)
         for(int ix=0; ix<cycle_num; ix++) {
             put_data = ix;
-            fifo->Put( &put_data );
+            fifo->Put( put_data );
         }
         for(int ix=0; ix<cycle_num; ix++) {
             get_data = 0;
@@ -72,7 +73,7 @@ namespace {
         // 2周(後半の1周分しか取れない)
         for(int ix=0; ix<cycle_num*2; ix++) {
             put_data = ix;
-            fifo->Put( &put_data );
+            fifo->Put( put_data );
         }
         for(int ix=8; ix<cycle_num*2; ix++) {
             get_data = 0;
@@ -94,13 +95,13 @@ namespace {
         int put_data = 0;
         int get_data[cycle_num];
 
-        FIFO* fifo = new FIFO( cycle_num, sizeof(int) );
+        FIFO<int, cycle_num>* fifo = new FIFO<int, cycle_num>();
         EXPECT_NE( nullptr, fifo );
 
         // put test data
         for(int ix=0; ix<cycle_num; ix++) {
             put_data = ix;
-            fifo->Put( &put_data );
+            fifo->Put( put_data );
         }
 
         // snoop
@@ -129,13 +130,13 @@ namespace {
         int put_data = 0;
         int get_data[cycle_num];
 
-        FIFO* fifo = new FIFO( cycle_num, sizeof(int) );
+        FIFO<int, cycle_num>* fifo = new FIFO<int, cycle_num>();
         EXPECT_NE( nullptr, fifo );
 
         // put test data(half num)
         for(int ix=0; ix<cycle_num/2; ix++) {
             put_data = ix;
-            fifo->Put( &put_data );
+            fifo->Put( put_data );
         }
 
         // snoop
@@ -159,4 +160,126 @@ namespace {
 
         delete fifo;
     }
+
+    TEST_F(FifoTest, PutNGetN)
+    {
+        FIFO<int, 8> fifo;
+        int put_data[12];
+        int get_data[12];
+        for( int ix=0; ix<12; ix++ ) {
+            put_data[ix] = ix;
+        }
+
+        EXPECT_EQ( 5u, fifo.PutN( put_data, 5 ) );
+        EXPECT_EQ( 5u, fifo.GetLength() );
+        EXPECT_EQ( 3u, fifo.GetN( get_data, 3 ) );
+        EXPECT_EQ( 0, get_data[0] );
+        EXPECT_EQ( 2, get_data[2] );
+
+        // 終端をまたいで書き込み、溢れた分は古い方から捨てる
+        EXPECT_EQ( 7u, fifo.PutN( &put_data[5], 7 ) );
+        EXPECT_EQ( 8u, fifo.GetLength() );
+        EXPECT_EQ( 8u, fifo.GetN( get_data, 12 ) );
+        for( int ix=0; ix<8; ix++ ) {
+            EXPECT_EQ( 4 + ix, get_data[ix] );
+        }
+        EXPECT_EQ( 0u, fifo.GetN( get_data, 12 ) );
+
+        // 容量を超える量を一度に書くと末尾だけ残る
+        EXPECT_EQ( 12u, fifo.PutN( put_data, 12 ) );
+        EXPECT_EQ( 8u, fifo.GetN( get_data, 12 ) );
+        for( int ix=0; ix<8; ix++ ) {
+            EXPECT_EQ( 4 + ix, get_data[ix] );
+        }
+    }
+
+    TEST_F(FifoTest, ReadSpans)
+    {
+        FIFO<int, 8> fifo;
+        FIFO<int, 8>::Span first, second;
+
+        EXPECT_EQ( 0u, fifo.ReadSpans( &first, &second ) );
+        EXPECT_EQ( 0u, first.num );
+        EXPECT_EQ( 0u, second.num );
+
+        // 6個入れて5個取り除き、終端をまたぐように4個足す
+        for( int ix=0; ix<6; ix++ ) {
+            fifo.Put( ix );
+        }
+        fifo.Consume( 5 );
+        for( int ix=6; ix<10; ix++ ) {
+            fifo.Put( ix );
+        }
+
+        EXPECT_EQ( 5u, fifo.ReadSpans( &first, &second ) );
+        ASSERT_EQ( 3u, first.num );
+        ASSERT_EQ( 2u, second.num );
+        EXPECT_EQ( 5, first.data[0] );
+        EXPECT_EQ( 7, first.data[2] );
+        EXPECT_EQ( 8, second.data[0] );
+        EXPECT_EQ( 9, second.data[1] );
+
+        // 参照しただけでは減らない
+        EXPECT_EQ( 5u, fifo.GetLength() );
+        fifo.Consume( 3 );
+        EXPECT_EQ( 2u, fifo.ReadSpans( &first, &second ) );
+        EXPECT_EQ( 2u, first.num );
+        EXPECT_EQ( 0u, second.num );
+        EXPECT_EQ( 8, first.data[0] );
+    }
+
+    TEST_F(FifoTest, Atomic)
+    {
+        FIFO<int, 8, true> fifo;
+        int put_data[12];
+        for( int ix=0; ix<12; ix++ ) {
+            put_data[ix] = ix;
+        }
+
+        // 満杯なら書き込まない
+        EXPECT_EQ( 8u, fifo.PutN( put_data, 12 ) );
+        EXPECT_FALSE( fifo.Put( 100 ) );
+        int get_data = -1;
+        EXPECT_TRUE( fifo.Get( &get_data ) );
+        EXPECT_EQ( 0, get_data );
+        EXPECT_TRUE( fifo.Put( 100 ) );
+    }
+
+    TEST_F(FifoTest, AtomicThread)
+    {
+        // 書き手と読み手を別スレッドにしても順番どおり欠けずに届くこと
+        static FIFO<int, 64, true> fifo;
+        const int total = 20000;
+
+        std::thread writer( [&]{
+            int block[7];
+            int val = 0;
+            while( val < total ) {
+                int num = 0;
+                for( ; num<7 && val+num<total; num++ ) {
+                    block[num] = val + num;
+                }
+                size_t put = fifo.PutN( block, num );
+                val += (int)put;
+                if( put == 0 ) {
+                    std::this_thread::yield();
+                }
+            }
+        } );
+
+        int expect = 0;
+        int buf[16];
+        while( expect < total ) {
+            size_t num = fifo.GetN( buf, 16 );
+            if( num == 0 ) {
+                std::this_thread::yield();
+            }
+            for( size_t ix=0; ix<num; ix++ ) {
+                ASSERT_EQ( expect, buf[ix] );
+                expect++;
+            }
+        }
+        writer.join();
+        EXPECT_EQ( 0u, fifo.GetLength() );
+    }
 }
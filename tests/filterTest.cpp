@@ -1,6 +1,7 @@
 #include <gtest/gtest.h>
 
 #include <math.h>
+#include <cmath>
 #include "filter.h"
 
 namespace{
@@ -22,4 +23,63 @@ namespace{
         Filter filter( 48000.f );
         filter.Process( 0.5f );
     }
+
+    // 正規化済みの係数で、DCゲイン(LowPass)と1/2fsでのゲイン(HighPass)が1になる
+    TEST_F(FilterTest, Coef)
+    {
+        Filter filter( 48000.f );
+
+        filter.LowPass( 1000.f, 0.7f );
+        float dc = (filter.GetB0() + filter.GetB1() + filter.GetB2())
+                 / (1.0f + filter.GetA1() + filter.GetA2());
+        EXPECT_NEAR( 1.0f, dc, 1e-4f );
+
+        filter.HighPass( 1000.f, 0.7f );
+        float nyq = (filter.GetB0() - filter.GetB1() + filter.GetB2())
+                  / (1.0f - filter.GetA1() + filter.GetA2());
+        EXPECT_NEAR( 1.0f, nyq, 1e-4f );
+    }
+
+    // ブロック処理と1サンプル毎の処理の結果が一致する
+    TEST_F(FilterTest, ProcessBlock)
+    {
+        Filter single( 48000.f );
+        Filter block( 48000.f );
+        single.LowPass( 2000.f, 2.0f );
+        block.LowPass( 2000.f, 2.0f );
+
+        float in[300], out[300];
+        for( int ix=0; ix<300; ix++ ) {
+            in[ix] = (ix % 37 < 18) ? 0.5f : -0.5f;
+        }
+        block.Process( in, out, 100 );
+        block.Process( &in[100], &out[100], 200 );
+
+        for( int ix=0; ix<300; ix++ ) {
+            EXPECT_EQ( single.Process( in[ix] ), out[ix] );
+        }
+    }
+
+    // 無音が続くと状態が0になる（非正規化数にならない）
+    TEST_F(FilterTest, Denormal)
+    {
+        Filter filter( 48000.f );
+        filter.LowPass( 1000.f, 0.7f );
+
+        float buf[256];
+        buf[0] = 1.0f;
+        for( int ix=1; ix<256; ix++ ) {
+            buf[ix] = 0.0f;
+        }
+        filter.Process( buf, buf, 256 );
+
+        float zero[256] = {};
+        for( int blk=0; blk<200; blk++ ) {
+            filter.Process( zero, buf, 256 );
+            for( int ix=0; ix<256; ix++ ) {
+                ASSERT_NE( FP_SUBNORMAL, std::fpclassify( buf[ix] ) );
+            }
+        }
+        EXPECT_EQ( 0.0f, filter.Process( 0.0f ) );
+    }
 }
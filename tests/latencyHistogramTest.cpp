@@ -0,0 +1,63 @@
+#include <gtest/gtest.h>
+
+#include "latency_histogram.h"
+
+namespace{
+    class LatencyHistogramTest : public ::testing::Test
+    {
+    protected:
+        virtual void SetUp()
+        {
+        }
+
+        virtual void TearDown()
+        {
+        }
+    };
+
+    // バケット番号は単調増加で、下限へ戻すと元の値以下・次のバケットの下限未満になる
+    TEST_F(LatencyHistogramTest, Bucket)
+    {
+        const int bucket_num = LatencyHistogram::kBucketNum;
+        int prev = 0;
+        for( uint64_t ns=0; ns<=UINT32_MAX; ns = ns*9/8 + 1 ) {
+            int ix = LatencyHistogram::BucketIndex( (uint32_t)ns );
+            ASSERT_GE( ix, prev );
+            ASSERT_LT( ix, bucket_num );
+            ASSERT_LE( LatencyHistogram::BucketLower( ix ), ns );
+            if( ix+1 < bucket_num ) {
+                ASSERT_GT( LatencyHistogram::BucketLower( ix+1 ), ns );
+            }
+            prev = ix;
+        }
+        EXPECT_EQ( bucket_num-1, LatencyHistogram::BucketIndex( UINT32_MAX ) );
+    }
+
+    // パーセンタイルは真値からバケット幅(25%)以内、最大値とデッドラインミスは正確
+    TEST_F(LatencyHistogramTest, Percentile)
+    {
+        LatencyHistogram hist;
+        EXPECT_EQ( 0u, hist.GetPercentile( 50.0 ) );
+
+        for( uint32_t ns=1; ns<=10000; ns++ ) {
+            hist.Record( ns * 100, 900000 );
+        }
+        EXPECT_EQ( 10000u, hist.GetCount() );
+        EXPECT_EQ( 1000000u, hist.GetMax() );
+        EXPECT_EQ( 1000u, hist.GetDeadlineMiss() );
+
+        const double percent[] = { 50.0, 99.0, 99.9 };
+        for( double p : percent ) {
+            double expect = p * 10000.0;
+            uint32_t actual = hist.GetPercentile( p );
+            EXPECT_GE( actual, expect );
+            EXPECT_LE( actual, expect * 1.25 );
+        }
+        EXPECT_EQ( 1000000u, hist.GetPercentile( 100.0 ) );
+
+        hist.Reset();
+        EXPECT_EQ( 0u, hist.GetCount() );
+        EXPECT_EQ( 0u, hist.GetMax() );
+        EXPECT_EQ( 0u, hist.GetDeadlineMiss() );
+    }
+}
@@ -0,0 +1,111 @@
+#include <gtest/gtest.h>
+
+#include "latency_tuner.h"
+
+namespace{
+    class LatencyTunerTest : public ::testing::Test
+    {
+    protected:
+        virtual void SetUp()
+        {
+            config_.min_sec          = 0.004;
+            config_.max_sec          = 0.2;
+            config_.raise_count      = 3;
+            config_.raise_window_sec = 2.0;
+            config_.raise_ratio      = 1.5;
+            config_.trim_quiet_sec   = 10.0;
+            config_.trim_ratio       = 0.8;
+            config_.trim_headroom    = 0.25;
+            tuner_.Reset( config_, 0.02, 0.0 );
+        }
+
+        virtual void TearDown()
+        {
+        }
+
+    public:
+        LatencyTuner::Config config_;
+        LatencyTuner         tuner_;
+    };
+
+    TEST_F(LatencyTunerTest, RaiseAfterRepeatedUnderflows)
+    {
+        EXPECT_DOUBLE_EQ( 0.02, tuner_.Update( 1.0, 1, 0 ) );
+        EXPECT_DOUBLE_EQ( 0.02, tuner_.Update( 1.5, 1, 0 ) );
+        EXPECT_DOUBLE_EQ( 0.03, tuner_.Update( 2.0, 1, 0 ) );
+        EXPECT_DOUBLE_EQ( 0.02, tuner_.GetFloor() );
+
+        // 数え直すので、次の1回では増やさない
+        EXPECT_DOUBLE_EQ( 0.03, tuner_.Update( 2.1, 1, 0 ) );
+
+        // まとめて届いても回数として数える
+        EXPECT_DOUBLE_EQ( 0.045, tuner_.Update( 2.2, 2, 0 ) );
+    }
+
+    TEST_F(LatencyTunerTest, RaiseAgainAfterLongPause)
+    {
+        EXPECT_DOUBLE_EQ( 0.02, tuner_.Update( 1.0, 1, 0 ) );
+        EXPECT_DOUBLE_EQ( 0.02, tuner_.Update( 1.5, 1, 0 ) );
+        EXPECT_DOUBLE_EQ( 0.03, tuner_.Update( 2.0, 1, 0 ) );
+
+        // 増やした後のアンダーフローだけで数える（前の時刻は窓の外）
+        EXPECT_DOUBLE_EQ( 0.03,  tuner_.Update( 100.0, 1, 0 ) );
+        EXPECT_DOUBLE_EQ( 0.03,  tuner_.Update( 100.1, 1, 0 ) );
+        EXPECT_DOUBLE_EQ( 0.045, tuner_.Update( 100.2, 1, 0 ) );
+
+        // 3回目の山も同じ
+        EXPECT_DOUBLE_EQ( 0.045,  tuner_.Update( 200.0, 1, 0 ) );
+        EXPECT_DOUBLE_EQ( 0.045,  tuner_.Update( 200.1, 1, 0 ) );
+        EXPECT_DOUBLE_EQ( 0.0675, tuner_.Update( 200.2, 1, 0 ) );
+    }
+
+    TEST_F(LatencyTunerTest, SparseUnderflowsDoNotRaise)
+    {
+        EXPECT_DOUBLE_EQ( 0.02, tuner_.Update( 1.0, 1, 0 ) );
+        EXPECT_DOUBLE_EQ( 0.02, tuner_.Update( 4.0, 1, 0 ) );
+        EXPECT_DOUBLE_EQ( 0.02, tuner_.Update( 7.0, 1, 0 ) );
+    }
+
+    TEST_F(LatencyTunerTest, RaiseIsClamped)
+    {
+        tuner_.Reset( config_, 0.15, 0.0 );
+        EXPECT_DOUBLE_EQ( 0.2, tuner_.Update( 1.0, 3, 0 ) );
+        EXPECT_DOUBLE_EQ( 0.2, tuner_.Update( 1.1, 3, 0 ) );
+    }
+
+    TEST_F(LatencyTunerTest, TrimAfterHeadroom)
+    {
+        // 余裕があっても、静かな時間が続くまでは減らさない
+        EXPECT_DOUBLE_EQ( 0.02, tuner_.Update( 5.0, 0, 100000 ) );
+        EXPECT_DOUBLE_EQ( 0.016, tuner_.Update( 10.0, 0, 100000 ) );
+        EXPECT_DOUBLE_EQ( 0.016, tuner_.Update( 15.0, 0, 100000 ) );
+        EXPECT_NEAR( 0.0128, tuner_.Update( 20.0, 0, 100000 ), 1e-12 );
+    }
+
+    TEST_F(LatencyTunerTest, NoTrimWithoutHeadroom)
+    {
+        // 処理時間が減らした後の遅延の1/4以上あれば減らさない(0.016 * 0.25 = 4ms)
+        EXPECT_DOUBLE_EQ( 0.02, tuner_.Update( 5.0, 0, 4000000 ) );
+        EXPECT_DOUBLE_EQ( 0.02, tuner_.Update( 10.0, 0, 1000 ) );
+
+        // 次の区間で余裕があれば減らす
+        EXPECT_DOUBLE_EQ( 0.016, tuner_.Update( 20.0, 0, 1000 ) );
+    }
+
+    TEST_F(LatencyTunerTest, TrimStopsAboveFailedLatency)
+    {
+        // 0.02でアンダーフローした後は、0.02以下には戻さない
+        tuner_.Update( 1.0, 3, 0 );
+        EXPECT_DOUBLE_EQ( 0.03, tuner_.GetLatency() );
+        EXPECT_DOUBLE_EQ( 0.024, tuner_.Update( 11.0, 0, 0 ) );
+        EXPECT_DOUBLE_EQ( 0.024, tuner_.Update( 21.0, 0, 0 ) );
+        EXPECT_DOUBLE_EQ( 0.024, tuner_.Update( 31.0, 0, 0 ) );
+    }
+
+    TEST_F(LatencyTunerTest, TrimIsClamped)
+    {
+        tuner_.Reset( config_, 0.0045, 0.0 );
+        EXPECT_DOUBLE_EQ( 0.004, tuner_.Update( 10.0, 0, 0 ) );
+        EXPECT_DOUBLE_EQ( 0.004, tuner_.Update( 20.0, 0, 0 ) );
+    }
+}
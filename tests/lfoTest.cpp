@@ -0,0 +1,83 @@
+#include <gtest/gtest.h>
+
+#include <math.h>
+#include "lfo.h"
+
+namespace{
+    class LfoTest : public ::testing::Test
+    {
+    protected:
+        virtual void SetUp()
+        {
+        }
+
+        virtual void TearDown()
+        {
+        }
+    };
+
+    TEST_F(LfoTest, Shape)
+    {
+        // 1Hz/4800Hzなので1200サンプルで1/4周期
+        Lfo lfo( 4800.f );
+        lfo.SetRate( 1.f );
+
+        lfo.SetShape( Lfo::kSine );
+        lfo.Trigger();
+        EXPECT_NEAR( 0.f, lfo.GetValue(), 1e-4f );
+        EXPECT_NEAR( 1.f, lfo.Advance( 1200 ), 1e-3f );
+        EXPECT_NEAR( 0.f, lfo.Advance( 1200 ), 1e-3f );
+        EXPECT_NEAR( -1.f, lfo.Advance( 1200 ), 1e-3f );
+
+        lfo.SetShape( Lfo::kTriangle );
+        lfo.Trigger();
+        EXPECT_NEAR( -1.f, lfo.GetValue(), 1e-4f );
+        EXPECT_NEAR( 0.f, lfo.Advance( 1200 ), 1e-3f );
+        EXPECT_NEAR( 1.f, lfo.Advance( 1200 ), 1e-3f );
+
+        lfo.SetShape( Lfo::kSaw );
+        lfo.Trigger();
+        EXPECT_NEAR( -1.f, lfo.GetValue(), 1e-4f );
+        EXPECT_NEAR( 0.f, lfo.Advance( 2400 ), 1e-3f );
+
+        lfo.SetShape( Lfo::kSquare );
+        lfo.Trigger();
+        EXPECT_EQ( 1.f, lfo.Advance( 1200 ) );
+        EXPECT_EQ( -1.f, lfo.Advance( 2400 ) );
+    }
+
+    TEST_F(LfoTest, KeySync)
+    {
+        Lfo lfo( 4800.f );
+        lfo.SetRate( 1.f );
+        lfo.SetShape( Lfo::kSaw );
+
+        // キーシンクなら位相が戻る
+        lfo.Advance( 1000 );
+        lfo.Trigger();
+        EXPECT_NEAR( -1.f, lfo.GetValue(), 1e-4f );
+
+        // キーシンクしなければそのまま
+        lfo.SetKeySync( false );
+        float val = lfo.Advance( 1000 );
+        lfo.Trigger();
+        EXPECT_EQ( val, lfo.GetValue() );
+    }
+
+    TEST_F(LfoTest, SampleHold)
+    {
+        Lfo lfo( 4800.f );
+        lfo.SetRate( 1.f );
+        lfo.SetShape( Lfo::kSampleHold );
+
+        // 1周期の間は同じ値を保ち、周期をまたぐと変わる
+        EXPECT_EQ( 0.f, lfo.Advance( 2400 ) );
+        float val = lfo.Advance( 2600 );
+        EXPECT_NE( 0.f, val );
+        EXPECT_LE( -1.f, val );
+        EXPECT_GE( 1.f, val );
+        EXPECT_EQ( val, lfo.Advance( 2000 ) );
+        EXPECT_EQ( val, lfo.Advance( 2000 ) );
+        EXPECT_NE( val, lfo.Advance( 2000 ) );
+    }
+}
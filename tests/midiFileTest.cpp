@@ -0,0 +1,68 @@
+#include <gtest/gtest.h>
+
+#include "midi_file.h"
+
+namespace{
+    class MidiFileTest : public ::testing::Test
+    {
+    protected:
+        virtual void SetUp()
+        {
+        }
+
+        virtual void TearDown()
+        {
+        }
+    };
+
+    // フォーマット1、2トラック、division=96
+    static const uint8_t kSmf[] = {
+        'M','T','h','d', 0,0,0,6, 0,1, 0,2, 0,96,
+        // track 0: 1拍目で120BPM -> 2拍目で60BPMに変更
+        'M','T','r','k', 0,0,0,18,
+        0x00, 0xFF,0x51,0x03, 0x07,0xA1,0x20,
+        0x60, 0xFF,0x51,0x03, 0x0F,0x42,0x40,
+        0x00, 0xFF,0x2F,0x00,
+        // track 1: ランニングステータスでノートオン/オフ
+        'M','T','r','k', 0,0,0,18,
+        0x00, 0x90,60,100,
+        0x60, 64,100,          // ランニングステータス
+        0x60, 0x80,60,0,
+        0x00, 64,0,
+        0x00, 0xFF,0x2F,0x00,
+    };
+
+    TEST_F(MidiFileTest, Parse)
+    {
+        MidiFile mf;
+        EXPECT_TRUE( mf.Parse( kSmf, sizeof(kSmf) ) );
+
+        const std::vector<MidiFileEvent>& ev = mf.GetEvents();
+        ASSERT_EQ( 4u, ev.size() );
+
+        EXPECT_DOUBLE_EQ( 0.0, ev[0].time );
+        EXPECT_EQ( 0x90, ev[0].data[0] );
+        EXPECT_EQ( 60,   ev[0].data[1] );
+
+        // 1拍(120BPM) = 0.5sec
+        EXPECT_DOUBLE_EQ( 0.5, ev[1].time );
+        EXPECT_EQ( 0x90, ev[1].data[0] );
+        EXPECT_EQ( 64,   ev[1].data[1] );
+
+        // さらに1拍(60BPM) = 1.0sec
+        EXPECT_DOUBLE_EQ( 1.5, ev[2].time );
+        EXPECT_EQ( 0x80, ev[2].data[0] );
+        EXPECT_DOUBLE_EQ( 1.5, ev[3].time );
+        EXPECT_EQ( 0x80, ev[3].data[0] );
+        EXPECT_EQ( 64,   ev[3].data[1] );
+
+        EXPECT_DOUBLE_EQ( 1.5, mf.GetLength() );
+    }
+
+    TEST_F(MidiFileTest, Broken)
+    {
+        MidiFile mf;
+        EXPECT_FALSE( mf.Parse( kSmf, 10 ) );
+        EXPECT_FALSE( mf.Parse( kSmf, sizeof(kSmf) - 8 ) );
+    }
+}
@@ -65,4 +65,116 @@ namespace{
         EXPECT_EQ( -1, midictrl->GetNewOnKeyNN(0) );
         EXPECT_EQ( -1, midictrl->GetNewOnKeyNN(1) );
     }
-}
\ No newline at end of file
+
+    TEST_F(MidiTest, DispatchEvent)
+    {
+        MidiCtrl* midictrl = MidiCtrl::GetInstance();
+        std::vector<unsigned char> msg = { 0x90, 60, 100 };
+
+        // 送っただけでは鍵盤状態は変わらない
+        midictrl->MidiSend( &msg );
+        EXPECT_EQ( 0, midictrl->GetVelocity(60) );
+
+        // ブロック開始時にキューから取り出され、ブロック内に配置される
+        midictrl->BeginBlock( 64, 48000.f );
+        int offset = midictrl->NextEventOffset();
+        EXPECT_LE( 0, offset );
+        EXPECT_GT( 64, offset );
+
+        midictrl->DispatchEvent();
+        EXPECT_EQ( MidiCtrl::kNoEvent, midictrl->NextEventOffset() );
+        EXPECT_EQ( 100, midictrl->GetVelocity(60) );
+        EXPECT_EQ( 1, midictrl->GetOnKeyNum() );
+        EXPECT_EQ( 60, midictrl->GetNewOnKeyNN(0) );
+        EXPECT_EQ( true, midictrl->IsStatusChanged() );
+
+        // velocity 0 のNote onはNote off
+        msg = { 0x90, 60, 0 };
+        midictrl->MidiSend( &msg );
+        midictrl->BeginBlock( 64, 48000.f );
+        midictrl->DispatchEvent();
+        EXPECT_EQ( 0, midictrl->GetVelocity(60) );
+        EXPECT_EQ( 0, midictrl->GetOnKeyNum() );
+    }
+
+    // 1024フレームのコールバックでは、前のコールバックからの経過時間に応じて1024フレーム全体に配置される
+    TEST_F(MidiTest, BeginBlockAt)
+    {
+        MidiCtrl* midictrl = MidiCtrl::GetInstance();
+        const int      frames = 1024;
+        const float    fs     = 48000.f;
+        const uint64_t t0     = 1000000000ull;
+        const uint64_t period = (uint64_t)(frames * 1e9 / fs);
+        const unsigned char msg[3] = { 0x90, 60, 100 };
+
+        midictrl->BeginBlockAt( frames, fs, t0 );
+        EXPECT_EQ( MidiCtrl::kNoEvent, midictrl->NextEventOffset() );
+
+        // 前のコールバックより前、コールバック内の各位置、次のコールバックより後
+        const int positions[] = { 10, 255, 256, 600, 1000 };
+        midictrl->MidiSendAt( msg, 3, t0 - 1000 );
+        for( int pos : positions ) {
+            midictrl->MidiSendAt( msg, 3, t0 + (uint64_t)((pos + 0.5) * 1e9 / fs) );
+        }
+        midictrl->MidiSendAt( msg, 3, t0 + period * 2 );
+
+        midictrl->BeginBlockAt( frames, fs, t0 + period );
+        EXPECT_EQ( 0, midictrl->NextEventOffset() );
+        midictrl->DispatchEvent();
+        for( int pos : positions ) {
+            EXPECT_EQ( pos, midictrl->NextEventOffset() );
+            midictrl->DispatchEvent();
+        }
+        EXPECT_EQ( frames - 1, midictrl->NextEventOffset() );
+        midictrl->DispatchEvent();
+        EXPECT_EQ( MidiCtrl::kNoEvent, midictrl->NextEventOffset() );
+    }
+}
+
+namespace{
+    TEST(MidiEventQueueTest, PushPop)
+    {
+        MidiEventQueue queue;
+        MidiEvent ev = {};
+
+        EXPECT_EQ( false, queue.Pop( &ev ) );
+
+        // 満杯になるまで積める
+        for( uint32_t ix=0; ix<MidiEventQueue::kCapacity; ix++ ) {
+            ev.time_ns = ix;
+            EXPECT_EQ( true, queue.Push( ev ) );
+        }
+        EXPECT_EQ( false, queue.Push( ev ) );
+
+        // 積んだ順に取り出せる
+        for( uint32_t ix=0; ix<MidiEventQueue::kCapacity; ix++ ) {
+            EXPECT_EQ( true, queue.Pop( &ev ) );
+            EXPECT_EQ( ix, ev.time_ns );
+        }
+        EXPECT_EQ( false, queue.Pop( &ev ) );
+    }
+
+    TEST_F(MidiTest, Controller)
+    {
+        MidiCtrl* midictrl = MidiCtrl::GetInstance();
+        EXPECT_EQ( 0, midictrl->GetModWheel() );
+        EXPECT_EQ( 0, midictrl->GetAftertouch( 60 ) );
+
+        const unsigned char wheel[3] = { 0xB0, 1, 100 };
+        midictrl->MidiRecv( wheel, 3 );
+        EXPECT_EQ( 100, midictrl->GetModWheel() );
+
+        // チャンネルプレッシャー(2バイト)とポリフォニックキープレッシャーの大きい方
+        const unsigned char channel[2] = { 0xD0, 30 };
+        const unsigned char key[3]     = { 0xA0, 60, 80 };
+        midictrl->MidiRecv( channel, 2 );
+        midictrl->MidiRecv( key, 3 );
+        EXPECT_EQ( 80, midictrl->GetAftertouch( 60 ) );
+        EXPECT_EQ( 30, midictrl->GetAftertouch( 61 ) );
+
+        // キーオンし直すとキープレッシャーは戻る
+        const unsigned char on[3] = { 0x90, 60, 100 };
+        midictrl->MidiRecv( on, 3 );
+        EXPECT_EQ( 30, midictrl->GetAftertouch( 60 ) );
+    }
+}
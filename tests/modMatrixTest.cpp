@@ -0,0 +1,69 @@
+#include <gtest/gtest.h>
+
+#include "mod_matrix.h"
+
+namespace{
+    class ModMatrixTest : public ::testing::Test
+    {
+    protected:
+        virtual void SetUp()
+        {
+        }
+
+        virtual void TearDown()
+        {
+        }
+    };
+
+    TEST_F(ModMatrixTest, Process)
+    {
+        ModMatrix matrix;
+        float src[ModMatrix::kSrcNum] = {};
+        float dst[ModMatrix::kDstNum];
+
+        src[ModMatrix::kSrcLfo1]     = 0.5f;
+        src[ModMatrix::kSrcVelocity] = 1.f;
+        src[ModMatrix::kSrcModWheel] = 0.25f;
+
+        // 接続が無ければ全て0
+        matrix.Process( src, dst );
+        for( int ix=0; ix<ModMatrix::kDstNum; ix++ ) {
+            EXPECT_EQ( 0.f, dst[ix] );
+        }
+
+        // 同じ変調先への接続は足し合わせる
+        EXPECT_TRUE( matrix.SetSlot( 0, ModMatrix::kSrcLfo1, ModMatrix::kDstPitch, 2.f ) );
+        EXPECT_TRUE( matrix.SetSlot( 1, ModMatrix::kSrcModWheel, ModMatrix::kDstPitch, 4.f ) );
+        EXPECT_TRUE( matrix.SetSlot( 2, ModMatrix::kSrcVelocity, ModMatrix::kDstAmp, -0.5f ) );
+        EXPECT_EQ( 3, matrix.GetSlotNum() );
+        matrix.Process( src, dst );
+        EXPECT_FLOAT_EQ( 2.f, dst[ModMatrix::kDstPitch] );
+        EXPECT_FLOAT_EQ( -0.5f, dst[ModMatrix::kDstAmp] );
+        EXPECT_EQ( 0.f, dst[ModMatrix::kDstCutoff] );
+
+        // 設定し直すと置き換わり、量0なら外れる
+        EXPECT_TRUE( matrix.SetSlot( 1, ModMatrix::kSrcModWheel, ModMatrix::kDstCutoff, 4.f ) );
+        EXPECT_TRUE( matrix.SetSlot( 2, ModMatrix::kSrcVelocity, ModMatrix::kDstAmp, 0.f ) );
+        EXPECT_EQ( 2, matrix.GetSlotNum() );
+        matrix.Process( src, dst );
+        EXPECT_FLOAT_EQ( 1.f, dst[ModMatrix::kDstPitch] );
+        EXPECT_FLOAT_EQ( 1.f, dst[ModMatrix::kDstCutoff] );
+        EXPECT_EQ( 0.f, dst[ModMatrix::kDstAmp] );
+
+        // 範囲外
+        EXPECT_FALSE( matrix.SetSlot( ModMatrix::kSlotNum, ModMatrix::kSrcLfo1, ModMatrix::kDstPitch, 1.f ) );
+        EXPECT_FALSE( matrix.SetSlot( 0, ModMatrix::kSrcNum, ModMatrix::kDstPitch, 1.f ) );
+
+        matrix.Clear();
+        EXPECT_EQ( 0, matrix.GetSlotNum() );
+    }
+
+    TEST_F(ModMatrixTest, Name)
+    {
+        EXPECT_EQ( ModMatrix::kSrcLfo2, ModMatrix::SourceFromName( "lfo2" ) );
+        EXPECT_EQ( ModMatrix::kSrcAftertouch, ModMatrix::SourceFromName( "aftertouch" ) );
+        EXPECT_EQ( -1, ModMatrix::SourceFromName( "pitch" ) );
+        EXPECT_EQ( ModMatrix::kDstPan, ModMatrix::DestFromName( "pan" ) );
+        EXPECT_EQ( -1, ModMatrix::DestFromName( "lfo1" ) );
+    }
+}
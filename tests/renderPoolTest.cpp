@@ -0,0 +1,125 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "render_pool.h"
+
+namespace{
+    class RenderPoolTest : public ::testing::Test
+    {
+    protected:
+        virtual void SetUp()
+        {
+        }
+
+        virtual void TearDown()
+        {
+        }
+    };
+
+    static void count_job( int job, void* userdata )
+    {
+        std::atomic<int>* count = (std::atomic<int>*)userdata;
+        count[job]++;
+    }
+
+    // 全ジョブがちょうど1回ずつ実行される
+    TEST_F(RenderPoolTest, Run)
+    {
+        RenderPool* pool = new RenderPool( 4 );
+        EXPECT_EQ( 4, pool->GetWorkerNum() );
+
+        const int job_num = 13;
+        std::atomic<int> count[job_num];
+        for( int run=0; run<100; run++ ) {
+            for( int ix=0; ix<job_num; ix++ ) { count[ix] = 0; }
+            pool->Run( count_job, count, job_num );
+            for( int ix=0; ix<job_num; ix++ ) {
+                EXPECT_EQ( 1, count[ix].load() );
+            }
+
+            int total = 0;
+            for( int ix=0; ix<pool->GetWorkerNum(); ix++ ) {
+                total += pool->GetWorkerJobNum( ix );
+            }
+            EXPECT_EQ( job_num, total );
+        }
+
+        delete pool;
+    }
+
+    // ジョブ数が毎回変わっても、遅れて起きたワーカーが前回の範囲でジョブを取ることは無い
+    TEST_F(RenderPoolTest, VaryingJobNum)
+    {
+        RenderPool* pool = new RenderPool( 4 );
+
+        std::atomic<int> count[32];
+        for( int run=0; run<2000; run++ ) {
+            const int job_num = (run * 7) % 32;
+            for( int ix=0; ix<32; ix++ ) { count[ix] = 0; }
+            pool->Run( count_job, count, job_num );
+
+            int total = 0;
+            for( int ix=0; ix<32; ix++ ) {
+                ASSERT_EQ( (ix < job_num) ? 1 : 0, count[ix].load() ) << run << ":" << ix;
+            }
+            for( int ix=0; ix<pool->GetWorkerNum(); ix++ ) {
+                total += pool->GetWorkerJobNum( ix );
+            }
+            ASSERT_EQ( job_num, total );
+        }
+
+        delete pool;
+    }
+
+    // ワーカーが眠っていても、Runは起きてくるのを待たずに戻る
+    TEST_F(RenderPoolTest, SleepingWorkers)
+    {
+        RenderPool* pool = new RenderPool( 4 );
+        std::atomic<int> count[8];
+        for( int ix=0; ix<8; ix++ ) { count[ix] = 0; }
+
+        std::this_thread::sleep_for( std::chrono::milliseconds( 50 ) );
+        pool->Run( count_job, count, 8 );
+        for( int ix=0; ix<8; ix++ ) {
+            EXPECT_EQ( 1, count[ix].load() );
+        }
+
+        delete pool;
+    }
+
+    // Runが周期的に呼ばれていても、ブロックの合間にワーカーは眠る
+    TEST_F(RenderPoolTest, SleepBetweenRuns)
+    {
+        RenderPool* pool = new RenderPool( 4 );
+        std::atomic<int> count[8];
+
+        int asleep = 0;
+        for( int run=0; run<20; run++ ) {
+            for( int ix=0; ix<8; ix++ ) { count[ix] = 0; }
+            pool->Run( count_job, count, 8 );
+            for( int ix=0; ix<8; ix++ ) {
+                EXPECT_EQ( 1, count[ix].load() );
+            }
+            std::this_thread::sleep_for( std::chrono::milliseconds( 2 ) );
+            asleep += (pool->GetSleepingNum() == pool->GetWorkerNum() - 1);
+        }
+        EXPECT_LE( 15, asleep );
+
+        delete pool;
+    }
+
+    // ワーカー1つなら呼び出しスレッドだけで処理する
+    TEST_F(RenderPoolTest, SingleWorker)
+    {
+        RenderPool* pool = new RenderPool( 1 );
+        std::atomic<int> count[3];
+        for( int ix=0; ix<3; ix++ ) { count[ix] = 0; }
+
+        pool->Run( count_job, count, 3 );
+        EXPECT_EQ( 3, pool->GetWorkerJobNum( 0 ) );
+
+        delete pool;
+    }
+}
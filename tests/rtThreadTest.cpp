@@ -0,0 +1,80 @@
+#include <gtest/gtest.h>
+
+#include <cfloat>
+#include <thread>
+#include <vector>
+#include "rt_thread.h"
+
+namespace{
+    class RtThreadTest : public ::testing::Test
+    {
+    protected:
+        virtual void SetUp()
+        {
+        }
+
+        virtual void TearDown()
+        {
+        }
+    };
+
+    TEST_F(RtThreadTest, FlushToZero)
+    {
+        // FTZ/DAZはスレッド毎の設定なので、別スレッドで試す
+        bool  enabled = false;
+        float result  = -1.f;
+        std::thread th( [&]{
+            enabled = RtThread::EnableFlushToZero();
+            volatile float tiny = FLT_MIN;
+            result = tiny * 0.25f;  // 非正規化数になる計算
+        } );
+        th.join();
+
+        if( enabled ) {
+            EXPECT_EQ( 0.f, result );
+        }
+        else {
+            EXPECT_LT( 0.f, result );
+        }
+    }
+
+    TEST_F(RtThreadTest, FlushToZeroIsPerThread)
+    {
+        bool before = RtThread::IsFlushToZero();
+        std::thread th( []{ RtThread::EnableFlushToZero(); } );
+        th.join();
+        EXPECT_EQ( before, RtThread::IsFlushToZero() );
+    }
+
+    TEST_F(RtThreadTest, Prefault)
+    {
+        std::vector<uint8_t> buf( 100 * 1000 );
+        EXPECT_EQ( buf.size(), RtThread::Prefault( buf.data(), buf.size() ) );
+        EXPECT_EQ( 0u, RtThread::Prefault( buf.data(), 0 ) );
+        EXPECT_EQ( RtThread::kStackPrefaultBytes, RtThread::PrefaultStack() );
+    }
+
+    TEST_F(RtThreadTest, PrefaultWritable)
+    {
+        // 値は変えない
+        std::vector<uint8_t> buf( 100 * 1000 );
+        for( size_t ix=0; ix<buf.size(); ix++ ) { buf[ix] = (uint8_t)ix; }
+        EXPECT_EQ( buf.size(), RtThread::PrefaultWritable( buf.data(), buf.size() ) );
+        for( size_t ix=0; ix<buf.size(); ix++ ) {
+            ASSERT_EQ( (uint8_t)ix, buf[ix] );
+        }
+        EXPECT_EQ( 0u, RtThread::PrefaultWritable( buf.data(), 0 ) );
+    }
+
+    TEST_F(RtThreadTest, Status)
+    {
+        RtThread::Status status;
+        EXPECT_FALSE( status.ftz );
+        EXPECT_FALSE( status.sched_request );
+        EXPECT_EQ( RtThread::kLockNone, status.lock );
+
+        // 権限が無ければ失敗してよいが、取得はできる
+        int policy, priority;
+        EXPECT_TRUE( RtThread::GetPriority( &policy, &priority ) );
+    }
+}
@@ -0,0 +1,211 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "sample_converter.h"
+
+namespace{
+    class SampleConverterTest : public ::testing::Test
+    {
+    protected:
+        virtual void SetUp()
+        {
+            // 端数の処理も通るように4の倍数にしない
+            for( int ix=0; ix<kFrames; ix++ ) {
+                left_[ix]  = (float)ix / kFrames * 2.f - 1.f;
+                right_[ix] = -left_[ix] * 0.5f;
+            }
+            buf_[0] = left_;
+            buf_[1] = right_;
+        }
+
+        virtual void TearDown()
+        {
+        }
+
+        // インターリーブのareasを作る
+        void SetInterleaved( SoundIoChannelArea* areas, char* mem, int channels, int bytes )
+        {
+            for( int ch=0; ch<channels; ch++ ) {
+                areas[ch].ptr  = mem + bytes * ch;
+                areas[ch].step = bytes * channels;
+            }
+        }
+
+    public:
+        static const int kFrames = 299;
+        float        left_[kFrames];
+        float        right_[kFrames];
+        const float* buf_[2];
+    };
+
+    TEST_F(SampleConverterTest, Setup)
+    {
+        SampleConverter conv;
+        EXPECT_EQ( SampleConverter::kFloat32, conv.GetFormat() );
+
+        EXPECT_TRUE( conv.Setup( SampleConverter::kS16, true ) );
+        EXPECT_EQ( 2, conv.GetBytes() );
+        EXPECT_TRUE( conv.IsDithering() );
+
+        // float形式にはディザを加えない
+        EXPECT_TRUE( conv.Setup( SampleConverter::kFloat64, true ) );
+        EXPECT_EQ( 8, conv.GetBytes() );
+        EXPECT_FALSE( conv.IsDithering() );
+
+        EXPECT_FALSE( conv.Setup( 100, false ) );
+        EXPECT_EQ( SampleConverter::kFloat64, conv.GetFormat() );
+
+        EXPECT_EQ( SampleConverter::kS32, SampleConverter::FromSoundIoFormat( SoundIoFormatS32NE ) );
+        EXPECT_EQ( -1, SampleConverter::FromSoundIoFormat( SoundIoFormatU8 ) );
+    }
+
+    TEST_F(SampleConverterTest, Float)
+    {
+        SampleConverter conv;
+        std::vector<float>  f32( kFrames * 2 );
+        std::vector<double> f64( kFrames * 2 );
+        SoundIoChannelArea  areas[2];
+
+        conv.Setup( SampleConverter::kFloat32, false );
+        SetInterleaved( areas, (char*)f32.data(), 2, 4 );
+        conv.Write( areas, buf_, 2, kFrames );
+        EXPECT_EQ( (char*)f32.data() + sizeof(float) * kFrames * 2, areas[0].ptr );
+
+        conv.Setup( SampleConverter::kFloat64, false );
+        SetInterleaved( areas, (char*)f64.data(), 2, 8 );
+        conv.Write( areas, buf_, 2, kFrames );
+
+        for( int ix=0; ix<kFrames; ix++ ) {
+            EXPECT_EQ( left_[ix],  f32[ix*2] );
+            EXPECT_EQ( right_[ix], f32[ix*2 + 1] );
+            EXPECT_EQ( (double)left_[ix],  f64[ix*2] );
+            EXPECT_EQ( (double)right_[ix], f64[ix*2 + 1] );
+        }
+    }
+
+    TEST_F(SampleConverterTest, Saturate)
+    {
+        SampleConverter conv;
+        const float src[6] = { 2.f, -2.f, 1.f, -1.f, 0.5f, 0.f };
+        const float* buf[1] = { src };
+        int16_t s16[6];
+        int32_t s32[6];
+        SoundIoChannelArea area;
+
+        conv.Setup( SampleConverter::kS16, false );
+        area.ptr  = (char*)s16;
+        area.step = 2;
+        conv.Write( &area, buf, 1, 6 );
+        EXPECT_EQ( INT16_MAX, s16[0] );
+        EXPECT_EQ( INT16_MIN, s16[1] );
+        EXPECT_EQ( 32767,     s16[2] );
+        EXPECT_EQ( -32767,    s16[3] );
+        EXPECT_EQ( 16384,     s16[4] );
+        EXPECT_EQ( 0,         s16[5] );
+
+        conv.Setup( SampleConverter::kS32, false );
+        area.ptr  = (char*)s32;
+        area.step = 4;
+        conv.Write( &area, buf, 1, 6 );
+        EXPECT_EQ( 2147483520, s32[0] );
+        EXPECT_EQ( INT32_MIN,  s32[1] );
+        EXPECT_LT( 2147483000, s32[2] );
+        EXPECT_GT( -2147483000, s32[3] );
+        EXPECT_EQ( 0,          s32[5] );
+    }
+
+    TEST_F(SampleConverterTest, InterleavedMatchesStrided)
+    {
+        // インターリーブのステレオ（まとめて並べる）と、他の並び（1サンプルずつ書く）で結果が同じ
+        SampleConverter conv;
+        const int formats[] = { SampleConverter::kS16, SampleConverter::kS32, SampleConverter::kFloat64 };
+        for( int fmt : formats ) {
+            conv.Setup( fmt, false );
+            const int bytes = conv.GetBytes();
+            std::vector<char> inter( kFrames * 2 * bytes );
+            std::vector<char> wide( kFrames * 3 * bytes );
+            SoundIoChannelArea areas[2];
+
+            SetInterleaved( areas, inter.data(), 2, bytes );
+            conv.Write( areas, buf_, 2, kFrames );
+
+            // 間にすき間があるのでインターリーブとみなされない
+            areas[0].ptr  = wide.data();
+            areas[1].ptr  = wide.data() + bytes * 2;
+            areas[0].step = areas[1].step = bytes * 3;
+            conv.Write( areas, buf_, 2, kFrames );
+
+            for( int ix=0; ix<kFrames; ix++ ) {
+                EXPECT_EQ( 0, memcmp( &inter[bytes * ix * 2],     &wide[bytes * ix * 3],     bytes ) ) << fmt << " " << ix;
+                EXPECT_EQ( 0, memcmp( &inter[bytes * (ix*2 + 1)], &wide[bytes * (ix*3 + 2)], bytes ) ) << fmt << " " << ix;
+            }
+        }
+    }
+
+    TEST_F(SampleConverterTest, Dither)
+    {
+        // ディザの振れ幅は±1LSB以内で、平均はほぼ0
+        SampleConverter conv;
+        conv.Setup( SampleConverter::kS16, true );
+
+        const int num = 4096;
+        std::vector<float>   src( num, 1000.25f / 32767.f );
+        std::vector<int16_t> dst( num );
+        const float* buf[1] = { src.data() };
+        SoundIoChannelArea area;
+        area.ptr  = (char*)dst.data();
+        area.step = 2;
+        conv.Write( &area, buf, 1, num );
+
+        double sum = 0.0;
+        bool   varied = false;
+        for( int ix=0; ix<num; ix++ ) {
+            EXPECT_LE( 999,  dst[ix] );
+            EXPECT_GE( 1001, dst[ix] );
+            varied |= (dst[ix] != dst[0]);
+            sum += dst[ix];
+        }
+        EXPECT_TRUE( varied );
+        EXPECT_NEAR( 1000.25, sum / num, 0.05 );
+    }
+
+    TEST_F(SampleConverterTest, DitherS32)
+    {
+        // S32のディザは24bitの分解能で加える（下位8bitは0、±1LSB(=256)以内で平均はほぼ0）
+        SampleConverter conv;
+        conv.Setup( SampleConverter::kS32, true );
+        EXPECT_TRUE( conv.IsDithering() );
+
+        const int num = 4096;
+        std::vector<float>   src( num, 100000.25f / 8388607.f );
+        std::vector<int32_t> dst( num );
+        const float* buf[1] = { src.data() };
+        SoundIoChannelArea area;
+        area.ptr  = (char*)dst.data();
+        area.step = 4;
+        conv.Write( &area, buf, 1, num );
+
+        double sum = 0.0;
+        bool   varied = false;
+        for( int ix=0; ix<num; ix++ ) {
+            EXPECT_EQ( 0, dst[ix] & 0xFF );
+            EXPECT_LE( 99999 * 256,  dst[ix] );
+            EXPECT_GE( 100001 * 256, dst[ix] );
+            varied |= (dst[ix] != dst[0]);
+            sum += dst[ix] / 256;
+        }
+        EXPECT_TRUE( varied );
+        EXPECT_NEAR( 100000.25, sum / num, 0.05 );
+
+        // 端の値でも範囲に収まる
+        const float edge[2] = { 1.5f, -1.5f };
+        int32_t out[2];
+        buf[0]    = edge;
+        area.ptr  = (char*)out;
+        conv.Write( &area, buf, 1, 2 );
+        EXPECT_EQ( 8388607 * 256, out[0] );
+        EXPECT_EQ( INT32_MIN,     out[1] );
+    }
+}
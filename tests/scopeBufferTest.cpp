@@ -0,0 +1,119 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <cstdint>
+#include "scope_buffer.h"
+
+namespace{
+    class ScopeBufferTest : public ::testing::Test
+    {
+    protected:
+        virtual void SetUp()
+        {
+        }
+
+        virtual void TearDown()
+        {
+        }
+    };
+
+    TEST_F(ScopeBufferTest, Empty)
+    {
+        ScopeBuffer<int, 8> scope;
+        int buf[8];
+        memset( buf, 0xff, sizeof(buf) );
+
+        EXPECT_TRUE( scope.Snapshot( buf, 8 ) );
+        for( int ix=0; ix<8; ix++ ) {
+            EXPECT_EQ( 0, buf[ix] );
+        }
+        EXPECT_EQ( 0u, scope.GetWritten() );
+    }
+
+    TEST_F(ScopeBufferTest, WriteSnapshot)
+    {
+        ScopeBuffer<int, 8> scope;
+        int data[] = { 1, 2, 3 };
+        int buf[8];
+
+        // 書いた数が足りない分は先頭を0で埋める
+        scope.Write( data, 3 );
+        EXPECT_TRUE( scope.Snapshot( buf, 5 ) );
+        EXPECT_EQ( 0, buf[0] );
+        EXPECT_EQ( 0, buf[1] );
+        EXPECT_EQ( 1, buf[2] );
+        EXPECT_EQ( 2, buf[3] );
+        EXPECT_EQ( 3, buf[4] );
+
+        // 終端をまたいでも直近のデータが古い順に並ぶ
+        for( int ix=0; ix<5; ix++ ) {
+            int val = 4 + ix * 3;
+            int block[] = { val, val+1, val+2 };
+            scope.Write( block, 3 );
+        }
+        EXPECT_EQ( 18u, scope.GetWritten() );
+        EXPECT_TRUE( scope.Snapshot( buf, 8 ) );
+        for( int ix=0; ix<8; ix++ ) {
+            EXPECT_EQ( 11 + ix, buf[ix] );
+        }
+
+        // 容量を超える量は取り出せない
+        int big[9];
+        EXPECT_FALSE( scope.Snapshot( big, 9 ) );
+    }
+
+    TEST_F(ScopeBufferTest, WriteOverCapacity)
+    {
+        ScopeBuffer<int, 8> scope;
+        int data[20];
+        int buf[8];
+        for( int ix=0; ix<20; ix++ ) {
+            data[ix] = ix;
+        }
+
+        // 容量を超える分は末尾だけ残る
+        scope.Write( data, 20 );
+        EXPECT_EQ( 20u, scope.GetWritten() );
+        EXPECT_TRUE( scope.Snapshot( buf, 8 ) );
+        for( int ix=0; ix<8; ix++ ) {
+            EXPECT_EQ( 12 + ix, buf[ix] );
+        }
+    }
+
+    TEST_F(ScopeBufferTest, Concurrent)
+    {
+        // 書き手は連番を書き続け、読み手が取り出せた時は必ず連続していること
+        static ScopeBuffer<uint32_t, 64> scope;
+        std::atomic<bool> quit( false );
+
+        std::thread writer( [&]{
+            uint32_t block[13];
+            uint32_t val = 1;
+            while( !quit.load() ) {
+                for( int ix=0; ix<13; ix++ ) {
+                    block[ix] = val++;
+                }
+                scope.Write( block, 13 );
+            }
+        } );
+
+        uint32_t buf[48];
+        int ok_num = 0;
+        for( int loop=0; loop<20000; loop++ ) {
+            if( !scope.Snapshot( buf, 48 ) ) {
+                continue;
+            }
+            ok_num++;
+            for( int ix=1; ix<48; ix++ ) {
+                if( buf[ix-1] != 0 ) {
+                    ASSERT_EQ( buf[ix-1] + 1, buf[ix] );
+                }
+            }
+        }
+
+        quit.store( true );
+        writer.join();
+        EXPECT_LT( 0, ok_num );
+    }
+}
@@ -1,11 +1,11 @@
 #include <gtest/gtest.h>
 
 #include <math.h>
+#include <chrono>
 
 #include "midi.h"
 #include "audio.h"
 #include "synth.h"
-#include "screen_ui.h"
 
 namespace {
     class SynthTest : public ::testing::Test
@@ -17,12 +17,10 @@ namespace {
             AudioCtrl::DummyMode();
             AudioCtrl::Create();
             Synth::Create( 440.0 );
-            ScreenUI::Create();
         }
 
         virtual void TearDown()
         {
-            ScreenUI::Destroy();
             Synth::Destroy();
             AudioCtrl::Destroy();
             MidiCtrl::Destroy();
@@ -42,14 +40,140 @@ namespace {
         EXPECT_NE( nullptr, synth );
     }
 
-    TEST_F(SynthTest, SignalCallback)
+    TEST_F(SynthTest, RenderBlock)
     {
         Synth* synth = Synth::GetInstance();
-        EXPECT_EQ( 0.0, synth->SignalCallback() );
+        const int frames   = AudioCtrl::kMaxBlockFrames + 10;  // ブロック分割も確認
+        const int channels = 2;
+        float buf[frames * channels];
+        float* out[channels] = { &buf[0], &buf[frames] };
+
+        for( int ix=0; ix<frames*channels; ix++ ) { buf[ix] = 1.f; }
+        synth->RenderBlock( out, frames, channels );
+
+        // 押鍵していないので無音
+        for( int ix=0; ix<frames*channels; ix++ ) {
+            EXPECT_EQ( 0.f, buf[ix] );
+        }
+    }
+
+    TEST_F(SynthTest, NoteOn)
+    {
+        Synth* synth = Synth::GetInstance();
+        MidiCtrl* midictrl = MidiCtrl::GetInstance();
+        const int frames = 1024;
+        float buf[frames];
+        float* out = buf;
+
+        std::vector<unsigned char> msg = { 0x90, 69, 100 };
+        midictrl->MidiSend( &msg );
+        synth->RenderBlock( &out, frames, 1 );
+
+        // 発音している
+        float peak = 0.f;
+        for( int ix=0; ix<frames; ix++ ) {
+            peak = (fabs(buf[ix]) > peak) ? fabs(buf[ix]) : peak;
+        }
+        EXPECT_LT( 0.f, peak );
+    }
+
+    struct MonitorLog {
+        float sum;
+        int   num;
+        int   calls;
+    };
+
+    static void monitor_log( const float* data, int num, void* userdata )
+    {
+        MonitorLog* log = (MonitorLog*)userdata;
+        for( int ix=0; ix<num; ix++ ) {
+            log->sum += data[ix];
+        }
+        log->num += num;
+        log->calls++;
+    }
+
+    // 監視関数には1チャンネル目が内部のブロック毎に渡る
+    TEST_F(SynthTest, Monitor)
+    {
+        Synth* synth = Synth::GetInstance();
+        MidiCtrl* midictrl = MidiCtrl::GetInstance();
+        const int frames   = AudioCtrl::kMaxBlockFrames * 2 + 10;
+        const int channels = 2;
+        float buf[frames * channels];
+        float* out[channels] = { &buf[0], &buf[frames] };
+        MonitorLog log = { 0.f, 0, 0 };
+
+        synth->MonitorSet( monitor_log, &log );
+        std::vector<unsigned char> msg = { 0x90, 69, 100 };
+        midictrl->MidiSend( &msg );
+        synth->RenderBlock( out, frames, channels );
+
+        float sum = 0.f;
+        for( int ix=0; ix<frames; ix++ ) {
+            sum += buf[ix];
+        }
+        EXPECT_EQ( frames, log.num );
+        EXPECT_EQ( 3, log.calls );
+        EXPECT_FLOAT_EQ( sum, log.sum );
+
+        // 外した後は呼ばない
+        synth->MonitorUnset();
+        synth->RenderBlock( out, frames, channels );
+        EXPECT_EQ( 3, log.calls );
+    }
+
+    // 1回のコールバックが内部のブロックより長くても、イベントは届いた時刻に応じた位置で発音する
+    TEST_F(SynthTest, NoteOnTiming)
+    {
+        Synth* synth = Synth::GetInstance();
+        MidiCtrl* midictrl = MidiCtrl::GetInstance();
+        const int frames = 1024;
+        const int onset  = 700;  // 4つ目の内部ブロック
+        float buf[frames];
+        float* out = buf;
+
+        // 1回目のコールバックの時刻を基準に、onsetフレーム後の時刻でノートオンを送る
+        uint64_t t0 = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch() ).count();
+        synth->RenderBlock( &out, frames, 1 );
+        const unsigned char msg[3] = { 0x90, 69, 100 };
+        midictrl->MidiSendAt( msg, 3, t0 + (uint64_t)(onset * 1e9 / 48000.0) );
+        synth->RenderBlock( &out, frames, 1 );
+
+        // 1回目のコールバックがt0より遅れた分だけ前にずれることがある
+        int first = frames;
+        for( int ix=0; ix<frames; ix++ ) {
+            if( buf[ix] != 0.f ) { first = ix; break; }
+        }
+        EXPECT_LE( onset - 96, first );
+        EXPECT_GE( onset + 2, first );
     }
 }
 
 namespace {
+    /**
+     * @brief MIDIメッセージを1つ送って反映し、blocksブロックレンダリングする
+     */
+    static void steal_send( VoiceCtrl* voicectrl, unsigned char status, int nn, int blocks )
+    {
+        MidiCtrl* midictrl = MidiCtrl::GetInstance();
+        const int frames = AudioCtrl::kMaxBlockFrames;
+        float out[frames];
+
+        std::vector<unsigned char> msg = { status, (unsigned char)nn, (unsigned char)((status == 0x90) ? 100 : 0) };
+        midictrl->MidiSend( &msg );
+        midictrl->BeginBlock( frames, 48000.f );
+        while( midictrl->NextEventOffset() != MidiCtrl::kNoEvent ) {
+            midictrl->DispatchEvent();
+        }
+        voicectrl->Trigger();
+        midictrl->ResetStatusChange();
+        for( int ix=0; ix<blocks; ix++ ) {
+            voicectrl->RenderBlock( out, frames );
+        }
+    }
+
     class VoiceCtrlTest : public ::testing::Test
     {
     protected:
@@ -74,4 +198,253 @@ namespace {
 
         voicectrl.Trigger();
     }
-}
\ No newline at end of file
+
+    // 別に確保しているボイス、VoiceBank、RenderPoolまでプリフォルトする
+    TEST_F(VoiceCtrlTest, Prefault)
+    {
+        VoiceCtrl voicectrl;
+        const size_t single = voicectrl.Prefault();
+        EXPECT_EQ( sizeof(VoiceCtrl) + sizeof(VoiceBank) + VoiceBank::kLaneNum * sizeof(Voice), single );
+
+        voicectrl.SetRenderThreadNum( 2 );
+        EXPECT_EQ( single + sizeof(RenderPool), voicectrl.Prefault() );
+    }
+
+    // スレッド数によらず同じ結果になる
+    TEST_F(VoiceCtrlTest, RenderThread)
+    {
+        MidiCtrl* midictrl = MidiCtrl::GetInstance();
+        VoiceCtrl single;
+        VoiceCtrl multi;
+        multi.SetRenderThreadNum( 4 );
+        EXPECT_EQ( 4, multi.GetRenderThreadNum() );
+
+        for( int nn=48; nn<48+12; nn++ ) {
+            std::vector<unsigned char> msg = { 0x90, (unsigned char)nn, 100 };
+            midictrl->MidiSend( &msg );
+        }
+        midictrl->BeginBlock( 64, 48000.f );
+        while( midictrl->NextEventOffset() != MidiCtrl::kNoEvent ) {
+            midictrl->DispatchEvent();
+        }
+        single.Trigger();
+        multi.Trigger();
+        midictrl->ResetStatusChange();
+
+        const int frames = AudioCtrl::kMaxBlockFrames;
+        float out_single[frames];
+        float out_multi[frames];
+        for( int block=0; block<4; block++ ) {
+            single.RenderBlock( out_single, frames );
+            multi.RenderBlock( out_multi, frames );
+            for( int ix=0; ix<frames; ix++ ) {
+                EXPECT_EQ( out_single[ix], out_multi[ix] );
+            }
+        }
+    }
+
+    // 発音数はトリガーで増え、リリースが終わったブロックの次から減る
+    TEST_F(VoiceCtrlTest, ActiveVoice)
+    {
+        MidiCtrl* midictrl = MidiCtrl::GetInstance();
+        VoiceCtrl voicectrl;
+        Patch patch;
+        patch.release_ms = 1;  // 48サンプル
+        voicectrl.SetPatch( patch );
+
+        const int frames = AudioCtrl::kMaxBlockFrames;
+        float out[frames];
+        voicectrl.RenderBlock( out, frames );
+        EXPECT_EQ( 0, voicectrl.GetActiveVoiceNum() );
+
+        for( int nn=60; nn<63; nn++ ) {
+            std::vector<unsigned char> msg = { 0x90, (unsigned char)nn, 100 };
+            midictrl->MidiSend( &msg );
+        }
+        midictrl->BeginBlock( frames, 48000.f );
+        while( midictrl->NextEventOffset() != MidiCtrl::kNoEvent ) {
+            midictrl->DispatchEvent();
+        }
+        voicectrl.Trigger();
+        midictrl->ResetStatusChange();
+        voicectrl.RenderBlock( out, frames );
+        EXPECT_EQ( 3, voicectrl.GetActiveVoiceNum() );
+
+        for( int nn=60; nn<63; nn++ ) {
+            std::vector<unsigned char> msg = { 0x80, (unsigned char)nn, 0 };
+            midictrl->MidiSend( &msg );
+        }
+        midictrl->BeginBlock( frames, 48000.f );
+        while( midictrl->NextEventOffset() != MidiCtrl::kNoEvent ) {
+            midictrl->DispatchEvent();
+        }
+        voicectrl.Trigger();
+        midictrl->ResetStatusChange();
+        voicectrl.RenderBlock( out, frames );
+        EXPECT_EQ( 3, voicectrl.GetActiveVoiceNum() );
+        EXPECT_EQ( 0.f, out[frames-1] );
+
+        voicectrl.RenderBlock( out, frames );
+        EXPECT_EQ( 0, voicectrl.GetActiveVoiceNum() );
+        for( int ix=0; ix<frames; ix++ ) {
+            EXPECT_EQ( 0.f, out[ix] );
+        }
+    }
+
+    // ポリ数を超えると横取りし、発音数はポリ数を超えない
+    TEST_F(VoiceCtrlTest, Steal)
+    {
+        MidiCtrl* midictrl = MidiCtrl::GetInstance();
+        const int modes[] = { VoiceCtrl::kStealOldest, VoiceCtrl::kStealQuietest, VoiceCtrl::kStealReleasedFirst };
+        for( int mode : modes ) {
+            VoiceCtrl voicectrl;
+            Patch patch;
+            patch.poly_num   = 2;
+            patch.steal_mode = mode;
+            voicectrl.SetPatch( patch );
+
+            const int frames = AudioCtrl::kMaxBlockFrames;
+            float out[frames];
+            for( int nn=60; nn<64; nn++ ) {
+                std::vector<unsigned char> msg = { 0x90, (unsigned char)nn, 100 };
+                midictrl->MidiSend( &msg );
+                midictrl->BeginBlock( frames, 48000.f );
+                while( midictrl->NextEventOffset() != MidiCtrl::kNoEvent ) {
+                    midictrl->DispatchEvent();
+                }
+                voicectrl.Trigger();
+                midictrl->ResetStatusChange();
+                voicectrl.RenderBlock( out, frames );
+                EXPECT_EQ( (nn < 61) ? 1 : 2, voicectrl.GetActiveVoiceNum() );
+            }
+
+            for( int nn=60; nn<64; nn++ ) {
+                std::vector<unsigned char> msg = { 0x80, (unsigned char)nn, 0 };
+                midictrl->MidiSend( &msg );
+            }
+            midictrl->BeginBlock( frames, 48000.f );
+            while( midictrl->NextEventOffset() != MidiCtrl::kNoEvent ) {
+                midictrl->DispatchEvent();
+            }
+            voicectrl.Trigger();
+            midictrl->ResetStatusChange();
+        }
+    }
+
+    /**
+     * @brief 横取りのポリシーが食い違う状態を作る（ポリ数3）
+     * @note  60: 一番古い、押鍵中、サステインレベル
+     *        61: 2番目、リリース中（リリースが長いのでほぼサステインレベル）
+     *        62: 一番新しい、押鍵中、アタックの途中（一番小さい）
+     */
+    static void steal_setup( VoiceCtrl* voicectrl, int mode, bool same_note )
+    {
+        Patch patch;
+        patch.poly_num        = 3;
+        patch.steal_mode      = mode;
+        patch.same_note_reuse = same_note;
+        patch.attack_ms       = 100;
+        patch.decay_ms        = 10;
+        patch.sustain_lv      = 0.5f;
+        patch.release_ms      = 5000;
+        voicectrl->SetPatch( patch );
+
+        steal_send( voicectrl, 0x90, 60, 40 );
+        steal_send( voicectrl, 0x90, 61, 40 );
+        steal_send( voicectrl, 0x80, 61, 2 );
+        steal_send( voicectrl, 0x90, 62, 1 );
+        EXPECT_EQ( 3, voicectrl->GetActiveVoiceNum() );
+    }
+
+    TEST_F(VoiceCtrlTest, StealPolicy)
+    {
+        struct { int mode; int stolen; } cases[] = {
+            { VoiceCtrl::kStealOldest,        60 },
+            { VoiceCtrl::kStealReleasedFirst, 61 },
+            { VoiceCtrl::kStealQuietest,      62 },
+        };
+        for( auto c : cases ) {
+            VoiceCtrl voicectrl;
+            steal_setup( &voicectrl, c.mode, false );
+            steal_send( &voicectrl, 0x90, 63, 2 );
+
+            EXPECT_EQ( 3, voicectrl.GetActiveVoiceNum() ) << c.mode;
+            EXPECT_TRUE( voicectrl.IsNoteActive( 63 ) ) << c.mode;
+            for( int nn=60; nn<63; nn++ ) {
+                EXPECT_EQ( nn != c.stolen, voicectrl.IsNoteActive( nn ) ) << c.mode << ":" << nn;
+            }
+        }
+    }
+
+    // 同じノートを鳴らしているボイスがあれば、横取りせずにそのボイスで鳴らし直す
+    TEST_F(VoiceCtrlTest, StealSameNote)
+    {
+        for( int same_note=0; same_note<2; same_note++ ) {
+            VoiceCtrl voicectrl;
+            steal_setup( &voicectrl, VoiceCtrl::kStealOldest, same_note == 1 );
+            steal_send( &voicectrl, 0x90, 61, 2 );
+
+            EXPECT_EQ( 3, voicectrl.GetActiveVoiceNum() ) << same_note;
+            EXPECT_TRUE( voicectrl.IsNoteActive( 61 ) ) << same_note;
+            EXPECT_TRUE( voicectrl.IsNoteActive( 62 ) ) << same_note;
+            EXPECT_EQ( same_note == 1, voicectrl.IsNoteActive( 60 ) ) << same_note;  // 使い回さなければ一番古い60を横取りする
+        }
+    }
+
+    // ユニゾン: 1ノートでunison_num個のレーンを鳴らし、7ボイス x 8ノートが鳴る。スレッド数によらず同じ結果になる
+    TEST_F(VoiceCtrlTest, Unison)
+    {
+        MidiCtrl* midictrl = MidiCtrl::GetInstance();
+        VoiceCtrl single;
+        VoiceCtrl multi;
+        Patch patch;
+        patch.poly_num   = 8;
+        patch.unison_num = 7;
+        patch.release_ms = 1;
+        single.SetPatch( patch );
+        multi.SetPatch( patch );
+        multi.SetRenderThreadNum( 4 );
+
+        const int frames = AudioCtrl::kMaxBlockFrames;
+        float out_single[frames];
+        float out_multi[frames];
+
+        for( int nn=48; nn<48+8; nn++ ) {
+            std::vector<unsigned char> msg = { 0x90, (unsigned char)nn, 100 };
+            midictrl->MidiSend( &msg );
+        }
+        midictrl->BeginBlock( frames, 48000.f );
+        while( midictrl->NextEventOffset() != MidiCtrl::kNoEvent ) {
+            midictrl->DispatchEvent();
+        }
+        single.Trigger();
+        multi.Trigger();
+        midictrl->ResetStatusChange();
+
+        float peak = 0.f;
+        for( int block=0; block<4; block++ ) {
+            single.RenderBlock( out_single, frames );
+            multi.RenderBlock( out_multi, frames );
+            EXPECT_EQ( 7 * 8, single.GetActiveVoiceNum() );
+            for( int ix=0; ix<frames; ix++ ) {
+                EXPECT_EQ( out_single[ix], out_multi[ix] );
+                peak = (fabs(out_single[ix]) > peak) ? fabs(out_single[ix]) : peak;
+            }
+        }
+        EXPECT_LT( 0.f, peak );
+
+        for( int nn=48; nn<48+8; nn++ ) {
+            std::vector<unsigned char> msg = { 0x80, (unsigned char)nn, 0 };
+            midictrl->MidiSend( &msg );
+        }
+        midictrl->BeginBlock( frames, 48000.f );
+        while( midictrl->NextEventOffset() != MidiCtrl::kNoEvent ) {
+            midictrl->DispatchEvent();
+        }
+        single.Trigger();
+        midictrl->ResetStatusChange();
+        single.RenderBlock( out_single, frames );
+        single.RenderBlock( out_single, frames );
+        EXPECT_EQ( 0, single.GetActiveVoiceNum() );
+    }
+}
@@ -0,0 +1,195 @@
+#include <gtest/gtest.h>
+
+#include <math.h>
+#include "waveform.h"
+#include "voice_bank.h"
+
+namespace{
+    class VoiceBankTest : public ::testing::Test
+    {
+    protected:
+        virtual void SetUp()
+        {
+            Waveform::Create( 440.f, 48000.f );
+        }
+
+        virtual void TearDown()
+        {
+            Waveform::Destroy();
+        }
+    };
+
+    // 1ボイスずつGetSawで求めた値のMIXと一致する
+    TEST_F(VoiceBankTest, Render)
+    {
+        Waveform* wf = Waveform::GetInstance();
+        VoiceBank* bank = new VoiceBank( wf->GetWTBase(), wf->GetSamplerate() );
+
+        const int   lane_num = 4;
+        const int   lanes[lane_num] = { 0, 5, 13, 31 };
+        const float nns[lane_num]   = { 40.f, 60.f, 69.f, 90.f };
+        const float gains[lane_num] = { 0.1f, 0.2f, 0.3f, 0.4f };
+        const int   frames = VoiceBank::kMaxFrames;
+
+        uint64_t active_mask = 0;
+        uint32_t phase[lane_num];
+        for( int ix=0; ix<lane_num; ix++ ) {
+            bank->SetOsc( lanes[ix], wf->GetWTOffsetFromNN( wf->WF_SAW, nns[ix] ), wf->CalcWFromNoteNo( nns[ix], 0 ) );
+            active_mask |= (1ull << lanes[ix]);
+            phase[ix] = 0;
+        }
+        // 休止中のボイスのゲインは無視される
+        *(bank->GainGet( 1 )) = 100.f;
+
+        float out[frames];
+        for( int block=0; block<2; block++ ) {
+            for( int ix=0; ix<lane_num; ix++ ) {
+                float* gain = bank->GainGet( lanes[ix] );
+                for( int t=0; t<frames; t++ ) {
+                    gain[t * VoiceBank::GainStride()] = gains[ix];
+                }
+            }
+
+            bank->Render( out, frames, active_mask );
+
+            for( int t=0; t<frames; t++ ) {
+                float expect = 0.f;
+                for( int ix=0; ix<lane_num; ix++ ) {
+                    expect += wf->GetSaw( nns[ix], phase[ix] ) * gains[ix];
+                    phase[ix] += wf->CalcWFromNoteNo( nns[ix], 0 );
+                }
+                EXPECT_NEAR( expect, out[t], 0.0001 );
+            }
+        }
+
+        delete bank;
+    }
+
+    // 発音中のボイスが無ければ無音
+    TEST_F(VoiceBankTest, Silence)
+    {
+        Waveform* wf = Waveform::GetInstance();
+        VoiceBank* bank = new VoiceBank( wf->GetWTBase(), wf->GetSamplerate() );
+        float out[64];
+
+        for( int t=0; t<64; t++ ) { out[t] = 1.f; }
+        bank->Render( out, 64, 0 );
+        for( int t=0; t<64; t++ ) {
+            EXPECT_EQ( 0.f, out[t] );
+        }
+
+        delete bank;
+    }
+
+    // ローパスでカットオフより上の成分が減り、カットオフを動かすと1ブロックかけて係数が移る
+    TEST_F(VoiceBankTest, Filter)
+    {
+        Waveform* wf = Waveform::GetInstance();
+        const int frames = VoiceBank::kMaxFrames;
+        const int lane   = 3;
+
+        // 0:バイパス、1,2:ローパス(440Hz)
+        VoiceBank* banks[3];
+        for( int ix=0; ix<3; ix++ ) {
+            banks[ix] = new VoiceBank( wf->GetWTBase(), wf->GetSamplerate() );
+            banks[ix]->SetOsc( lane, wf->GetWTOffsetFromNN( wf->WF_SAW, 81.f ), wf->CalcWFromNoteNo( 81.f, 0 ) );
+            float* gain = banks[ix]->GainGet( lane );
+            for( int t=0; t<frames; t++ ) {
+                gain[t * VoiceBank::GainStride()] = 1.f;
+            }
+            if( ix > 0 ) {
+                banks[ix]->SetFilter( lane, 69.f, 0.707f );
+                banks[ix]->ResetFilter( lane );
+            }
+        }
+
+        // 880Hzの鋸歯状波なので、-12dB/octで基音から減る
+        float out[3][frames];
+        double power[3] = { 0.0, 0.0, 0.0 };
+        for( int block=0; block<4; block++ ) {
+            for( int ix=0; ix<3; ix++ ) {
+                banks[ix]->Render( out[ix], frames, 1ull << lane );
+                for( int t=0; t<frames; t++ ) {
+                    power[ix] += out[ix][t] * out[ix][t];
+                }
+            }
+        }
+        EXPECT_LT( power[1], power[0] / 16.0 );
+        EXPECT_EQ( power[1], power[2] );
+
+        // カットオフを上げたブロックの始めは、上げなかった場合とほとんど同じ
+        banks[2]->SetFilter( lane, 120.f, 0.707f );
+        banks[1]->Render( out[1], frames, 1ull << lane );
+        banks[2]->Render( out[2], frames, 1ull << lane );
+        EXPECT_NEAR( out[1][0], out[2][0], 0.01f );
+        EXPECT_GT( fabsf( out[1][frames-1] - out[2][frames-1] ), 0.01f );
+
+        for( int ix=0; ix<3; ix++ ) {
+            delete banks[ix];
+        }
+    }
+
+    // 等パワーのパン: 中央は両チャンネル1/√2、端は片側だけ。変えたブロックの間は直線で移る
+    TEST_F(VoiceBankTest, Pan)
+    {
+        Waveform* wf = Waveform::GetInstance();
+        VoiceBank* bank = new VoiceBank( wf->GetWTBase(), wf->GetSamplerate() );
+        const int frames = VoiceBank::kMaxFrames;
+        const int lane   = 9;
+
+        bank->SetOsc( lane, wf->GetWTOffsetFromNN( wf->WF_SAW, 60.f ), wf->CalcWFromNoteNo( 60.f, 0 ) );
+        float* gain = bank->GainGet( lane );
+        for( int t=0; t<frames; t++ ) {
+            gain[t * VoiceBank::GainStride()] = 1.f;
+        }
+
+        float  buf[3][frames];
+        float* out[3] = { buf[0], buf[1], buf[2] };
+        const uint64_t mask = 1ull << lane;
+
+        // 中央
+        bank->SetPan( lane, 0.f );
+        for( int group=0; group<VoiceBank::GroupNum(); group++ ) {
+            bank->RenderGroup( group, 0, frames, mask );
+        }
+        bank->Mix( out, 2, frames, mask );
+        for( int t=0; t<frames; t++ ) {
+            EXPECT_EQ( buf[0][t], buf[1][t] );
+        }
+        float peak = 0.f;
+        for( int t=0; t<frames; t++ ) {
+            peak = (fabsf( buf[0][t] ) > peak) ? fabsf( buf[0][t] ) : peak;
+        }
+        EXPECT_LT( 0.f, peak );
+
+        // 左端へ移す: ブロックの終わりで右は0になる
+        bank->SetPan( lane, -1.f, true );
+        for( int group=0; group<VoiceBank::GroupNum(); group++ ) {
+            bank->RenderGroup( group, 0, frames, mask );
+        }
+        bank->Mix( out, 2, frames, mask );
+        EXPECT_NEAR( 0.f, buf[1][frames-1], 1e-6f );
+        EXPECT_GT( fabsf( buf[1][0] ), 0.f );
+
+        // 3チャンネルなら左端は1チャンネル目だけ、中央は2チャンネル目だけ
+        for( int group=0; group<VoiceBank::GroupNum(); group++ ) {
+            bank->RenderGroup( group, 0, frames, mask );
+        }
+        bank->Mix( out, 3, frames, mask );
+        for( int t=0; t<frames; t++ ) {
+            EXPECT_NEAR( 0.f, buf[1][t], 1e-6f );
+            EXPECT_NEAR( 0.f, buf[2][t], 1e-6f );
+        }
+        bank->SetPan( lane, 0.f );
+        for( int group=0; group<VoiceBank::GroupNum(); group++ ) {
+            bank->RenderGroup( group, 0, frames, mask );
+        }
+        bank->Mix( out, 3, frames, mask );
+        for( int t=0; t<frames; t++ ) {
+            EXPECT_NEAR( 0.f, buf[0][t], 1e-6f );
+            EXPECT_NEAR( 0.f, buf[2][t], 1e-6f );
+        }
+
+        delete bank;
+    }
+}
@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+#include "voice_list.h"
+
+namespace{
+    class VoiceListTest : public ::testing::Test
+    {
+    protected:
+        virtual void SetUp()
+        {
+        }
+
+        virtual void TearDown()
+        {
+        }
+    };
+
+    static std::vector<int> voice_list_dump( VoiceList* list )
+    {
+        std::vector<int> ret;
+        for( int no=list->First(); no != VoiceList::kNone; no = list->Next( no ) ) {
+            ret.push_back( no );
+        }
+        return ret;
+    }
+
+    TEST_F(VoiceListTest, PushRemove)
+    {
+        VoiceList list;
+        EXPECT_TRUE( list.IsEmpty() );
+        EXPECT_EQ( VoiceList::kNone, list.PopFront() );
+
+        list.PushBack( 3 );
+        list.PushBack( 31 );
+        list.PushBack( 0 );
+        list.PushBack( 7 );
+        EXPECT_EQ( (std::vector<int>{ 3, 31, 0, 7 }), voice_list_dump( &list ) );
+        EXPECT_EQ( 4, list.GetNum() );
+
+        // 途中、先頭、末尾の削除と、無いものの削除
+        list.Remove( 0 );
+        list.Remove( 5 );
+        EXPECT_EQ( (std::vector<int>{ 3, 31, 7 }), voice_list_dump( &list ) );
+        list.Remove( 3 );
+        list.Remove( 7 );
+        EXPECT_EQ( (std::vector<int>{ 31 }), voice_list_dump( &list ) );
+        EXPECT_FALSE( list.Contains( 3 ) );
+        EXPECT_TRUE( list.Contains( 31 ) );
+
+        list.Remove( 31 );
+        EXPECT_TRUE( list.IsEmpty() );
+        EXPECT_EQ( 0, list.GetNum() );
+    }
+
+    // 既にあるボイスを追加すると最新へ移り、最古から順に取り出せる
+    TEST_F(VoiceListTest, Age)
+    {
+        VoiceList list;
+        for( int no=0; no<VoiceList::kMaxVoices; no++ ) {
+            list.PushBack( no );
+        }
+        list.PushBack( 0 );
+        list.PushBack( 10 );
+
+        EXPECT_EQ( 1, list.PopFront() );
+        EXPECT_EQ( 2, list.PopFront() );
+        for( int no=3; no<VoiceList::kMaxVoices; no++ ) {
+            if( no != 10 ) {
+                EXPECT_EQ( no, list.PopFront() );
+            }
+        }
+        EXPECT_EQ( 0, list.PopFront() );
+        EXPECT_EQ( 10, list.PopFront() );
+        EXPECT_TRUE( list.IsEmpty() );
+    }
+}
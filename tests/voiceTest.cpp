@@ -0,0 +1,137 @@
+#include <gtest/gtest.h>
+
+#include "waveform.h"
+#include "voice_bank.h"
+#include "mod_matrix.h"
+#include "voice.h"
+
+namespace{
+    class VoiceTest : public ::testing::Test
+    {
+    protected:
+        virtual void SetUp()
+        {
+            Waveform::Create( 440.f, 48000.f );
+        }
+
+        virtual void TearDown()
+        {
+            Waveform::Destroy();
+        }
+    };
+
+    // 横取りすると今の音をフェードアウトし、次のブロックから新しいノートを0から鳴らす
+    TEST_F(VoiceTest, Steal)
+    {
+        Waveform* wf = Waveform::GetInstance();
+        VoiceBank bank( wf->GetWTBase(), wf->GetSamplerate() );
+        Voice voice;
+        voice.SetNo( 5 );
+        voice.SetEnvelope( 0, 0, 1.f, 100 );
+
+        const int frames = 64;
+        const int stride = VoiceBank::GainStride();
+        float* gain = bank.GainGet( 5 );
+
+        voice.SetNoteInfo( 60, 100 );
+        voice.Trigger();
+        voice.Prepare( &bank, 0, frames );
+        EXPECT_FLOAT_EQ( 0.5f, gain[(frames-1) * stride] );
+
+        voice.Steal( 72, 100, 96 );
+        voice.Trigger();
+        EXPECT_EQ( 72, voice.GetNoteNo() );
+
+        // 96サンプルかけて単調に0まで下がる
+        float prev = 0.5f;
+        for( int block=0; block<2; block++ ) {
+            voice.Prepare( &bank, 0, frames );
+            EXPECT_TRUE( voice.IsPlaying() );
+            for( int ix=0; ix<frames; ix++ ) {
+                float g = gain[ix * stride];
+                EXPECT_LE( g, prev );
+                if( block * frames + ix >= 95 ) {
+                    EXPECT_EQ( 0.f, g );
+                }
+                prev = g;
+            }
+        }
+
+        // 新しいノートは発音中のまま、キーを離せばリリースする
+        voice.Prepare( &bank, 0, frames );
+        EXPECT_FLOAT_EQ( 0.5f, gain[0] );
+        EXPECT_TRUE( voice.IsKeyOn() );
+        voice.Release();
+        EXPECT_TRUE( voice.IsPlaying() );
+    }
+
+    // 変調は区間の終わりの値を求め、区間の中は直線で補間する
+    TEST_F(VoiceTest, Modulation)
+    {
+        Waveform* wf = Waveform::GetInstance();
+        VoiceBank bank( wf->GetWTBase(), wf->GetSamplerate() );
+        ModMatrix matrix;
+        Voice voice;
+        voice.SetNo( 2 );
+        voice.SetEnvelope( 0, 0, 1.f, 100 );
+        voice.SetModMatrix( &matrix );
+
+        const int frames = 32;
+        const int stride = VoiceBank::GainStride();
+        float* gain = bank.GainGet( 2 );
+
+        // モジュレーションホイールを上げるほど小さくする
+        matrix.SetSlot( 0, ModMatrix::kSrcModWheel, ModMatrix::kDstAmp, -1.f );
+        matrix.SetSlot( 1, ModMatrix::kSrcModWheel, ModMatrix::kDstPan, -0.5f );
+        voice.SetNoteInfo( 60, 100 );
+        voice.Trigger();
+        voice.Prepare( &bank, 0, frames );
+        EXPECT_FLOAT_EQ( 0.5f, gain[(frames-1) * stride] );
+        EXPECT_EQ( 0.f, voice.GetPan() );
+
+        voice.SetController( 1.f, 0.f );
+        voice.Prepare( &bank, frames, frames );
+        float* seg = gain + frames * stride;
+        for( int ix=1; ix<frames; ix++ ) {
+            EXPECT_LT( seg[ix * stride], seg[(ix-1) * stride] );
+            EXPECT_NEAR( 0.5f * (frames - 1 - ix) / frames, seg[ix * stride], 1e-5f );
+        }
+        EXPECT_FLOAT_EQ( -0.5f, voice.GetPan() );
+
+        // 変調しなければ元のまま
+        matrix.Clear();
+        voice.Prepare( &bank, 0, frames );
+        EXPECT_FLOAT_EQ( 0.5f, gain[(frames-1) * stride] );
+    }
+
+    // ユニゾン: 続くレーンにも同じゲインを書き、音量はsqrt(N)で割る。定位は両端がspreadになる
+    TEST_F(VoiceTest, Unison)
+    {
+        Waveform* wf = Waveform::GetInstance();
+        VoiceBank bank( wf->GetWTBase(), wf->GetSamplerate() );
+        Voice voice;
+        voice.SetNo( 0 );
+        voice.SetEnvelope( 0, 0, 1.f, 100 );
+        voice.SetUnison( 4, 20.f, 0.8f, true );
+        EXPECT_EQ( 4, voice.GetUnisonNum() );
+
+        const int frames = 32;
+        const int stride = VoiceBank::GainStride();
+        voice.SetNoteInfo( 60, 100 );
+        voice.Trigger();
+        voice.Prepare( &bank, 0, frames );
+
+        const float* gain0 = bank.GainGet( 0 );
+        EXPECT_FLOAT_EQ( 0.5f * 0.5f, gain0[(frames-1) * stride] );
+        for( int u=1; u<4; u++ ) {
+            const float* gain = bank.GainGet( u );
+            for( int ix=0; ix<frames; ix++ ) {
+                EXPECT_EQ( gain0[ix * stride], gain[ix * stride] );
+            }
+        }
+
+        EXPECT_FLOAT_EQ( -0.8f, voice.GetPan( 0 ) );
+        EXPECT_FLOAT_EQ(  0.8f, voice.GetPan( 3 ) );
+        EXPECT_GT( 0.f, voice.GetPan( 1 ) * voice.GetPan( 2 ) );
+    }
+}
@@ -0,0 +1,129 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <cstdint>
+#include "wav_writer.h"
+
+namespace{
+    class WavWriterTest : public ::testing::Test
+    {
+    protected:
+        virtual void SetUp()
+        {
+            path_ = "wavWriterTest.wav";
+        }
+
+        virtual void TearDown()
+        {
+            remove( path_ );
+        }
+
+        // ファイルを全部読む
+        size_t ReadAll( uint8_t* buf, size_t size )
+        {
+            FILE* fp = fopen( path_, "rb" );
+            if( !fp ) { return 0; }
+            size_t num = fread( buf, 1, size, fp );
+            fclose( fp );
+            return num;
+        }
+
+        const char* path_;
+    };
+
+    static uint32_t le( const uint8_t* p, int size )
+    {
+        uint32_t val = 0;
+        for( int ix=size-1; ix>=0; ix-- ) { val = (val << 8) | p[ix]; }
+        return val;
+    }
+
+    TEST_F(WavWriterTest, Pcm16)
+    {
+        WavWriter wav;
+        const float buf[] = { 0.f, 0.5f, -1.f, 2.f, 0.7f / 32767.f, -0.7f / 32767.f };  // 2ch x 3frames
+        EXPECT_TRUE( wav.Open( path_, 48000, 2, WavWriter::kPcm16 ) );
+        EXPECT_TRUE( wav.Write( buf, 3 ) );
+        EXPECT_TRUE( wav.Close() );
+
+        uint8_t data[256];
+        ASSERT_EQ( 44u + 12u, ReadAll( data, sizeof(data) ) );
+        EXPECT_EQ( 36u + 12u, le( &data[4], 4 ) );  // RIFF size
+        EXPECT_EQ( 1u,       le( &data[20], 2 ) );  // PCM
+        EXPECT_EQ( 2u,       le( &data[22], 2 ) );
+        EXPECT_EQ( 48000u,   le( &data[24], 4 ) );
+        EXPECT_EQ( 16u,      le( &data[34], 2 ) );
+        EXPECT_EQ( 12u,      le( &data[40], 4 ) );  // data size
+
+        EXPECT_EQ( 0,      (int16_t)le( &data[44], 2 ) );
+        EXPECT_EQ( 16384,  (int16_t)le( &data[46], 2 ) );  // 16383.5は偶数へ丸める
+        EXPECT_EQ( -32767, (int16_t)le( &data[48], 2 ) );
+        EXPECT_EQ( 32767,  (int16_t)le( &data[50], 2 ) );  // 飽和
+        EXPECT_EQ( 1,      (int16_t)le( &data[52], 2 ) );  // 0へ切り捨てない
+        EXPECT_EQ( -1,     (int16_t)le( &data[54], 2 ) );
+    }
+
+    TEST_F(WavWriterTest, Float32)
+    {
+        WavWriter wav;
+        float buf[1000];
+        for( int ix=0; ix<1000; ix++ ) { buf[ix] = ix * 0.001f; }
+        EXPECT_TRUE( wav.Open( path_, 44100, 1, WavWriter::kFloat32 ) );
+        for( int ix=0; ix<10; ix++ ) {
+            EXPECT_TRUE( wav.Write( buf, 1000 ) );
+        }
+        EXPECT_EQ( 10000u, wav.GetFrameNum() );
+        EXPECT_TRUE( wav.Close() );
+
+        static uint8_t data[44 + 40000];
+        ASSERT_EQ( sizeof(data), ReadAll( data, sizeof(data) ) );
+        EXPECT_EQ( 3u,      le( &data[20], 2 ) );  // IEEE float
+        EXPECT_EQ( 32u,     le( &data[34], 2 ) );
+        EXPECT_EQ( 40000u,  le( &data[40], 4 ) );
+
+        float val;
+        memcpy( &val, &data[44 + 4*999], 4 );
+        EXPECT_EQ( buf[999], val );
+    }
+
+    TEST_F(WavWriterTest, Float32Multichannel)
+    {
+        // 1回で変換バッファ(kBufSize)を超えるサンプル数を書く
+        const int kChannels = 4;
+        const int kFrames   = 1024;
+        static float buf[kChannels * kFrames];
+        for( int ix=0; ix<kChannels * kFrames; ix++ ) { buf[ix] = ix * 0.0001f - 0.2f; }
+        WavWriter* wav = new WavWriter();
+        EXPECT_TRUE( wav->Open( path_, 48000, kChannels, WavWriter::kFloat32 ) );
+        EXPECT_TRUE( wav->Write( buf, kFrames ) );
+        EXPECT_TRUE( wav->Write( buf, kFrames ) );
+        EXPECT_EQ( (uint64_t)kFrames * 2, wav->GetFrameNum() );
+        EXPECT_TRUE( wav->Close() );
+        delete wav;
+
+        static uint8_t data[44 + sizeof(buf) * 2];
+        ASSERT_EQ( sizeof(data), ReadAll( data, sizeof(data) ) );
+        EXPECT_EQ( (uint32_t)kChannels, le( &data[22], 2 ) );
+        EXPECT_EQ( (uint32_t)sizeof(buf) * 2, le( &data[40], 4 ) );
+        for( int ix=0; ix<kChannels * kFrames * 2; ix++ ) {
+            float val;
+            memcpy( &val, &data[44 + 4*ix], 4 );
+            ASSERT_EQ( buf[ix % (kChannels * kFrames)], val ) << ix;
+        }
+    }
+
+    TEST_F(WavWriterTest, Pcm24)
+    {
+        WavWriter wav;
+        const float buf[] = { 1.f, -0.5f };
+        EXPECT_TRUE( wav.Open( path_, 48000, 1, WavWriter::kPcm24 ) );
+        EXPECT_TRUE( wav.Write( buf, 2 ) );
+        EXPECT_TRUE( wav.Close() );
+
+        uint8_t data[256];
+        ASSERT_EQ( 44u + 6u, ReadAll( data, sizeof(data) ) );
+        EXPECT_EQ( 24u,      le( &data[34], 2 ) );
+        EXPECT_EQ( 8388607u, le( &data[44], 3 ) );
+        EXPECT_EQ( 0xC00000u, le( &data[47], 3 ) );  // -4194303.5は偶数へ丸める
+    }
+}
@@ -1,9 +1,14 @@
 #include <gtest/gtest.h>
 
 #include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
 #include "waveform.h"
 
 #define PI (3.141592653589793238462643383279f)
+#define CACHE_DIR "waveformTestCache/sub"
 
 namespace{
     class WaveformTest : public ::testing::Test
@@ -17,6 +22,35 @@ namespace{
         virtual void TearDown()
         {
             Waveform::Destroy();
+            Waveform::CacheDirSet( nullptr );
+            remove( CACHE_DIR "/wavetable-v1-48000.bin" );
+            remove( CACHE_DIR "/wavetable-v1-96000.bin" );
+            rmdir( CACHE_DIR );
+            rmdir( "waveformTestCache" );
+        }
+
+        // キャッシュを使う設定で作り直す
+        Waveform* Recreate( float fs )
+        {
+            Waveform::Destroy();
+            Waveform::CacheDirSet( CACHE_DIR );
+            return Waveform::Create( 440.f, fs );
+        }
+
+        // 倍音を直接足し合わせたテーブル（三角波、ノコギリ波、矩形波）
+        static void DirectSum( float* out, Waveform* wf, int kind, int harmo_num )
+        {
+            for( int ix=0; ix<WT_SIZE; ix++ ) {
+                double sum = 0.0;
+                for( int jx=1; jx<=harmo_num; jx++ ) {
+                    double s = sin( 2.0 * M_PI * ((jx * ix) % WT_SIZE) / WT_SIZE );
+                    if( kind == wf->WF_SAW )      { sum += 2.0 / (M_PI * jx) * s; }
+                    else if( (jx & 1) == 0 )      { continue; }
+                    else if( kind == wf->WF_TRI ) { sum += ((jx % 4 == 1) ? 8.0 : -8.0) / (M_PI * M_PI * jx * jx) * s; }
+                    else                          { sum += 2.0 / (M_PI * jx) * s; }
+                }
+                out[ix] = (float)sum;
+            }
         }
     };
 
@@ -100,4 +134,120 @@ namespace{
         // A5(880Hz)
         EXPECT_EQ( wf->CalcWFromNoteNo( 81, 0 ), wf->CalcWFromFreq( 880.0 ) );
     }
+
+    TEST_F(WaveformTest, CalcWFromNoteNoFast){
+        Waveform* wf = Waveform::GetInstance();
+
+        for( float nn=0.f; nn<=127.f; nn+=0.05f ) {
+            double w    = wf->CalcWFromNoteNo( nn, 7.f );
+            double fast = wf->CalcWFromNoteNoFast( nn, 7.f );
+            EXPECT_NEAR( w, fast, w * 0.00001 + 1.0 );  // 誤差＋整数への切り捨て分
+        }
+    }
+
+    TEST_F(WaveformTest, GetWTOffsetFromNN){
+        Waveform* wf = Waveform::GetInstance();
+
+        // 低い音ほど倍音の多いテーブル（ノコギリ波テーブルの先頭）
+        int base = wf->GetWTOffsetFromNN( wf->WF_SAW, 0.f );
+        EXPECT_EQ( base, wf->GetWTOffsetFromNN( wf->WF_SAW, -12.f ) );
+
+        // ノートNoに対して単調に進む
+        int prev = base;
+        for( float nn=0.f; nn<=127.f; nn+=0.01f ) {
+            int offset = wf->GetWTOffsetFromNN( wf->WF_SAW, nn );
+            EXPECT_LE( prev, offset );
+            EXPECT_EQ( 0, (offset - base) % WT_SIZE );
+            prev = offset;
+        }
+
+        // ナイキスト周波数より上はサイン波
+        EXPECT_EQ( 0, wf->GetWTOffsetFromNN( wf->WF_SAW, 200.f ) );
+        EXPECT_EQ( 0, wf->GetWTOffsetFromNN( wf->WF_SINE, 60.f ) );
+    }
+
+    TEST_F(WaveformTest, TableMatchesDirectSum){
+        Waveform* wf = Waveform::GetInstance();
+        const float* base = wf->GetWTBase();
+        const int kinds[] = { wf->WF_TRI, wf->WF_SAW, wf->WF_SQUARE };
+        float ref[WT_SIZE];
+
+        for( int kind : kinds ) {
+            // 最も低い帯域(30Hz、800倍音。WT_SIZE/2を超える倍音は折り返す)
+            const float* tbl = base + wf->GetWTOffsetFromNN( kind, 0.f );
+            DirectSum( ref, wf, kind, (int)(48000.f / 2 / 30.f) );
+            for( int ix=0; ix<WT_SIZE; ix++ ) {
+                ASSERT_NEAR( ref[ix], tbl[ix], 1e-4 ) << kind << ":" << ix;
+            }
+
+            // 最も高い帯域(1倍音)
+            int offset = 0;
+            for( float nn=100.f; wf->GetWTOffsetFromNN( kind, nn ) != 0; nn+=0.01f ) {
+                offset = wf->GetWTOffsetFromNN( kind, nn );
+            }
+            DirectSum( ref, wf, kind, 1 );
+            for( int ix=0; ix<WT_SIZE; ix++ ) {
+                ASSERT_NEAR( ref[ix], base[offset + ix], 1e-5 ) << kind << ":" << ix;
+            }
+        }
+    }
+
+    TEST_F(WaveformTest, Cache){
+        std::vector<float> generated( Waveform::GetInstance()->GetWTBase(),
+                                      Waveform::GetInstance()->GetWTBase() + Waveform::GetInstance()->GetWTBytes() / sizeof(float) );
+        EXPECT_FALSE( Waveform::GetInstance()->IsFromCache() );
+
+        // 1回目は生成して保存、2回目は保存したものを使う
+        Waveform* wf = Recreate( 48000.f );
+        EXPECT_FALSE( wf->IsFromCache() );
+        wf = Recreate( 48000.f );
+        ASSERT_TRUE( wf->IsFromCache() );
+        ASSERT_EQ( generated.size() * sizeof(float), wf->GetWTBytes() );
+        EXPECT_EQ( 0, memcmp( generated.data(), wf->GetWTBase(), wf->GetWTBytes() ) );
+        EXPECT_EQ( wf->GetWTBase() + WT_SIZE, wf->GetWTBase() + wf->GetWTOffsetFromNN( wf->WF_TRI, 0.f ) );
+
+        // サンプリング周波数が違えば別のキャッシュ
+        wf = Recreate( 96000.f );
+        EXPECT_FALSE( wf->IsFromCache() );
+        EXPECT_GT( wf->GetWTBytes(), generated.size() * sizeof(float) );
+        wf = Recreate( 96000.f );
+        EXPECT_TRUE( wf->IsFromCache() );
+    }
+
+    TEST_F(WaveformTest, CacheBroken){
+        Recreate( 48000.f );
+
+        // 途中で切れたファイルは使わずに作り直す
+        const char* path = CACHE_DIR "/wavetable-v1-48000.bin";
+        ASSERT_EQ( 0, truncate( path, 4096 + 100 ) );
+        Waveform* wf = Recreate( 48000.f );
+        EXPECT_FALSE( wf->IsFromCache() );
+        wf = Recreate( 48000.f );
+        EXPECT_TRUE( wf->IsFromCache() );
+
+        // ヘッダが合わないファイルも使わない
+        FILE* fp = fopen( path, "r+b" );
+        ASSERT_NE( nullptr, fp );
+        fputc( 'X', fp );
+        fclose( fp );
+        wf = Recreate( 48000.f );
+        EXPECT_FALSE( wf->IsFromCache() );
+        EXPECT_NEAR( 0.f, wf->GetSaw( 60.f, 0 ), 1e-5 );
+    }
+
+    TEST_F(WaveformTest, HighSampleRate){
+        Waveform::Destroy();
+        Waveform* wf = Waveform::Create( 440.f, 96000.f );
+
+        // 帯域が増えてもテーブルの範囲に収まる
+        int prev = 0;
+        for( float nn=0.f; nn<=155.f; nn+=0.05f ) {
+            int offset = wf->GetWTOffsetFromNN( wf->WF_SQUARE, nn );
+            ASSERT_LE( 0, offset );
+            ASSERT_LT( (size_t)offset, wf->GetWTBytes() / sizeof(float) );
+            prev = offset;
+        }
+        EXPECT_EQ( 0, prev );
+        EXPECT_NEAR( 0.5f, wf->GetSquare( 60.f, (WT_SIZE<<16) / 4 ), 0.05f );
+    }
 }
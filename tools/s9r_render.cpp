@@ -0,0 +1,179 @@
+/**
+ * @file s9r_render.cpp
+ * @brief Standard MIDI Fileをオーディオデバイスを使わずにレンダリングし、WAVファイルへ書き出す
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+
+#include "common.h"
+#include "midi.h"
+#include "synth.h"
+#include "patch.h"
+#include "midi_file.h"
+#include "wav_writer.h"
+#include "rt_thread.h"
+#include "waveform.h"
+
+static const int kChunkFrames = 1024;  // 1回のRenderBlockで処理する最大フレーム数
+
+static void usage()
+{
+    fprintf(stderr,
+        "usage: s9r-render [options] <input.mid> <output.wav>\n"
+        "  -p <file>          patch file\n"
+        "  -r <rate>          sample rate (default: 48000)\n"
+        "  -c <channels>      channels (default: 2)\n"
+        "  -f <float|16|24>   sample format (default: float)\n"
+        "  -t <sec>           tail after the last event (default: 2.0)\n"
+        "  -j <num>           render threads (default: 1)\n"
+        "  -s <file>          write callback time statistics (\"-\": stderr)\n");
+}
+
+/**
+ * @brief 指定フレーム数だけレンダリングして書き出す
+ *
+ * @param[in]     synth
+ * @param[in,out] wav
+ * @param[in]     planar   チャンネル毎のレンダリング先(kChunkFramesずつ)
+ * @param[in]     buf      WAVへ書くインターリーブのバッファ(kChunkFrames * channels)
+ * @param[in]     channels
+ * @param[in]     frames
+ */
+static bool render_frames( Synth* synth, WavWriter* wav, float* const* planar, float* buf, int channels, uint64_t frames )
+{
+    while( frames > 0 ) {
+        int num = (int)MIN( frames, (uint64_t)kChunkFrames );
+        synth->RenderBlock( planar, num, channels );
+        for( int ix=0; ix<num; ix++ ) {
+            for( int ch=0; ch<channels; ch++ ) {
+                buf[ix * channels + ch] = planar[ch][ix];
+            }
+        }
+        if( !wav->Write( buf, num ) ) {
+            return false;
+        }
+        frames -= num;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    const char* patch_path = nullptr;
+    const char* in_path    = nullptr;
+    const char* out_path   = nullptr;
+    int         fs         = 48000;
+    int         channels   = 2;
+    int         format     = WavWriter::kFloat32;
+    double      tail       = 2.0;
+    int         thread_num = 1;
+    const char* stats_path = nullptr;
+
+    // options
+    for( int ix=1; ix<argc; ix++ ) {
+        const char* arg = argv[ix];
+        if( arg[0] == '-' && arg[1] != '\0' && arg[2] == '\0' && ix+1 < argc ) {
+            const char* val = argv[++ix];
+            switch( arg[1] ) {
+                case 'p': patch_path = val;       break;
+                case 'r': fs         = atoi(val); break;
+                case 'c': channels   = atoi(val); break;
+                case 't': tail       = atof(val); break;
+                case 'j': thread_num = atoi(val); break;
+                case 's': stats_path = val;       break;
+                case 'f':
+                    if     ( strcmp( val, "float" ) == 0 ) { format = WavWriter::kFloat32; }
+                    else if( strcmp( val, "16" )    == 0 ) { format = WavWriter::kPcm16; }
+                    else if( strcmp( val, "24" )    == 0 ) { format = WavWriter::kPcm24; }
+                    else { usage(); return 1; }
+                    break;
+                default:
+                    usage();
+                    return 1;
+            }
+        }
+        else if( !in_path )  { in_path  = arg; }
+        else if( !out_path ) { out_path = arg; }
+        else                 { usage(); return 1; }
+    }
+    if( !in_path || !out_path || fs <= 0 || channels <= 0 ) {
+        usage();
+        return 1;
+    }
+
+    // input
+    MidiFile midi_file;
+    if( !midi_file.Load( in_path ) ) {
+        return 1;
+    }
+    Patch patch;
+    if( patch_path && !patch.Load( patch_path ) ) {
+        return 1;
+    }
+
+    // リアルタイム再生と同じく非正規化数は0として扱う
+    RtThread::EnableFlushToZero();
+
+    // initialize (オーディオデバイス、MIDIポート、画面は使わない)
+    MidiCtrl::NoPortMode();
+    MidiCtrl* midictrl = MidiCtrl::Create();
+    Waveform::CacheDirSet( Waveform::DefaultCacheDir() );
+    Synth* synth = Synth::Create( 440.0, fs );
+    synth->SetPatch( patch );
+    synth->SetRenderThreadNum( thread_num );
+
+    WavWriter wav;
+    if( !wav.Open( out_path, fs, channels, format ) ) {
+        return 1;
+    }
+
+    // render
+    float*  buf    = new float[kChunkFrames * channels];
+    float*  work   = new float[kChunkFrames * channels];
+    float** planar = new float*[channels];
+    for( int ch=0; ch<channels; ch++ ) {
+        planar[ch] = &work[kChunkFrames * ch];
+    }
+    const std::vector<MidiFileEvent>& events = midi_file.GetEvents();
+    uint64_t pos = 0;  // レンダリング済みのフレーム数
+    bool     ok  = true;
+
+    auto start = std::chrono::steady_clock::now();
+    for( size_t ix=0; ix<events.size() && ok; ix++ ) {
+        // イベントの位置までレンダリングしてから鍵盤状態へ反映する
+        uint64_t at = (uint64_t)(events[ix].time * fs);
+        if( at > pos ) {
+            ok  = render_frames( synth, &wav, planar, buf, channels, at - pos );
+            pos = at;
+        }
+        midictrl->MidiRecv( events[ix].data, events[ix].size );
+    }
+    if( ok ) {
+        uint64_t tail_frames = (uint64_t)(tail * fs);
+        ok   = render_frames( synth, &wav, planar, buf, channels, tail_frames );
+        pos += tail_frames;
+    }
+    auto stop = std::chrono::steady_clock::now();
+
+    ok = wav.Close() && ok;
+    delete[] buf;
+    delete[] work;
+    delete[] planar;
+
+    // report
+    double elapsed = std::chrono::duration<double>( stop - start ).count();
+    double length  = (double)pos / fs;
+    fprintf(stderr, "%s: %.3f sec rendered in %.3f sec (realtime factor %.1fx)\n",
+        out_path, length, elapsed, (elapsed > 0.0) ? length / elapsed : 0.0);
+    if( stats_path ) {
+        ok = synth->DumpProcStats( stats_path ) && ok;
+    }
+
+    Synth::Destroy();
+    MidiCtrl::Destroy();
+
+    return ok ? 0 : 1;
+}